@@ -713,6 +713,7 @@ static cycle_t timebase_read(struct clocksource *cs)
 }
 
 void update_vsyscall(struct timespec *wall_time, struct timespec *wtm,
+			struct timespec *raw_time, struct timespec *sleep_time,
 			struct clocksource *clock, u32 mult)
 {
 	u64 new_tb_to_xs, new_stamp_xsec;
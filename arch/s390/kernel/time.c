@@ -220,6 +220,7 @@ struct clocksource * __init clocksource_default_clock(void)
 }
 
 void update_vsyscall(struct timespec *wall_time, struct timespec *wtm,
+			struct timespec *raw_time, struct timespec *sleep_time,
 			struct clocksource *clock, u32 mult)
 {
 	if (clock != &clocksource_tod)
@@ -13,6 +13,7 @@ struct vsyscall_gtod_data {
 		cycle_t	mask;
 		u32	mult;
 		u32	shift;
+		u32	raw_mult;
 	} clock;
 
 	/* open coded 'struct timespec' */
@@ -20,6 +21,10 @@ struct vsyscall_gtod_data {
 	u32		wall_time_nsec;
 	u32		monotonic_time_nsec;
 	time_t		monotonic_time_sec;
+	time_t		raw_time_sec;
+	u32		raw_time_nsec;
+	u32		boot_time_nsec;
+	time_t		boot_time_sec;
 
 	struct timezone sys_tz;
 	struct timespec wall_time_coarse;
@@ -27,4 +32,52 @@ struct vsyscall_gtod_data {
 };
 extern struct vsyscall_gtod_data vsyscall_gtod_data;
 
+/*
+ * Per-CPU snapshot of the running thread's CPU time, taken at context
+ * switch.  The thread's sum_exec_runtime at the switch, minus the TSC
+ * at the switch converted with the CPU's cyc2ns scale, gives a base to
+ * which userspace adds the converted current TSC.  A zero scale means
+ * the snapshot is not usable and the syscall has to be taken.
+ *
+ * Each CPU writes its slot on every context switch, so slots get a
+ * cache line each.  They fill the vvar page from offset 1024 on.
+ */
+#define VTHREAD_NR_CPUS	((PAGE_SIZE - 1024) / SMP_CACHE_BYTES)
+
+struct vsyscall_thread_clock {
+	seqcount_t	seq;
+	u32		scale;
+	s64		base;
+} ____cacheline_aligned;
+
+struct vsyscall_thread_data {
+	struct vsyscall_thread_clock cpu[VTHREAD_NR_CPUS];
+};
+extern struct vsyscall_thread_data vsyscall_thread_data;
+
+/* Same as __cycles_2_ns(), with the CYC2NS_SCALE_FACTOR of 10 */
+static inline u64 vthread_cyc2ns(u64 cyc, u32 scale)
+{
+	return mult_frac(cyc, scale, 1ULL << 10);
+}
+
+#ifdef CONFIG_X86_64
+static inline unsigned int __getcpu(void)
+{
+	unsigned int p;
+
+	if (VVAR(vgetcpu_mode) == VGETCPU_RDTSCP) {
+		/* Load per CPU data from RDTSCP */
+		native_read_tscp(&p);
+	} else {
+		/* Load per CPU data from GDT */
+		asm("lsl %1,%0" : "=r" (p) : "r" (__PER_CPU_SEG));
+	}
+	return p;
+}
+
+struct task_struct;
+extern void vsyscall_switch_thread(struct task_struct *next, int cpu);
+#endif
+
 #endif /* _ASM_X86_VGTOD_H */
@@ -46,5 +46,6 @@
 DECLARE_VVAR(0, volatile unsigned long, jiffies)
 DECLARE_VVAR(16, int, vgetcpu_mode)
 DECLARE_VVAR(128, struct vsyscall_gtod_data, vsyscall_gtod_data)
+DECLARE_VVAR(1024, struct vsyscall_thread_data, vsyscall_thread_data)
 
 #undef DECLARE_VVAR
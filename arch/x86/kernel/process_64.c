@@ -49,6 +49,7 @@
 #include <asm/syscalls.h>
 #include <asm/debugreg.h>
 #include <asm/switch_to.h>
+#include <asm/vgtod.h>
 
 asmlinkage extern void ret_from_fork(void);
 
@@ -358,6 +359,9 @@ __switch_to(struct task_struct *prev_p, struct task_struct *next_p)
 		  (unsigned long)task_stack_page(next_p) +
 		  THREAD_SIZE - KERNEL_STACK_OFFSET);
 
+	/* Publish next's CPU time for the vDSO */
+	vsyscall_switch_thread(next_p, cpu);
+
 	/*
 	 * Now maybe reload the debug registers and handle I/O bitmaps
 	 */
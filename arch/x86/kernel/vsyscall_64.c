@@ -23,6 +23,7 @@
 #include <linux/time.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
+#include <linux/sched.h>
 #include <linux/timer.h>
 #include <linux/seqlock.h>
 #include <linux/jiffies.h>
@@ -49,12 +50,14 @@
 #include <asm/topology.h>
 #include <asm/vgtod.h>
 #include <asm/traps.h>
+#include <asm/timer.h>
 
 #define CREATE_TRACE_POINTS
 #include "vsyscall_trace.h"
 
 DEFINE_VVAR(int, vgetcpu_mode);
 DEFINE_VVAR(struct vsyscall_gtod_data, vsyscall_gtod_data);
+DEFINE_VVAR(struct vsyscall_thread_data, vsyscall_thread_data);
 
 static enum { EMULATE, NATIVE, NONE } vsyscall_mode = EMULATE;
 
@@ -83,9 +86,10 @@ void update_vsyscall_tz(void)
 }
 
 void update_vsyscall(struct timespec *wall_time, struct timespec *wtm,
+			struct timespec *raw_time, struct timespec *sleep_time,
 			struct clocksource *clock, u32 mult)
 {
-	struct timespec monotonic;
+	struct timespec monotonic, boot;
 
 	write_seqcount_begin(&vsyscall_gtod_data.seq);
 
@@ -95,6 +99,7 @@ void update_vsyscall(struct timespec *wall_time, struct timespec *wtm,
 	vsyscall_gtod_data.clock.mask		= clock->mask;
 	vsyscall_gtod_data.clock.mult		= mult;
 	vsyscall_gtod_data.clock.shift		= clock->shift;
+	vsyscall_gtod_data.clock.raw_mult	= clock->mult;
 
 	vsyscall_gtod_data.wall_time_sec	= wall_time->tv_sec;
 	vsyscall_gtod_data.wall_time_nsec	= wall_time->tv_nsec;
@@ -103,6 +108,13 @@ void update_vsyscall(struct timespec *wall_time, struct timespec *wtm,
 	vsyscall_gtod_data.monotonic_time_sec	= monotonic.tv_sec;
 	vsyscall_gtod_data.monotonic_time_nsec	= monotonic.tv_nsec;
 
+	boot = timespec_add(monotonic, *sleep_time);
+	vsyscall_gtod_data.boot_time_sec	= boot.tv_sec;
+	vsyscall_gtod_data.boot_time_nsec	= boot.tv_nsec;
+
+	vsyscall_gtod_data.raw_time_sec		= raw_time->tv_sec;
+	vsyscall_gtod_data.raw_time_nsec	= raw_time->tv_nsec;
+
 	vsyscall_gtod_data.wall_time_coarse	= __current_kernel_time();
 	vsyscall_gtod_data.monotonic_time_coarse =
 		timespec_add(vsyscall_gtod_data.wall_time_coarse, *wtm);
@@ -110,6 +122,44 @@ void update_vsyscall(struct timespec *wall_time, struct timespec *wtm,
 	write_seqcount_end(&vsyscall_gtod_data.seq);
 }
 
+/*
+ * Called from __switch_to() with interrupts disabled: publish the CPU
+ * time of the incoming thread for the vDSO's CLOCK_THREAD_CPUTIME_ID.
+ * This is only possible while sched_clock() is the stable, native TSC
+ * and the TSC is also the vsyscall clock, and not while IRQ time is
+ * accounted: sum_exec_runtime then leaves out the interrupt time that
+ * the TSC delta read by the vDSO would include.
+ */
+void vsyscall_switch_thread(struct task_struct *next, int cpu)
+{
+	struct vsyscall_thread_clock *vc;
+	unsigned long long tsc;
+	unsigned long scale;
+
+	BUILD_BUG_ON(CYC2NS_SCALE_FACTOR != 10);
+	BUILD_BUG_ON(1024 + sizeof(vsyscall_thread_data) > PAGE_SIZE);
+
+	if (cpu >= VTHREAD_NR_CPUS)
+		return;
+	vc = &vsyscall_thread_data.cpu[cpu];
+
+	write_seqcount_begin(&vc->seq);
+	if (vsyscall_gtod_data.clock.vclock_mode != VCLOCK_TSC ||
+#ifdef CONFIG_PARAVIRT
+	    pv_time_ops.sched_clock != native_sched_clock ||
+#endif
+	    !sched_clock_stable || sched_clock_irqtime) {
+		vc->scale = 0;
+	} else {
+		scale = __this_cpu_read(cyc2ns);
+		rdtscll(tsc);
+		vc->scale = scale;
+		vc->base = next->se.sum_exec_runtime -
+			   vthread_cyc2ns(tsc, scale);
+	}
+	write_seqcount_end(&vc->seq);
+}
+
 static void warn_bad_vsyscall(const char *level, struct pt_regs *regs,
 			      const char *message)
 {
@@ -16,6 +16,7 @@
 
 #include <net/dst.h>
 #include <net/xfrm.h>
+#include <net/busy_poll.h>
 #include <linux/veth.h>
 #include <linux/module.h>
 
@@ -25,6 +26,9 @@
 #define MIN_MTU 68		/* Min L3 MTU */
 #define MAX_MTU 65535		/* Max L3 MTU (arbitrary) */
 
+#define VETH_NAPI_WEIGHT	64
+#define VETH_RX_QUEUE_LEN	1000	/* like netdev_max_backlog */
+
 struct veth_net_stats {
 	u64			rx_packets;
 	u64			rx_bytes;
@@ -37,6 +41,8 @@ struct veth_net_stats {
 struct veth_priv {
 	struct net_device *peer;
 	struct veth_net_stats __percpu *stats;
+	struct napi_struct napi;
+	struct sk_buff_head rx_queue;	/* packets sent by the peer */
 };
 
 /*
@@ -111,11 +117,33 @@ static const struct ethtool_ops veth_ethtool_ops = {
  * xmit
  */
 
+/*
+ * Packets are queued for the receiving device's own NAPI context rather
+ * than the per-CPU backlog, so that sockets can busy poll the queue.
+ */
+static int veth_forward_skb(struct net_device *rcv, struct sk_buff *skb)
+{
+	struct veth_priv *rcv_priv = netdev_priv(rcv);
+
+	if (__dev_forward_skb(rcv, skb))
+		return NET_RX_DROP;
+
+	if (unlikely(skb_queue_len(&rcv_priv->rx_queue) >= VETH_RX_QUEUE_LEN)) {
+		kfree_skb(skb);
+		return NET_RX_DROP;
+	}
+
+	skb_queue_tail(&rcv_priv->rx_queue, skb);
+	napi_schedule(&rcv_priv->napi);
+	return NET_RX_SUCCESS;
+}
+
 static netdev_tx_t veth_xmit(struct sk_buff *skb, struct net_device *dev)
 {
 	struct net_device *rcv = NULL;
 	struct veth_priv *priv, *rcv_priv;
 	struct veth_net_stats *stats, *rcv_stats;
+	struct sk_filter *fp;
 	int length;
 
 	priv = netdev_priv(dev);
@@ -132,19 +160,29 @@ static netdev_tx_t veth_xmit(struct sk_buff *skb, struct net_device *dev)
 		skb->ip_summed = CHECKSUM_UNNECESSARY;
 
 	length = skb->len;
-	if (dev_forward_skb(rcv, skb) != NET_RX_SUCCESS)
-		goto rx_drop;
 
-	u64_stats_update_begin(&stats->syncp);
-	stats->tx_bytes += length;
-	stats->tx_packets++;
-	u64_stats_update_end(&stats->syncp);
+	/* the peer's receive filter runs before the frame is forwarded */
+	fp = rcu_dereference_bh(rcv->rx_filter);
+	if (fp) {
+		skb->dev = rcv;
+		if (dev_rx_filter_act(skb, SK_RUN_FILTER(fp, skb)))
+			goto tx_done;
+	}
+
+	if (veth_forward_skb(rcv, skb) != NET_RX_SUCCESS)
+		goto rx_drop;
 
 	u64_stats_update_begin(&rcv_stats->syncp);
 	rcv_stats->rx_bytes += length;
 	rcv_stats->rx_packets++;
 	u64_stats_update_end(&rcv_stats->syncp);
 
+tx_done:
+	u64_stats_update_begin(&stats->syncp);
+	stats->tx_bytes += length;
+	stats->tx_packets++;
+	u64_stats_update_end(&stats->syncp);
+
 	return NETDEV_TX_OK;
 
 rx_drop:
@@ -154,6 +192,62 @@ rx_drop:
 	return NETDEV_TX_OK;
 }
 
+/*
+ * receive
+ */
+
+static int veth_receive(struct veth_priv *priv, int budget)
+{
+	struct sk_buff *skb;
+	int done = 0;
+
+	while (done < budget &&
+	       (skb = skb_dequeue(&priv->rx_queue)) != NULL) {
+		skb_mark_napi_id(skb, &priv->napi);
+		netif_receive_skb(skb);
+		done++;
+	}
+	return done;
+}
+
+static int veth_poll(struct napi_struct *napi, int budget)
+{
+	struct veth_priv *priv = container_of(napi, struct veth_priv, napi);
+	int done;
+
+	done = veth_receive(priv, budget);
+	if (done < budget) {
+		napi_complete(napi);
+		/* the peer could not schedule us while we were running */
+		if (unlikely(!skb_queue_empty(&priv->rx_queue)))
+			napi_reschedule(napi);
+	}
+	return done;
+}
+
+#ifdef CONFIG_NET_RX_BUSY_POLL
+/* must be called with local_bh_disable()d */
+static int veth_busy_poll(struct napi_struct *napi)
+{
+	struct veth_priv *priv = container_of(napi, struct veth_priv, napi);
+	int done;
+
+	if (!netif_running(napi->dev))
+		return LL_FLUSH_FAILED;
+
+	if (!napi_busy_lock(napi))
+		return LL_FLUSH_BUSY;
+
+	done = veth_receive(priv, 4);
+
+	napi_busy_unlock(napi);
+	if (unlikely(!skb_queue_empty(&priv->rx_queue)))
+		napi_schedule(napi);
+
+	return done;
+}
+#endif
+
 /*
  * general routines
  */
@@ -196,6 +290,8 @@ static int veth_open(struct net_device *dev)
 	if (priv->peer == NULL)
 		return -ENOTCONN;
 
+	napi_enable(&priv->napi);
+
 	if (priv->peer->flags & IFF_UP) {
 		netif_carrier_on(dev);
 		netif_carrier_on(priv->peer);
@@ -210,6 +306,9 @@ static int veth_close(struct net_device *dev)
 	netif_carrier_off(dev);
 	netif_carrier_off(priv->peer);
 
+	napi_disable(&priv->napi);
+	skb_queue_purge(&priv->rx_queue);
+
 	return 0;
 }
 
@@ -237,6 +336,10 @@ static int veth_dev_init(struct net_device *dev)
 
 	priv = netdev_priv(dev);
 	priv->stats = stats;
+
+	skb_queue_head_init(&priv->rx_queue);
+	netif_napi_add(dev, &priv->napi, veth_poll, VETH_NAPI_WEIGHT);
+	napi_hash_add(&priv->napi);
 	return 0;
 }
 
@@ -245,6 +348,7 @@ static void veth_dev_free(struct net_device *dev)
 	struct veth_priv *priv;
 
 	priv = netdev_priv(dev);
+	skb_queue_purge(&priv->rx_queue);
 	free_percpu(priv->stats);
 	free_netdev(dev);
 }
@@ -257,6 +361,9 @@ static const struct net_device_ops veth_netdev_ops = {
 	.ndo_change_mtu      = veth_change_mtu,
 	.ndo_get_stats64     = veth_get_stats64,
 	.ndo_set_mac_address = eth_mac_addr,
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	.ndo_busy_poll       = veth_busy_poll,
+#endif
 };
 
 static void veth_setup(struct net_device *dev)
@@ -264,6 +371,7 @@ static void veth_setup(struct net_device *dev)
 	ether_setup(dev);
 
 	dev->priv_flags &= ~IFF_TX_SKB_SHARING;
+	dev->priv_flags |= IFF_RX_FILTER_NATIVE;
 
 	dev->netdev_ops = &veth_netdev_ops;
 	dev->ethtool_ops = &veth_ethtool_ops;
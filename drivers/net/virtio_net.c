@@ -26,6 +26,7 @@
 #include <linux/scatterlist.h>
 #include <linux/if_vlan.h>
 #include <linux/slab.h>
+#include <net/busy_poll.h>
 
 static int napi_weight = 128;
 module_param(napi_weight, int, 0444);
@@ -262,10 +263,51 @@ static int receive_mergeable(struct virtnet_info *vi, struct sk_buff *skb)
 	return 0;
 }
 
+/*
+ * Run the receive filter on a frame still in its receive pages, so that
+ * dropped frames never cost an skb.  Frames spread over more than one
+ * buffer are left to run through the filter once the skb is built.
+ */
+static bool virtnet_filter_page(struct virtnet_info *vi, struct sk_filter *fp,
+				struct page *page, unsigned int len,
+				unsigned int *verdict)
+{
+	char *p = page_address(page);
+	unsigned int hdr_len, offset;
+
+	if (vi->mergeable_rx_bufs) {
+		struct virtio_net_hdr_mrg_rxbuf *mhdr = (void *)p;
+
+		if (mhdr->num_buffers != 1)
+			return false;
+		hdr_len = sizeof(*mhdr);
+		offset = hdr_len;
+	} else {
+		hdr_len = sizeof(struct virtio_net_hdr);
+		offset = sizeof(struct padded_vnet_hdr);
+	}
+
+	len -= hdr_len;
+	if (len > PAGE_SIZE - offset)
+		return false;
+
+	/* receive_buf() only checked for the shorter virtio_net_hdr */
+	if (unlikely(len < ETH_HLEN)) {
+		*verdict = RX_FILTER_DROP;
+		return true;
+	}
+
+	*verdict = sk_run_filter_frame(fp, vi->dev, p + offset, len);
+	return true;
+}
+
 static void receive_buf(struct net_device *dev, void *buf, unsigned int len)
 {
 	struct virtnet_info *vi = netdev_priv(dev);
 	struct virtnet_stats *stats = this_cpu_ptr(vi->stats);
+	struct sk_filter *fp = rcu_dereference_bh(dev->rx_filter);
+	unsigned int verdict = RX_FILTER_PASS;
+	bool filtered = false;
 	struct sk_buff *skb;
 	struct page *page;
 	struct skb_vnet_hdr *hdr;
@@ -286,6 +328,14 @@ static void receive_buf(struct net_device *dev, void *buf, unsigned int len)
 		skb_trim(skb, len);
 	} else {
 		page = buf;
+		if (fp && virtnet_filter_page(vi, fp, page, len, &verdict)) {
+			filtered = true;
+			if (verdict == RX_FILTER_DROP) {
+				dev->stats.rx_dropped++;
+				give_pages(vi, page);
+				return;
+			}
+		}
 		skb = page_to_skb(vi, page, len);
 		if (unlikely(!skb)) {
 			dev->stats.rx_dropped++;
@@ -355,6 +405,18 @@ static void receive_buf(struct net_device *dev, void *buf, unsigned int len)
 		skb_shinfo(skb)->gso_segs = 0;
 	}
 
+	if (fp) {
+		skb_reset_network_header(skb);
+		__skb_push(skb, ETH_HLEN);
+		if (!filtered)
+			verdict = SK_RUN_FILTER(fp, skb);
+		if (dev_rx_filter_act(skb, verdict))
+			return;
+		__skb_pull(skb, ETH_HLEN);
+	}
+
+	skb_mark_napi_id(skb, &vi->napi);
+
 	netif_receive_skb(skb);
 	return;
 
@@ -524,13 +586,11 @@ static void refill_work(struct work_struct *work)
 		queue_delayed_work(system_nrt_wq, &vi->refill, HZ/2);
 }
 
-static int virtnet_poll(struct napi_struct *napi, int budget)
+static unsigned int virtnet_receive(struct virtnet_info *vi, int budget)
 {
-	struct virtnet_info *vi = container_of(napi, struct virtnet_info, napi);
 	void *buf;
 	unsigned int len, received = 0;
 
-again:
 	while (received < budget &&
 	       (buf = virtqueue_get_buf(vi->rvq, &len)) != NULL) {
 		receive_buf(vi->dev, buf, len);
@@ -543,9 +603,20 @@ again:
 			queue_delayed_work(system_nrt_wq, &vi->refill, 0);
 	}
 
+	return received;
+}
+
+static int virtnet_poll(struct napi_struct *napi, int budget)
+{
+	struct virtnet_info *vi = container_of(napi, struct virtnet_info, napi);
+	unsigned int received = 0;
+
+again:
+	received += virtnet_receive(vi, budget - received);
+
 	/* Out of packets? */
 	if (received < budget) {
-		napi_complete(napi);
+		napi_complete_done(napi, received);
 		if (unlikely(!virtqueue_enable_cb(vi->rvq)) &&
 		    napi_schedule_prep(napi)) {
 			virtqueue_disable_cb(vi->rvq);
@@ -557,6 +628,35 @@ again:
 	return received;
 }
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+/* must be called with local_bh_disable()d */
+static int virtnet_busy_poll(struct napi_struct *napi)
+{
+	struct virtnet_info *vi = container_of(napi, struct virtnet_info, napi);
+	unsigned int received;
+
+	if (!netif_running(vi->dev))
+		return LL_FLUSH_FAILED;
+
+	/* NAPI, a disabled queue or refill_work own the ring */
+	if (!napi_busy_lock(napi))
+		return LL_FLUSH_BUSY;
+
+	received = virtnet_receive(vi, 4);
+
+	napi_busy_unlock(napi);
+
+	/* An interrupt while we held the ring could not schedule NAPI. */
+	if (unlikely(!virtqueue_enable_cb(vi->rvq)) &&
+	    napi_schedule_prep(napi)) {
+		virtqueue_disable_cb(vi->rvq);
+		__napi_schedule(napi);
+	}
+
+	return received;
+}
+#endif	/* CONFIG_NET_RX_BUSY_POLL */
+
 static unsigned int free_old_xmit_skbs(struct virtnet_info *vi)
 {
 	struct sk_buff *skb;
@@ -975,6 +1075,9 @@ static const struct net_device_ops virtnet_netdev = {
 #ifdef CONFIG_NET_POLL_CONTROLLER
 	.ndo_poll_controller = virtnet_netpoll,
 #endif
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	.ndo_busy_poll	     = virtnet_busy_poll,
+#endif
 };
 
 static void virtnet_config_changed_work(struct work_struct *work)
@@ -1062,7 +1165,8 @@ static int virtnet_probe(struct virtio_device *vdev)
 		return -ENOMEM;
 
 	/* Set up network device as normal. */
-	dev->priv_flags |= IFF_UNICAST_FLT | IFF_LIVE_ADDR_CHANGE;
+	dev->priv_flags |= IFF_UNICAST_FLT | IFF_LIVE_ADDR_CHANGE |
+			   IFF_RX_FILTER_NATIVE;
 	dev->netdev_ops = &virtnet_netdev;
 	dev->features = NETIF_F_HIGHDMA;
 
@@ -1104,6 +1208,7 @@ static int virtnet_probe(struct virtio_device *vdev)
 	/* Set up our device-specific information */
 	vi = netdev_priv(dev);
 	netif_napi_add(dev, &vi->napi, virtnet_poll, napi_weight);
+	napi_hash_add(&vi->napi);
 	vi->dev = dev;
 	vi->vdev = vdev;
 	vdev->priv = vi;
@@ -347,6 +347,7 @@ void address_space_init_once(struct address_space *mapping)
 	spin_lock_init(&mapping->tree_lock);
 	mutex_init(&mapping->i_mmap_mutex);
 	INIT_LIST_HEAD(&mapping->private_list);
+	INIT_LIST_HEAD(&mapping->shadow_list);
 	spin_lock_init(&mapping->private_lock);
 	INIT_RAW_PRIO_TREE_ROOT(&mapping->i_mmap);
 	INIT_LIST_HEAD(&mapping->i_mmap_nonlinear);
@@ -497,6 +498,14 @@ void clear_inode(struct inode *inode)
 	spin_lock_irq(&inode->i_data.tree_lock);
 	BUG_ON(inode->i_data.nrpages);
 	spin_unlock_irq(&inode->i_data.tree_lock);
+	/*
+	 * Filesystems that skip truncation when there are no pages left
+	 * can still have shadow entries of evicted pages in the tree.
+	 * Reclaim has stopped adding them once the lock was cycled.
+	 */
+	if (inode->i_data.nrshadows)
+		clear_shadow_entries(&inode->i_data, 0, ~0UL);
+	BUG_ON(inode->i_data.nrshadows);
 	BUG_ON(!list_empty(&inode->i_data.private_list));
 	BUG_ON(!(inode->i_state & I_FREEING));
 	BUG_ON(inode->i_state & I_CLEAR);
@@ -538,6 +547,12 @@ static void evict(struct inode *inode)
 	 */
 	inode_wait_for_writeback(inode);
 
+	/*
+	 * Keep reclaim from leaving new shadow entries behind while the
+	 * page cache is torn down; reclaim checks this under tree_lock.
+	 */
+	mapping_set_exiting(&inode->i_data);
+
 	if (op->evict_inode) {
 		op->evict_inode(inode);
 	} else {
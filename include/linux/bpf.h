@@ -0,0 +1,471 @@
+/*
+ * Extended BPF: instruction set, bpf() syscall interface and maps
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ */
+#ifndef _LINUX_BPF_H
+#define _LINUX_BPF_H
+
+#include <linux/types.h>
+#include <linux/filter.h>
+
+/*
+ * eBPF keeps the classic BPF instruction classes, sizes and modes from
+ * linux/filter.h, and adds the following.
+ */
+
+/* instruction classes */
+#define BPF_ALU64	0x07	/* alu mode in double word width */
+
+/* ld/ldx fields */
+#define BPF_DW		0x18	/* double word */
+#define BPF_XADD	0xc0	/* exclusive add */
+
+/* alu/jmp fields */
+#define BPF_MOD		0x90
+#define BPF_XOR		0xa0
+#define BPF_MOV		0xb0	/* mov reg to reg */
+#define BPF_ARSH	0xc0	/* sign extending arithmetic shift right */
+
+/* change endianness of a register */
+#define BPF_END		0xd0	/* flags for endianness conversion: */
+#define BPF_TO_LE	0x00	/* convert to little-endian */
+#define BPF_TO_BE	0x08	/* convert to big-endian */
+
+#define BPF_JNE		0x50	/* jump != */
+#define BPF_JSGT	0x60	/* SGT is signed '>', GT in x86 */
+#define BPF_JSGE	0x70	/* SGE is signed '>=', GE in x86 */
+#define BPF_CALL	0x80	/* function call */
+#define BPF_EXIT	0x90	/* function return */
+
+/* Register numbers */
+enum {
+	BPF_REG_0 = 0,
+	BPF_REG_1,
+	BPF_REG_2,
+	BPF_REG_3,
+	BPF_REG_4,
+	BPF_REG_5,
+	BPF_REG_6,
+	BPF_REG_7,
+	BPF_REG_8,
+	BPF_REG_9,
+	BPF_REG_10,
+	__MAX_BPF_REG,
+};
+
+/* BPF has 10 general purpose 64-bit registers and stack frame. */
+#define MAX_BPF_REG	__MAX_BPF_REG
+
+/*
+ * R0		return value of helpers and of the program
+ * R1 - R5	arguments to helpers, scratched by calls; R1 holds the
+ *		program context on entry
+ * R6 - R9	callee saved; R6 must hold the skb for LD_ABS/LD_IND
+ * R10		read-only frame pointer to MAX_BPF_STACK bytes of stack
+ */
+#define MAX_BPF_STACK	512
+
+struct bpf_insn {
+	__u8	code;		/* opcode */
+	__u8	dst_reg:4;	/* dest register */
+	__u8	src_reg:4;	/* source register */
+	__s16	off;		/* signed offset */
+	__s32	imm;		/* signed immediate constant */
+};
+
+/*
+ * Macros for eBPF instruction array initializers.
+ */
+
+/* ALU ops on registers, dst_reg = dst_reg 'op' src_reg */
+#define BPF_ALU64_REG(OP, DST, SRC)				\
+	((struct bpf_insn) {					\
+		.code  = BPF_ALU64 | BPF_OP(OP) | BPF_X,	\
+		.dst_reg = DST,					\
+		.src_reg = SRC,					\
+		.off   = 0,					\
+		.imm   = 0 })
+
+#define BPF_ALU32_REG(OP, DST, SRC)				\
+	((struct bpf_insn) {					\
+		.code  = BPF_ALU | BPF_OP(OP) | BPF_X,		\
+		.dst_reg = DST,					\
+		.src_reg = SRC,					\
+		.off   = 0,					\
+		.imm   = 0 })
+
+/* ALU ops on immediates, dst_reg = dst_reg 'op' imm32 */
+#define BPF_ALU64_IMM(OP, DST, IMM)				\
+	((struct bpf_insn) {					\
+		.code  = BPF_ALU64 | BPF_OP(OP) | BPF_K,	\
+		.dst_reg = DST,					\
+		.src_reg = 0,					\
+		.off   = 0,					\
+		.imm   = IMM })
+
+#define BPF_ALU32_IMM(OP, DST, IMM)				\
+	((struct bpf_insn) {					\
+		.code  = BPF_ALU | BPF_OP(OP) | BPF_K,		\
+		.dst_reg = DST,					\
+		.src_reg = 0,					\
+		.off   = 0,					\
+		.imm   = IMM })
+
+#define BPF_MOV64_REG(DST, SRC)	BPF_ALU64_REG(BPF_MOV, DST, SRC)
+#define BPF_MOV64_IMM(DST, IMM)	BPF_ALU64_IMM(BPF_MOV, DST, IMM)
+
+/* dst_reg = imm64, takes two instructions */
+#define BPF_LD_IMM64_RAW(DST, SRC, IMM)				\
+	((struct bpf_insn) {					\
+		.code  = BPF_LD | BPF_DW | BPF_IMM,		\
+		.dst_reg = DST,					\
+		.src_reg = SRC,					\
+		.off   = 0,					\
+		.imm   = (__u32) (IMM) }),			\
+	((struct bpf_insn) {					\
+		.code  = 0, /* zero is reserved opcode */	\
+		.dst_reg = 0,					\
+		.src_reg = 0,					\
+		.off   = 0,					\
+		.imm   = ((__u64) (IMM)) >> 32 })
+
+#define BPF_LD_IMM64(DST, IMM)	BPF_LD_IMM64_RAW(DST, 0, IMM)
+
+/* pseudo BPF_LD_IMM64 insn used to refer to a map by its fd */
+#define BPF_PSEUDO_MAP_FD	1
+#define BPF_LD_MAP_FD(DST, MAP_FD)				\
+	BPF_LD_IMM64_RAW(DST, BPF_PSEUDO_MAP_FD, MAP_FD)
+
+/* R0 = *(uSIZE *) (skb->data + imm32), R6 is the skb */
+#define BPF_LD_ABS(SIZE, IMM)					\
+	((struct bpf_insn) {					\
+		.code  = BPF_LD | BPF_SIZE(SIZE) | BPF_ABS,	\
+		.dst_reg = 0,					\
+		.src_reg = 0,					\
+		.off   = 0,					\
+		.imm   = IMM })
+
+/* Memory load, dst_reg = *(uint *) (src_reg + off16) */
+#define BPF_LDX_MEM(SIZE, DST, SRC, OFF)			\
+	((struct bpf_insn) {					\
+		.code  = BPF_LDX | BPF_SIZE(SIZE) | BPF_MEM,	\
+		.dst_reg = DST,					\
+		.src_reg = SRC,					\
+		.off   = OFF,					\
+		.imm   = 0 })
+
+/* Memory store, *(uint *) (dst_reg + off16) = src_reg */
+#define BPF_STX_MEM(SIZE, DST, SRC, OFF)			\
+	((struct bpf_insn) {					\
+		.code  = BPF_STX | BPF_SIZE(SIZE) | BPF_MEM,	\
+		.dst_reg = DST,					\
+		.src_reg = SRC,					\
+		.off   = OFF,					\
+		.imm   = 0 })
+
+/* Memory store, *(uint *) (dst_reg + off16) = imm32 */
+#define BPF_ST_MEM(SIZE, DST, OFF, IMM)				\
+	((struct bpf_insn) {					\
+		.code  = BPF_ST | BPF_SIZE(SIZE) | BPF_MEM,	\
+		.dst_reg = DST,					\
+		.src_reg = 0,					\
+		.off   = OFF,					\
+		.imm   = IMM })
+
+/* Conditional jumps against registers, if (dst_reg 'op' src_reg) goto pc + off16 */
+#define BPF_JMP_REG(OP, DST, SRC, OFF)				\
+	((struct bpf_insn) {					\
+		.code  = BPF_JMP | BPF_OP(OP) | BPF_X,		\
+		.dst_reg = DST,					\
+		.src_reg = SRC,					\
+		.off   = OFF,					\
+		.imm   = 0 })
+
+/* Conditional jumps against immediates, if (dst_reg 'op' imm32) goto pc + off16 */
+#define BPF_JMP_IMM(OP, DST, IMM, OFF)				\
+	((struct bpf_insn) {					\
+		.code  = BPF_JMP | BPF_OP(OP) | BPF_K,		\
+		.dst_reg = DST,					\
+		.src_reg = 0,					\
+		.off   = OFF,					\
+		.imm   = IMM })
+
+/* Call helper function, imm32 is one of enum bpf_func_id */
+#define BPF_CALL_FUNC(FUNC)					\
+	((struct bpf_insn) {					\
+		.code  = BPF_JMP | BPF_CALL,			\
+		.dst_reg = 0,					\
+		.src_reg = 0,					\
+		.off   = 0,					\
+		.imm   = FUNC })
+
+/* Program exit */
+#define BPF_EXIT_INSN()						\
+	((struct bpf_insn) {					\
+		.code  = BPF_JMP | BPF_EXIT,			\
+		.dst_reg = 0,					\
+		.src_reg = 0,					\
+		.off   = 0,					\
+		.imm   = 0 })
+
+/* BPF syscall commands */
+enum bpf_cmd {
+	/* create a map and return a file descriptor that refers to it */
+	BPF_MAP_CREATE,
+
+	/* lookup key in a given map and copy the value out */
+	BPF_MAP_LOOKUP_ELEM,
+
+	/* create or update key/value pair in a given map */
+	BPF_MAP_UPDATE_ELEM,
+
+	/* find and delete key in a given map */
+	BPF_MAP_DELETE_ELEM,
+
+	/* walk a map: return the key following attr->key in attr->next_key,
+	 * or the first key when attr->key is not in the map
+	 */
+	BPF_MAP_GET_NEXT_KEY,
+
+	/* verify and load a program, return a file descriptor for it */
+	BPF_PROG_LOAD,
+};
+
+enum bpf_map_type {
+	BPF_MAP_TYPE_UNSPEC,
+	BPF_MAP_TYPE_HASH,
+	BPF_MAP_TYPE_ARRAY,
+};
+
+enum bpf_prog_type {
+	BPF_PROG_TYPE_UNSPEC,
+	BPF_PROG_TYPE_SOCKET_FILTER,
+};
+
+/* flags for BPF_MAP_UPDATE_ELEM command */
+#define BPF_ANY		0	/* create new element or update existing */
+#define BPF_NOEXIST	1	/* create new element if it didn't exist */
+#define BPF_EXIST	2	/* update existing element */
+
+union bpf_attr {
+	struct { /* anonymous struct used by BPF_MAP_CREATE command */
+		__u32	map_type;	/* one of enum bpf_map_type */
+		__u32	key_size;	/* size of key in bytes */
+		__u32	value_size;	/* size of value in bytes */
+		__u32	max_entries;	/* max number of entries in a map */
+	};
+
+	struct { /* anonymous struct used by BPF_MAP_*_ELEM commands */
+		__u32		map_fd;
+		__aligned_u64	key;
+		union {
+			__aligned_u64 value;
+			__aligned_u64 next_key;
+		};
+		__u64		flags;
+	};
+
+	struct { /* anonymous struct used by BPF_PROG_LOAD command */
+		__u32		prog_type;	/* one of enum bpf_prog_type */
+		__u32		insn_cnt;
+		__aligned_u64	insns;		/* const struct bpf_insn * */
+		__aligned_u64	license;	/* const char * */
+		__u32		log_level;	/* verbosity level of verifier */
+		__u32		log_size;	/* size of user buffer */
+		__aligned_u64	log_buf;	/* user supplied buffer */
+	};
+} __attribute__((aligned(8)));
+
+/* integer value in 'imm' field of BPF_CALL instruction selects which helper
+ * function eBPF program intends to call
+ */
+enum bpf_func_id {
+	BPF_FUNC_unspec,
+
+	/* void *map_lookup_elem(&map, &key)
+	 * Return: Map value or NULL
+	 */
+	BPF_FUNC_map_lookup_elem,
+
+	/* int map_update_elem(&map, &key, &value, flags)
+	 * Return: 0 on success or negative error
+	 */
+	BPF_FUNC_map_update_elem,
+
+	/* int map_delete_elem(&map, &key)
+	 * Return: 0 on success or negative error
+	 */
+	BPF_FUNC_map_delete_elem,
+
+	/* u32 get_prandom_u32(void) */
+	BPF_FUNC_get_prandom_u32,
+
+	/* u32 get_smp_processor_id(void) */
+	BPF_FUNC_get_smp_processor_id,
+
+	__BPF_FUNC_MAX_ID,
+};
+
+#ifdef __KERNEL__
+
+#include <linux/workqueue.h>
+
+struct bpf_map;
+struct sk_buff;
+
+/* map is generic key/value storage optionally accessible by eBPF programs */
+struct bpf_map_ops {
+	/* funcs callable from userspace (via syscall) */
+	struct bpf_map *(*map_alloc)(union bpf_attr *attr);
+	void (*map_free)(struct bpf_map *);
+	int (*map_get_next_key)(struct bpf_map *map, void *key, void *next_key);
+
+	/* funcs callable from userspace and from eBPF programs */
+	void *(*map_lookup_elem)(struct bpf_map *map, void *key);
+	int (*map_update_elem)(struct bpf_map *map, void *key, void *value,
+			       u64 flags);
+	int (*map_delete_elem)(struct bpf_map *map, void *key);
+};
+
+struct bpf_map {
+	atomic_t refcnt;
+	enum bpf_map_type map_type;
+	u32 key_size;
+	u32 value_size;
+	u32 max_entries;
+	const struct bpf_map_ops *ops;
+	struct work_struct work;
+};
+
+struct bpf_map_type_list {
+	struct list_head list_node;
+	const struct bpf_map_ops *ops;
+	enum bpf_map_type type;
+};
+
+extern void bpf_register_map_type(struct bpf_map_type_list *tl);
+extern void bpf_map_put(struct bpf_map *map);
+extern struct bpf_map *bpf_map_get(struct file *file);
+
+/* function argument constraints */
+enum bpf_arg_type {
+	ARG_ANYTHING = 0,	/* any argument is ok */
+
+	/* the following constraints used to prototype
+	 * bpf_map_lookup/update/delete_elem() functions
+	 */
+	ARG_CONST_MAP_PTR,	/* const argument used as pointer to bpf_map */
+	ARG_PTR_TO_MAP_KEY,	/* pointer to stack used as map key */
+	ARG_PTR_TO_MAP_VALUE,	/* pointer to stack used as map value */
+};
+
+/* type of values returned from helper functions */
+enum bpf_return_type {
+	RET_INTEGER,			/* function returns integer */
+	RET_VOID,			/* function doesn't return anything */
+	RET_PTR_TO_MAP_VALUE_OR_NULL,	/* returns a pointer to map elem value or NULL */
+};
+
+/* eBPF function prototype used by verifier to allow BPF_CALLs from eBPF
+ * programs to in-kernel helper functions and for adjusting imm32 field in
+ * BPF_CALL instructions after verifying
+ */
+struct bpf_func_proto {
+	u64 (*func)(u64 r1, u64 r2, u64 r3, u64 r4, u64 r5);
+	bool gpl_only;
+	enum bpf_return_type ret_type;
+	int nr_args;
+	enum bpf_arg_type arg_type[5];
+};
+
+/* bpf_context is intentionally undefined structure. Pointer to bpf_context is
+ * the first argument to eBPF programs.
+ * For socket filters: 'struct bpf_context *' == 'struct sk_buff *'
+ */
+struct bpf_context;
+
+enum bpf_access_type {
+	BPF_READ = 1,
+	BPF_WRITE = 2
+};
+
+struct bpf_verifier_ops {
+	/* return eBPF function prototype for verification */
+	const struct bpf_func_proto *(*get_func_proto)(enum bpf_func_id func_id);
+
+	/* return true if 'size' wide access at offset 'off' within bpf_context
+	 * with 'type' (read or write) is allowed
+	 */
+	bool (*is_valid_access)(int off, int size, enum bpf_access_type type);
+};
+
+struct bpf_prog_type_list {
+	struct list_head list_node;
+	const struct bpf_verifier_ops *ops;
+	enum bpf_prog_type type;
+};
+
+struct bpf_prog {
+	atomic_t refcnt;
+	u32 len;			/* number of instructions */
+	enum bpf_prog_type type;
+	bool jited;			/* bpf_func points to JITed image */
+	bool gpl_compatible;
+	u32 used_map_cnt;
+	struct bpf_map **used_maps;
+	const struct bpf_verifier_ops *ops;
+	unsigned int (*bpf_func)(const struct sk_buff *skb,
+				 const struct bpf_insn *insn);
+	struct work_struct work;	/* deferred free */
+	struct bpf_insn insnsi[0];
+};
+
+#define BPF_PROG_RUN(prog, ctx)	(*(prog)->bpf_func)(ctx, (prog)->insnsi)
+
+static inline unsigned int bpf_prog_size(unsigned int insn_cnt)
+{
+	return sizeof(struct bpf_prog) + insn_cnt * sizeof(struct bpf_insn);
+}
+
+/* Bit 63 set in the return value of bpf_ld_skb() means the load was out
+ * of bounds, and the program stops with a return value of 0.
+ */
+#define BPF_LD_SKB_ERR	(1ULL << 63)
+
+extern u64 bpf_ld_skb(const struct sk_buff *skb, int off, unsigned int size);
+
+#ifdef CONFIG_BPF_SYSCALL
+extern void bpf_register_prog_type(struct bpf_prog_type_list *tl);
+extern struct bpf_prog *bpf_prog_get(u32 ufd);
+extern void bpf_prog_put(struct bpf_prog *prog);
+#else
+static inline void bpf_prog_put(struct bpf_prog *prog)
+{
+}
+#endif
+
+extern struct bpf_prog *bpf_prog_alloc(unsigned int insn_cnt);
+extern void bpf_prog_free(struct bpf_prog *prog);
+extern void bpf_prog_select_runtime(struct bpf_prog *prog);
+extern int bpf_check(struct bpf_prog *prog, union bpf_attr *attr);
+
+/* arch hooks, weak defaults in kernel/bpf/core.c */
+extern void bpf_int_jit_compile(struct bpf_prog *prog);
+extern void bpf_int_jit_free(struct bpf_prog *prog);
+
+/* helpers are called as __bpf_call_base + insn->imm */
+extern u64 __bpf_call_base(u64 r1, u64 r2, u64 r3, u64 r4, u64 r5);
+
+/* verifier prototypes for helper functions called from eBPF programs */
+extern const struct bpf_func_proto bpf_map_lookup_elem_proto;
+extern const struct bpf_func_proto bpf_map_update_elem_proto;
+extern const struct bpf_func_proto bpf_map_delete_elem_proto;
+extern const struct bpf_func_proto bpf_get_prandom_u32_proto;
+extern const struct bpf_func_proto bpf_get_smp_processor_id_proto;
+
+#endif /* __KERNEL__ */
+
+#endif /* _LINUX_BPF_H */
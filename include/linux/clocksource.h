@@ -322,12 +322,14 @@ static inline void __clocksource_updatefreq_khz(struct clocksource *cs, u32 khz)
 #ifdef CONFIG_GENERIC_TIME_VSYSCALL
 extern void
 update_vsyscall(struct timespec *ts, struct timespec *wtm,
-			struct clocksource *c, u32 mult);
+		struct timespec *raw_time, struct timespec *sleep_time,
+		struct clocksource *c, u32 mult);
 extern void update_vsyscall_tz(void);
 #else
 static inline void
 update_vsyscall(struct timespec *ts, struct timespec *wtm,
-			struct clocksource *c, u32 mult)
+		struct timespec *raw_time, struct timespec *sleep_time,
+		struct clocksource *c, u32 mult)
 {
 }
 
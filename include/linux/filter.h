@@ -132,6 +132,14 @@ struct sock_fprog {	/* Required for SO_ATTACH_FILTER. */
 #define SKF_NET_OFF   (-0x100000)
 #define SKF_LL_OFF    (-0x200000)
 
+/*
+ * Return values of a device receive filter (IFLA_RX_FILTER).  Any other
+ * non-zero value passes the frame on like RX_FILTER_PASS.
+ */
+#define RX_FILTER_DROP	0
+#define RX_FILTER_PASS	1
+#define RX_FILTER_TX	2	/* back out, Ethernet addresses swapped */
+
 #ifdef __KERNEL__
 
 #ifdef CONFIG_COMPAT
@@ -146,6 +154,8 @@ struct compat_sock_fprog {
 
 struct sk_buff;
 struct sock;
+struct net_device;
+struct bpf_prog;
 
 struct sk_filter
 {
@@ -153,10 +163,18 @@ struct sk_filter
 	unsigned int         	len;	/* Number of filter blocks */
 	unsigned int		(*bpf_func)(const struct sk_buff *skb,
 					    const struct sock_filter *filter);
+	struct bpf_prog		*prog;	/* eBPF program, len is 0 then */
 	struct rcu_head		rcu;
 	struct sock_filter     	insns[0];
 };
 
+/* A classic program as userspace handed it in, before sk_chk_filter() */
+struct sk_filter_orig {
+	struct rcu_head		rcu;
+	unsigned int		len;	/* Number of filter blocks */
+	struct sock_filter	insns[0];
+};
+
 static inline unsigned int sk_filter_len(const struct sk_filter *fp)
 {
 	return fp->len * sizeof(struct sock_filter) + sizeof(*fp);
@@ -165,17 +183,22 @@ static inline unsigned int sk_filter_len(const struct sk_filter *fp)
 extern int sk_filter(struct sock *sk, struct sk_buff *skb);
 extern unsigned int sk_run_filter(const struct sk_buff *skb,
 				  const struct sock_filter *filter);
+extern unsigned int sk_run_filter_frame(const struct sk_filter *fp,
+					struct net_device *dev,
+					void *data, unsigned int len);
 extern int sk_unattached_filter_create(struct sk_filter **pfp,
 				       struct sock_fprog *fprog);
 extern void sk_unattached_filter_destroy(struct sk_filter *fp);
 extern int sk_attach_filter(struct sock_fprog *fprog, struct sock *sk);
+extern int sk_attach_bpf(u32 ufd, struct sock *sk);
 extern int sk_detach_filter(struct sock *sk);
 extern int sk_chk_filter(struct sock_filter *filter, unsigned int flen);
+extern void *bpf_internal_load_pointer_neg_helper(const struct sk_buff *skb,
+						 int k, unsigned int size);
 
 #ifdef CONFIG_BPF_JIT
 extern void bpf_jit_compile(struct sk_filter *fp);
 extern void bpf_jit_free(struct sk_filter *fp);
-#define SK_RUN_FILTER(FILTER, SKB) (*FILTER->bpf_func)(SKB, FILTER->insns)
 #else
 static inline void bpf_jit_compile(struct sk_filter *fp)
 {
@@ -183,8 +206,9 @@ static inline void bpf_jit_compile(struct sk_filter *fp)
 static inline void bpf_jit_free(struct sk_filter *fp)
 {
 }
-#define SK_RUN_FILTER(FILTER, SKB) sk_run_filter(SKB, FILTER->insns)
 #endif
+/* bpf_func is sk_run_filter, a classic JIT image or the eBPF trampoline */
+#define SK_RUN_FILTER(FILTER, SKB) (*FILTER->bpf_func)(SKB, FILTER->insns)
 
 enum {
 	BPF_S_RET_K = 1,
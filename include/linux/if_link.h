@@ -142,6 +142,7 @@ enum {
 #define IFLA_PROMISCUITY IFLA_PROMISCUITY
 	IFLA_NUM_TX_QUEUES,
 	IFLA_NUM_RX_QUEUES,
+	IFLA_RX_FILTER,		/* struct sock_filter[], empty to detach */
 	__IFLA_MAX
 };
 
@@ -1440,6 +1440,8 @@ extern unsigned long vm_mmap(struct file *, unsigned long,
 extern void truncate_inode_pages(struct address_space *, loff_t);
 extern void truncate_inode_pages_range(struct address_space *,
 				       loff_t lstart, loff_t lend);
+extern void clear_shadow_entries(struct address_space *mapping,
+				 pgoff_t start, pgoff_t end);
 
 /* generic vm_area_ops exported for stackable file systems */
 extern int filemap_fault(struct vm_area_struct *, struct vm_fault *);
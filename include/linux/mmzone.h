@@ -27,6 +27,9 @@
 #endif
 #define MAX_ORDER_NR_PAGES (1 << (MAX_ORDER - 1))
 
+/* Maximum number of reclaim threads per node, kswapd included */
+#define MAX_KSWAPD_WORKERS 8
+
 /*
  * PAGE_ALLOC_COSTLY_ORDER is the order at which allocations are deemed
  * costly to service.  That is between allocation orders which should
@@ -133,6 +136,8 @@ enum zone_stat_item {
 	NR_SHMEM,		/* shmem pages (included tmpfs/GEM pages) */
 	NR_DIRTIED,		/* page dirtyings since bootup */
 	NR_WRITTEN,		/* page writings since bootup */
+	WORKINGSET_REFAULT,	/* refaults of recently evicted pages */
+	WORKINGSET_ACTIVATE,	/* refaults activated as workingset */
 #ifdef CONFIG_NUMA
 	NUMA_HIT,		/* allocated in intended node */
 	NUMA_MISS,		/* allocated in non intended node */
@@ -232,13 +237,21 @@ enum zone_watermarks {
 #define low_wmark_pages(z) (z->watermark[WMARK_LOW])
 #define high_wmark_pages(z) (z->watermark[WMARK_HIGH])
 
+/*
+ * The pcp-lists cache pages of order 0 to PAGE_ALLOC_COSTLY_ORDER, with one
+ * list per migrate type for each order.
+ */
+#define NR_PCP_ORDERS	(PAGE_ALLOC_COSTLY_ORDER + 1)
+#define NR_PCP_LISTS	(MIGRATE_PCPTYPES * NR_PCP_ORDERS)
+
 struct per_cpu_pages {
-	int count;		/* number of pages in the list */
+	int count;		/* number of base pages in the lists */
 	int high;		/* high watermark, emptying needed */
 	int batch;		/* chunk size for buddy add/remove */
+	int free_factor;	/* batch scaling factor during free */
 
-	/* Lists of pages, one per migrate type stored on the pcp-lists */
-	struct list_head lists[MIGRATE_PCPTYPES];
+	/* Lists of pages, one per migrate type and order */
+	struct list_head lists[NR_PCP_LISTS];
 };
 
 struct per_cpu_pageset {
@@ -410,6 +423,9 @@ struct zone {
 	spinlock_t		lru_lock;
 	struct lruvec		lruvec;
 
+	/* Evictions & activations on the inactive file list */
+	atomic_long_t		inactive_age;
+
 	unsigned long		pages_scanned;	   /* since last reclaim */
 	unsigned long		flags;		   /* zone flags, see below */
 
@@ -709,6 +725,17 @@ typedef struct pglist_data {
 	struct task_struct *kswapd;	/* Protected by lock_memory_hotplug() */
 	int kswapd_max_order;
 	enum zone_type classzone_idx;
+	/*
+	 * Extra reclaim threads which kswapd brings in when it cannot keep
+	 * up on its own.  Slot 0 is kswapd itself and is left unused.
+	 */
+	wait_queue_head_t kswapd_worker_wait;
+	struct task_struct *kswapd_workers[MAX_KSWAPD_WORKERS];
+	int kswapd_workers_active;	/* workers [1, active) are wanted */
+	unsigned int kswapd_pass;	/* bumped for each kswapd pass */
+	int kswapd_order;		/* kswapd's current reclaim order */
+	int kswapd_end_zone;		/* kswapd's current highest zone */
+	int kswapd_priority;		/* kswapd's current scan priority */
 } pg_data_t;
 
 #define node_present_pages(nid)	(NODE_DATA(nid)->node_present_pages)
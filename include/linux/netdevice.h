@@ -33,6 +33,7 @@
 #ifdef __KERNEL__
 #include <linux/pm_qos.h>
 #include <linux/timer.h>
+#include <linux/hrtimer.h>
 #include <linux/bug.h>
 #include <linux/delay.h>
 #include <linux/atomic.h>
@@ -59,6 +60,9 @@
 struct netpoll_info;
 struct device;
 struct phy_device;
+struct sk_filter;
+struct sk_filter_orig;
+struct sock_fprog;
 /* 802.11 specific */
 struct wireless_dev;
 					/* source back-compat hooks */
@@ -350,12 +354,18 @@ struct napi_struct {
 	struct list_head	dev_list;
 	struct sk_buff		*gro_list;
 	struct sk_buff		*skb;
+	struct hrtimer		timer;
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	unsigned int		napi_id;
+	struct hlist_node	napi_hash_node;
+#endif
 };
 
 enum {
 	NAPI_STATE_SCHED,	/* Poll is scheduled */
 	NAPI_STATE_DISABLE,	/* Disable pending */
 	NAPI_STATE_NPSVC,	/* Netpoll - don't dequeue from poll_list */
+	NAPI_STATE_HASHED,	/* In NAPI hash, busy polling allowed */
 };
 
 enum gro_result {
@@ -462,14 +472,20 @@ static inline bool napi_reschedule(struct napi_struct *napi)
 	return false;
 }
 
+extern void __napi_complete(struct napi_struct *n);
+extern void napi_complete_done(struct napi_struct *n, int work_done);
+
 /**
  *	napi_complete - NAPI processing complete
  *	@n: napi context
  *
  * Mark NAPI processing as complete.
+ * Consider using napi_complete_done() instead.
  */
-extern void __napi_complete(struct napi_struct *n);
-extern void napi_complete(struct napi_struct *n);
+static inline void napi_complete(struct napi_struct *n)
+{
+	napi_complete_done(n, 0);
+}
 
 /**
  *	napi_disable - prevent NAPI from scheduling
@@ -483,6 +499,7 @@ static inline void napi_disable(struct napi_struct *n)
 	set_bit(NAPI_STATE_DISABLE, &n->state);
 	while (test_and_set_bit(NAPI_STATE_SCHED, &n->state))
 		msleep(1);
+	hrtimer_cancel(&n->timer);
 	clear_bit(NAPI_STATE_DISABLE, &n->state);
 }
 
@@ -518,6 +535,28 @@ static inline void napi_synchronize(const struct napi_struct *n)
 # define napi_synchronize(n)	barrier()
 #endif
 
+/**
+ *	napi_busy_lock - claim an idle napi context for busy polling
+ *	@n: napi context
+ *
+ * Take the NAPI_STATE_SCHED bit the way napi_schedule_prep() does, but
+ * without putting the context on the poll list.  On success neither NAPI
+ * nor napi_disable() can touch the device queue until napi_busy_unlock(),
+ * so an ndo_busy_poll implementation may run its receive loop.  Interrupts
+ * that came in meanwhile found the context busy and did nothing, so the
+ * driver must look for more work after unlocking and schedule NAPI itself.
+ */
+static inline bool napi_busy_lock(struct napi_struct *n)
+{
+	return napi_schedule_prep(n);
+}
+
+static inline void napi_busy_unlock(struct napi_struct *n)
+{
+	smp_mb__before_clear_bit();
+	clear_bit(NAPI_STATE_SCHED, &n->state);
+}
+
 enum netdev_queue_state_t {
 	__QUEUE_STATE_DRV_XOFF,
 	__QUEUE_STATE_STACK_XOFF,
@@ -820,6 +859,13 @@ struct netdev_fcoe_hbainfo {
  *
  * void (*ndo_poll_controller)(struct net_device *dev);
  *
+ * int (*ndo_busy_poll)(struct napi_struct *napi);
+ *	Called, with BHs disabled, from a socket that busy polls the receive
+ *	queue behind @napi.  Receives a few packets without waiting for an
+ *	interrupt and returns how many, LL_FLUSH_BUSY if the queue is owned by
+ *	NAPI right now, or LL_FLUSH_FAILED if it cannot be polled at all.
+ *	Only napi contexts added with napi_hash_add() are polled.
+ *
  *	SR-IOV management functions.
  * int (*ndo_set_vf_mac)(struct net_device *dev, int vf, u8* mac);
  * int (*ndo_set_vf_vlan)(struct net_device *dev, int vf, u16 vlan, u8 qos);
@@ -956,6 +1002,9 @@ struct net_device_ops {
 						     struct netpoll_info *info,
 						     gfp_t gfp);
 	void			(*ndo_netpoll_cleanup)(struct net_device *dev);
+#endif
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	int			(*ndo_busy_poll)(struct napi_struct *napi);
 #endif
 	int			(*ndo_set_vf_mac)(struct net_device *dev,
 						  int queue, u8 *mac);
@@ -1208,8 +1257,16 @@ struct net_device {
 	rx_handler_func_t __rcu	*rx_handler;
 	void __rcu		*rx_handler_data;
 
+	/* BPF program run on every received frame, see dev_change_rx_filter() */
+	struct sk_filter __rcu	*rx_filter;
+	/* The program as it was set, for IFLA_RX_FILTER dumps */
+	struct sk_filter_orig __rcu *rx_filter_orig;
+
 	struct netdev_queue __rcu *ingress_queue;
 
+	/* Nanoseconds GRO packets may be held past the end of a poll */
+	unsigned long		gro_flush_timeout;
+
 /*
  * Cache lines mostly used on transmit path
  */
@@ -1482,6 +1539,21 @@ void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
  */
 void netif_napi_del(struct napi_struct *napi);
 
+#ifdef CONFIG_NET_RX_BUSY_POLL
+/**
+ *	napi_hash_add - make a napi context available for busy polling
+ *	@napi: napi context
+ *
+ * Give @napi a unique napi_id, which the driver stamps on received skbs
+ * with skb_mark_napi_id().  netif_napi_del() removes it again.
+ */
+void napi_hash_add(struct napi_struct *napi);
+#else
+static inline void napi_hash_add(struct napi_struct *napi)
+{
+}
+#endif
+
 struct napi_gro_cb {
 	/* Virtual address of skb_shinfo(skb)->frags[0].page + offset. */
 	void *frag0;
@@ -1492,19 +1564,28 @@ struct napi_gro_cb {
 	/* This indicates where we are processing relative to skb->data. */
 	int data_offset;
 
-	/* This is non-zero if the packet may be of the same flow. */
-	int same_flow;
-
 	/* This is non-zero if the packet cannot be merged with the new skb. */
 	int flush;
 
 	/* Number of segments aggregated. */
 	int count;
 
+	/* jiffies when the skb was put on the gro_list. */
+	u32 age;
+
+	/* This is non-zero if the packet may be of the same flow. */
+	u8 same_flow;
+
 	/* Free the skb? */
-	int free;
+	u8 free;
 #define NAPI_GRO_FREE		  1
 #define NAPI_GRO_FREE_STOLEN_HEAD 2
+
+	/* Set once a tunnel header has been pulled; tunnels do not nest. */
+	u8 encap_mark;
+
+	/* Tail of the frag_list of an aggregate built by skb_gro_receive(). */
+	struct sk_buff *last;
 };
 
 #define NAPI_GRO_CB(skb) ((struct napi_gro_cb *)(skb)->cb)
@@ -1521,7 +1602,7 @@ struct packet_type {
 	int			(*gso_send_check)(struct sk_buff *skb);
 	struct sk_buff		**(*gro_receive)(struct sk_buff **head,
 					       struct sk_buff *skb);
-	int			(*gro_complete)(struct sk_buff *skb);
+	int			(*gro_complete)(struct sk_buff *skb, int nhoff);
 	bool			(*id_match)(struct packet_type *ptype,
 					    struct sock *sk);
 	void			*af_packet_priv;
@@ -1708,6 +1789,25 @@ static inline void *skb_gro_network_header(struct sk_buff *skb)
 	       skb_network_offset(skb);
 }
 
+/*
+ * Called by tunnel gro_receive handlers once the encapsulation headers
+ * (@hdr, @hlen bytes) have been pulled, so that skb->csum covers just the
+ * inner packet the inner transport verifies.  Without a checksum from the
+ * device the inner packet is summed here.  The caller restores ip_summed
+ * and csum for the outer packet afterwards.
+ */
+static inline void skb_gro_encap_rcsum(struct sk_buff *skb, const void *hdr,
+				       unsigned int hlen)
+{
+	if (skb->ip_summed == CHECKSUM_COMPLETE) {
+		skb->csum = csum_sub(skb->csum, csum_partial(hdr, hlen, 0));
+		return;
+	}
+
+	skb->csum = skb_checksum(skb, skb_gro_offset(skb), skb_gro_len(skb), 0);
+	skb->ip_summed = CHECKSUM_COMPLETE;
+}
+
 static inline int dev_hard_header(struct sk_buff *skb, struct net_device *dev,
 				  unsigned short type,
 				  const void *daddr, const void *saddr,
@@ -2152,7 +2252,9 @@ extern gro_result_t	dev_gro_receive(struct napi_struct *napi,
 extern gro_result_t	napi_skb_finish(gro_result_t ret, struct sk_buff *skb);
 extern gro_result_t	napi_gro_receive(struct napi_struct *napi,
 					 struct sk_buff *skb);
-extern void		napi_gro_flush(struct napi_struct *napi);
+extern void		napi_gro_flush(struct napi_struct *napi, bool flush_old);
+extern struct packet_type *gro_find_receive_by_type(__be16 type);
+extern struct packet_type *gro_find_complete_by_type(__be16 type);
 extern struct sk_buff *	napi_get_frags(struct napi_struct *napi);
 extern gro_result_t	napi_frags_finish(struct napi_struct *napi,
 					  struct sk_buff *skb,
@@ -2183,6 +2285,10 @@ extern int		dev_change_net_namespace(struct net_device *,
 						 struct net *, const char *);
 extern int		dev_set_mtu(struct net_device *, int);
 extern void		dev_set_group(struct net_device *, int);
+extern int		dev_change_rx_filter(struct net_device *dev,
+					     struct sock_fprog *fprog);
+extern bool		dev_rx_filter_act(struct sk_buff *skb,
+					  unsigned int verdict);
 extern int		dev_set_mac_address(struct net_device *,
 					    struct sockaddr *);
 extern int		dev_hard_start_xmit(struct sk_buff *skb,
@@ -2190,6 +2296,8 @@ extern int		dev_hard_start_xmit(struct sk_buff *skb,
 					    struct netdev_queue *txq);
 extern int		dev_forward_skb(struct net_device *dev,
 					struct sk_buff *skb);
+extern int		__dev_forward_skb(struct net_device *dev,
+					  struct sk_buff *skb);
 
 extern int		netdev_budget;
 
@@ -2620,6 +2728,10 @@ extern int netdev_set_bond_master(struct net_device *dev,
 extern int skb_checksum_help(struct sk_buff *skb);
 extern struct sk_buff *skb_gso_segment(struct sk_buff *skb,
 	netdev_features_t features);
+extern struct sk_buff *skb_mac_gso_segment(struct sk_buff *skb,
+	netdev_features_t features);
+extern struct sk_buff *skb_encap_gso_segment(struct sk_buff *skb,
+	netdev_features_t features, unsigned int hlen, __be16 type);
 #ifdef CONFIG_BUG
 extern void netdev_rx_csum_fault(struct net_device *dev);
 #else
@@ -2673,6 +2785,8 @@ static inline bool net_gso_ok(netdev_features_t features, int gso_type)
 	BUILD_BUG_ON(SKB_GSO_TCP_ECN != (NETIF_F_TSO_ECN >> NETIF_F_GSO_SHIFT));
 	BUILD_BUG_ON(SKB_GSO_TCPV6   != (NETIF_F_TSO6 >> NETIF_F_GSO_SHIFT));
 	BUILD_BUG_ON(SKB_GSO_FCOE    != (NETIF_F_FSO >> NETIF_F_GSO_SHIFT));
+	BUILD_BUG_ON(SKB_GSO_GRE     != (NETIF_F_GSO_GRE >> NETIF_F_GSO_SHIFT));
+	BUILD_BUG_ON(SKB_GSO_UDP_TUNNEL != (NETIF_F_GSO_UDP_TUNNEL >> NETIF_F_GSO_SHIFT));
 
 	return (features & feature) == feature;
 }
@@ -129,4 +129,8 @@ long clock_nanosleep_restart(struct restart_block *restart_block);
 
 void update_rlimit_cpu(struct task_struct *task, unsigned long rlim_new);
 
+#ifdef CONFIG_NO_HZ_FULL
+bool posix_cpu_timers_can_stop_tick(struct task_struct *tsk);
+#endif
+
 #endif
@@ -34,6 +34,7 @@ extern void rcu_init(void);
 extern void rcu_note_context_switch(int cpu);
 extern int rcu_needs_cpu(int cpu, unsigned long *delta_jiffies);
 extern void rcu_cpu_stall_reset(void);
+extern int rcu_nohz_full_needs_tick(int cpu);
 
 /*
  * Note a virtualization-based context switch.  This is simply a
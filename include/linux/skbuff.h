@@ -108,6 +108,7 @@
 struct net_device;
 struct scatterlist;
 struct pipe_inode_info;
+struct sock;
 
 #if defined(CONFIG_NF_CONNTRACK) || defined(CONFIG_NF_CONNTRACK_MODULE)
 struct nf_conntrack {
@@ -235,15 +236,57 @@ enum {
 /*
  * The callback notifies userspace to release buffers when skb DMA is done in
  * lower device, the skb last reference should be 0 when calling this.
+ * The zerocopy_success argument is false if the data had to be copied
+ * before the device was done with the user pages.
  * The ctx field is used to track device context.
  * The desc field is used to track userspace buffer index.
+ *
+ * For MSG_ZEROCOPY sockets the structure lives in the cb of the completion
+ * notification skb instead, is shared by all skbs built from one or more
+ * adjacent sendmsg calls and is reference counted: id and len describe the
+ * range of sendmsg calls it covers, and mmp the RLIMIT_MEMLOCK charge for
+ * the pinned pages.
  */
 struct ubuf_info {
-	void (*callback)(struct ubuf_info *);
-	void *ctx;
-	unsigned long desc;
+	void (*callback)(struct ubuf_info *, bool zerocopy_success);
+	union {
+		struct {
+			void *ctx;
+			unsigned long desc;
+		};
+		struct {
+			u32 id;
+			u16 len;
+			u16 zerocopy:1;
+			u32 bytelen;
+		};
+	};
+	atomic_t refcnt;
+
+	struct mmpin {
+		struct user_struct *user;
+		unsigned int num_pg;
+	} mmp;
 };
 
+#define skb_uarg(SKB)	((struct ubuf_info *)(skb_shinfo(SKB)->destructor_arg))
+
+extern struct ubuf_info *sock_zerocopy_alloc(struct sock *sk, size_t size);
+extern struct ubuf_info *sock_zerocopy_realloc(struct sock *sk, size_t size,
+					       struct ubuf_info *uarg);
+
+static inline void sock_zerocopy_get(struct ubuf_info *uarg)
+{
+	atomic_inc(&uarg->refcnt);
+}
+
+extern void sock_zerocopy_put(struct ubuf_info *uarg);
+extern void sock_zerocopy_put_abort(struct ubuf_info *uarg);
+extern void sock_zerocopy_callback(struct ubuf_info *uarg, bool success);
+extern int skb_zerocopy_add_user(struct sock *sk, struct sk_buff *skb,
+				 const unsigned char __user *from, int len,
+				 struct ubuf_info *uarg);
+
 /* This data is invariant across clones and lives at
  * the end of the header data, ie. at skb->end.
  */
@@ -305,6 +348,14 @@ enum {
 	SKB_GSO_TCPV6 = 1 << 4,
 
 	SKB_GSO_FCOE = 1 << 5,
+
+	/* This indicates a TCP packet carried in a GRE or UDP tunnel,
+	 * built by tunnel GRO.  The outer headers must be replicated
+	 * for each segment.
+	 */
+	SKB_GSO_GRE = 1 << 6,
+
+	SKB_GSO_UDP_TUNNEL = 1 << 7,
 };
 
 #if BITS_PER_LONG > 32
@@ -371,6 +422,7 @@ typedef unsigned char *sk_buff_data_t;
  *	@dma_cookie: a cookie to one of several possible DMA operations
  *		done by skb DMA functions
  *	@secmark: security marking
+ *	@napi_id: id of the NAPI struct this skb came from
  *	@mark: Generic packet mark
  *	@dropcount: total number of sk_receive_queue overflows
  *	@vlan_tci: vlan tag control information
@@ -477,6 +529,9 @@ struct sk_buff {
 #endif
 #ifdef CONFIG_NETWORK_SECMARK
 	__u32			secmark;
+#endif
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	unsigned int		napi_id;
 #endif
 	union {
 		__u32		mark;
@@ -1687,6 +1742,39 @@ static inline void skb_orphan(struct sk_buff *skb)
 	skb->sk		= NULL;
 }
 
+static inline struct ubuf_info *skb_zcopy(struct sk_buff *skb)
+{
+	bool is_zcopy = skb && skb_shinfo(skb)->tx_flags & SKBTX_DEV_ZEROCOPY;
+
+	return is_zcopy ? skb_uarg(skb) : NULL;
+}
+
+/* Attach a MSG_ZEROCOPY uarg to an skb that does not carry one yet */
+static inline void skb_zcopy_set(struct sk_buff *skb, struct ubuf_info *uarg)
+{
+	if (skb && uarg && !skb_zcopy(skb)) {
+		sock_zerocopy_get(uarg);
+		skb_shinfo(skb)->destructor_arg = uarg;
+		skb_shinfo(skb)->tx_flags |= SKBTX_DEV_ZEROCOPY;
+	}
+}
+
+/* Release the uarg of an skb, reporting whether its frags were copied */
+static inline void skb_zcopy_clear(struct sk_buff *skb, bool zerocopy)
+{
+	struct ubuf_info *uarg = skb_zcopy(skb);
+
+	if (uarg) {
+		if (uarg->callback == sock_zerocopy_callback) {
+			uarg->zerocopy = uarg->zerocopy && zerocopy;
+			sock_zerocopy_put(uarg);
+		} else if (uarg->callback) {
+			uarg->callback(uarg, zerocopy);
+		}
+		skb_shinfo(skb)->tx_flags &= ~SKBTX_DEV_ZEROCOPY;
+	}
+}
+
 /**
  *	skb_orphan_frags - orphan the frags contained in a buffer
  *	@skb: buffer to orphan frags from
@@ -1695,10 +1783,32 @@ static inline void skb_orphan(struct sk_buff *skb)
  *	For each frag in the SKB which needs a destructor (i.e. has an
  *	owner) create a copy of that frag and release the original
  *	page by calling the destructor.
+ *
+ *	MSG_ZEROCOPY frags are reference counted through their uarg and
+ *	may be shared by clones on the transmit path, so they are left
+ *	alone here; see skb_orphan_frags_rx().
  */
 static inline int skb_orphan_frags(struct sk_buff *skb, gfp_t gfp_mask)
 {
-	if (likely(!(skb_shinfo(skb)->tx_flags & SKBTX_DEV_ZEROCOPY)))
+	if (likely(!skb_zcopy(skb)))
+		return 0;
+	if (skb_uarg(skb)->callback == sock_zerocopy_callback)
+		return 0;
+	return skb_copy_ubufs(skb, gfp_mask);
+}
+
+/**
+ *	skb_orphan_frags_rx - orphan the frags of a buffer headed for receive
+ *	@skb: buffer to orphan frags from
+ *	@gfp_mask: allocation mask for replacement pages
+ *
+ *	Like skb_orphan_frags(), but also copies MSG_ZEROCOPY frags: a looped
+ *	back or forwarded skb may be queued on a receiving socket for an
+ *	unbounded time, which must not delay the sender's notification.
+ */
+static inline int skb_orphan_frags_rx(struct sk_buff *skb, gfp_t gfp_mask)
+{
+	if (likely(!skb_zcopy(skb)))
 		return 0;
 	return skb_copy_ubufs(skb, gfp_mask);
 }
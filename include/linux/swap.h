@@ -253,6 +253,14 @@ static inline void lru_cache_add_file(struct page *page)
 	__lru_cache_add(page, LRU_INACTIVE_FILE);
 }
 
+/* linux/mm/workingset.c */
+void *workingset_eviction(struct address_space *mapping, struct page *page);
+bool workingset_refault(void *shadow);
+void workingset_activation(struct page *page);
+void workingset_shadow_added(struct address_space *mapping);
+void workingset_shadows_removed(struct address_space *mapping,
+				unsigned long nr);
+
 /* linux/mm/vmscan.c */
 extern unsigned long try_to_free_pages(struct zonelist *zonelist, int order,
 					gfp_t gfp_mask, nodemask_t *mask);
@@ -300,8 +308,11 @@ static inline void scan_unevictable_unregister_node(struct node *node)
 }
 #endif
 
+extern int kswapd_threads;
 extern int kswapd_run(int nid);
 extern void kswapd_stop(int nid);
+extern int kswapd_threads_sysctl_handler(struct ctl_table *, int,
+					void __user *, size_t *, loff_t *);
 #ifdef CONFIG_MEMCG
 extern int mem_cgroup_swappiness(struct mem_cgroup *mem);
 #else
@@ -8,6 +8,7 @@
 
 #include <linux/clockchips.h>
 #include <linux/irqflags.h>
+#include <linux/cpumask.h>
 
 #ifdef CONFIG_GENERIC_CLOCKEVENTS
 
@@ -46,6 +47,9 @@ enum tick_nohz_mode {
  * @iowait_sleeptime:	Sum of the time slept in idle with sched tick stopped, with IO outstanding
  * @sleep_length:	Duration of the current idle sleep
  * @do_timer_lst:	CPU was the last one doing do_timer before going idle
+ * @busy_jiffies:	jiffies up to which cputime was accounted while the
+ *			tick is stopped on a busy full dynticks CPU
+ * @busy_user:		The busy task was last seen running in user mode
  */
 struct tick_sched {
 	struct hrtimer			sched_timer;
@@ -68,6 +72,8 @@ struct tick_sched {
 	unsigned long			next_jiffies;
 	ktime_t				idle_expires;
 	int				do_timer_last;
+	unsigned long			busy_jiffies;
+	int				busy_user;
 };
 
 extern void __init tick_init(void);
@@ -142,4 +148,46 @@ static inline u64 get_cpu_idle_time_us(int cpu, u64 *unused) { return -1; }
 static inline u64 get_cpu_iowait_time_us(int cpu, u64 *unused) { return -1; }
 # endif /* !NO_HZ */
 
+struct task_struct;
+
+#ifdef CONFIG_NO_HZ_FULL
+extern cpumask_var_t tick_nohz_full_mask;
+extern bool tick_nohz_full_running;
+
+static inline bool tick_nohz_full_enabled(void)
+{
+	return tick_nohz_full_running;
+}
+
+static inline bool tick_nohz_full_cpu(int cpu)
+{
+	if (!tick_nohz_full_enabled())
+		return false;
+
+	return cpumask_test_cpu(cpu, tick_nohz_full_mask);
+}
+
+extern void tick_nohz_init(void);
+extern void tick_nohz_full_kick(void);
+extern void tick_nohz_full_kick_cpu(int cpu);
+extern void tick_nohz_full_kick_all(void);
+extern void tick_nohz_full_check(void);
+extern void __tick_nohz_task_switch(struct task_struct *prev);
+
+static inline void tick_nohz_task_switch(struct task_struct *prev)
+{
+	if (tick_nohz_full_enabled())
+		__tick_nohz_task_switch(prev);
+}
+#else
+static inline bool tick_nohz_full_enabled(void) { return false; }
+static inline bool tick_nohz_full_cpu(int cpu) { return false; }
+static inline void tick_nohz_init(void) { }
+static inline void tick_nohz_full_kick(void) { }
+static inline void tick_nohz_full_kick_cpu(int cpu) { }
+static inline void tick_nohz_full_kick_all(void) { }
+static inline void tick_nohz_full_check(void) { }
+static inline void tick_nohz_task_switch(struct task_struct *prev) { }
+#endif /* !NO_HZ_FULL */
+
 #endif
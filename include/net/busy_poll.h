@@ -0,0 +1,97 @@
+/*
+ * net busy poll support
+ *
+ * Sockets that opted in with SO_BUSY_POLL (or through the net.core.busy_read
+ * default) remember the NAPI context their last packet arrived on.  When
+ * such a socket finds its receive queue empty, recvmsg and poll spin on
+ * that NAPI context through the driver's ndo_busy_poll hook for a bounded
+ * time, rather than waiting for the interrupt, the softirq and the wakeup.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ */
+
+#ifndef _LINUX_NET_BUSY_POLL_H
+#define _LINUX_NET_BUSY_POLL_H
+
+#include <linux/netdevice.h>
+#include <linux/sched.h>
+#include <net/sock.h>
+
+/* return values from ndo_busy_poll */
+#define LL_FLUSH_FAILED		-1	/* device cannot poll, stop spinning */
+#define LL_FLUSH_BUSY		-2	/* NAPI owns the queue right now */
+
+#ifdef CONFIG_NET_RX_BUSY_POLL
+
+extern unsigned int sysctl_net_busy_read __read_mostly;
+extern unsigned int sysctl_net_busy_poll __read_mostly;
+
+extern struct napi_struct *napi_by_id(unsigned int napi_id);
+extern bool __sk_busy_loop(struct sock *sk, unsigned int usecs);
+
+static inline bool sk_can_busy_loop(const struct sock *sk)
+{
+	return sk->sk_ll_usec && sk->sk_napi_id &&
+	       !need_resched() && !signal_pending(current);
+}
+
+/*
+ * Spin for up to the socket's busy poll time, or make a single pass when
+ * @nonblock is set.  Returns true if the receive queue is no longer empty.
+ */
+static inline bool sk_busy_loop(struct sock *sk, int nonblock)
+{
+	return __sk_busy_loop(sk, nonblock ? 0 : ACCESS_ONCE(sk->sk_ll_usec));
+}
+
+/* used in the poll/select path, with the net.core.busy_poll budget */
+static inline bool sk_poll_busy_loop(struct sock *sk)
+{
+	unsigned int usecs = ACCESS_ONCE(sysctl_net_busy_poll);
+
+	return usecs && __sk_busy_loop(sk, usecs);
+}
+
+/* used in the NIC receive handler to mark the skb */
+static inline void skb_mark_napi_id(struct sk_buff *skb,
+				    struct napi_struct *napi)
+{
+	skb->napi_id = napi->napi_id;
+}
+
+/* used in the protocol handler to propagate the napi_id to the socket */
+static inline void sk_mark_napi_id(struct sock *sk, const struct sk_buff *skb)
+{
+	sk->sk_napi_id = skb->napi_id;
+}
+
+#else /* CONFIG_NET_RX_BUSY_POLL */
+
+static inline bool sk_can_busy_loop(const struct sock *sk)
+{
+	return false;
+}
+
+static inline bool sk_busy_loop(struct sock *sk, int nonblock)
+{
+	return false;
+}
+
+static inline bool sk_poll_busy_loop(struct sock *sk)
+{
+	return false;
+}
+
+static inline void skb_mark_napi_id(struct sk_buff *skb,
+				    struct napi_struct *napi)
+{
+}
+
+static inline void sk_mark_napi_id(struct sock *sk, const struct sk_buff *skb)
+{
+}
+
+#endif /* CONFIG_NET_RX_BUSY_POLL */
+#endif /* _LINUX_NET_BUSY_POLL_H */
@@ -54,6 +54,7 @@ static inline int inet6_sk_ehashfn(const struct sock *sk)
 }
 
 extern int __inet6_hash(struct sock *sk, struct inet_timewait_sock *twp);
+extern bool inet6_ehash_nolisten(struct sock *sk, struct request_sock *req);
 
 /*
  * Sockets in TCP_CLOSE state are _always_ taken out of the hash, so
@@ -69,6 +70,14 @@ extern struct sock *__inet6_lookup_established(struct net *net,
 					   const u16 hnum,
 					   const int dif);
 
+extern struct request_sock *__inet6_lookup_reqsk(struct net *net,
+						 struct inet_hashinfo *hashinfo,
+						 const struct in6_addr *saddr,
+						 const __be16 sport,
+						 const struct in6_addr *daddr,
+						 const u16 hnum,
+						 const int dif);
+
 extern struct sock *inet6_lookup_listener(struct net *net,
 					  struct inet_hashinfo *hashinfo,
 					  const struct in6_addr *daddr,
@@ -62,6 +62,7 @@ struct inet_connection_sock_af_ops {
 	void	    (*addr2sockaddr)(struct sock *sk, struct sockaddr *);
 	int	    (*bind_conflict)(const struct sock *sk,
 				     const struct inet_bind_bucket *tb, bool relax);
+	int	    (*recv_error)(struct sock *sk, struct msghdr *msg, int len);
 };
 
 /** inet_connection_sock - INET connection oriented sock
@@ -240,8 +241,7 @@ static inline void inet_csk_reset_xmit_timer(struct sock *sk, const int what,
 
 extern struct sock *inet_csk_accept(struct sock *sk, int flags, int *err);
 
-extern struct request_sock *inet_csk_search_req(const struct sock *sk,
-						struct request_sock ***prevp,
+extern struct request_sock *inet_csk_search_req(struct sock *sk,
 						const __be16 rport,
 						const __be32 raddr,
 						const __be32 laddr);
@@ -256,31 +256,20 @@ extern struct dst_entry* inet_csk_route_child_sock(struct sock *sk,
 						   struct sock *newsk,
 						   const struct request_sock *req);
 
-static inline void inet_csk_reqsk_queue_add(struct sock *sk,
-					    struct request_sock *req,
-					    struct sock *child)
-{
-	reqsk_queue_add(&inet_csk(sk)->icsk_accept_queue, req, sk, child);
-}
+extern struct sock *inet_csk_reqsk_queue_add(struct sock *sk,
+					     struct request_sock *req,
+					     struct sock *child);
+extern struct sock *inet_csk_complete_hashdance(struct sock *sk,
+						struct sock *child,
+						struct request_sock *req);
 
+extern void __inet_csk_reqsk_queue_hash_add(struct sock *sk,
+					    struct request_sock *req,
+					    unsigned long timeout);
 extern void inet_csk_reqsk_queue_hash_add(struct sock *sk,
 					  struct request_sock *req,
 					  unsigned long timeout);
 
-static inline void inet_csk_reqsk_queue_removed(struct sock *sk,
-						struct request_sock *req)
-{
-	if (reqsk_queue_removed(&inet_csk(sk)->icsk_accept_queue, req) == 0)
-		inet_csk_delete_keepalive_timer(sk);
-}
-
-static inline void inet_csk_reqsk_queue_added(struct sock *sk,
-					      const unsigned long timeout)
-{
-	if (reqsk_queue_added(&inet_csk(sk)->icsk_accept_queue) == 0)
-		inet_csk_reset_keepalive_timer(sk, timeout);
-}
-
 static inline int inet_csk_reqsk_queue_len(const struct sock *sk)
 {
 	return reqsk_queue_len(&inet_csk(sk)->icsk_accept_queue);
@@ -296,26 +285,20 @@ static inline int inet_csk_reqsk_queue_is_full(const struct sock *sk)
 	return reqsk_queue_is_full(&inet_csk(sk)->icsk_accept_queue);
 }
 
-static inline void inet_csk_reqsk_queue_unlink(struct sock *sk,
-					       struct request_sock *req,
-					       struct request_sock **prev)
+static inline int inet_csk_acceptq_len(const struct sock *sk)
 {
-	reqsk_queue_unlink(&inet_csk(sk)->icsk_accept_queue, req, prev);
+	return reqsk_queue_accept_len(&inet_csk(sk)->icsk_accept_queue);
 }
 
-static inline void inet_csk_reqsk_queue_drop(struct sock *sk,
-					     struct request_sock *req,
-					     struct request_sock **prev)
+static inline bool inet_csk_acceptq_is_full(const struct sock *sk)
 {
-	inet_csk_reqsk_queue_unlink(sk, req, prev);
-	inet_csk_reqsk_queue_removed(sk, req);
-	reqsk_free(req);
+	return inet_csk_acceptq_len(sk) > sk->sk_max_ack_backlog;
 }
 
-extern void inet_csk_reqsk_queue_prune(struct sock *parent,
-				       const unsigned long interval,
-				       const unsigned long timeout,
-				       const unsigned long max_rto);
+extern bool inet_csk_reqsk_queue_drop(struct sock *sk,
+				      struct request_sock *req);
+extern void inet_csk_reqsk_queue_drop_and_put(struct sock *sk,
+					      struct request_sock *req);
 
 extern void inet_csk_destroy_sock(struct sock *sk);
 
@@ -328,7 +311,7 @@ static inline unsigned int inet_csk_listen_poll(const struct sock *sk)
 			(POLLIN | POLLRDNORM) : 0;
 }
 
-extern int  inet_csk_listen_start(struct sock *sk, const int nr_table_entries);
+extern int  inet_csk_listen_start(struct sock *sk, const int backlog);
 extern void inet_csk_listen_stop(struct sock *sk);
 
 extern void inet_csk_addr2sockaddr(struct sock *sk, struct sockaddr *uaddr);
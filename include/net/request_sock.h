@@ -47,9 +47,18 @@ struct request_sock_ops {
 	void		(*destructor)(struct request_sock *req);
 	void		(*syn_ack_timeout)(struct sock *sk,
 					   struct request_sock *req);
+	/* SYN-ACK retransmit timeout, doubled on each retransmit up to max */
+	unsigned int	timeout_init;
+	unsigned int	rto_max;
 };
 
 /* struct request_sock - mini sock to represent a connection request
+ *
+ * Requests answered with a SYN-ACK are hashed in the established hash
+ * of the listener's protocol (@rsk_node on the bucket's reqchain) and
+ * looked up there without the listener lock.  They are refcounted from
+ * the moment they are hashed; until then, and for syncookie and Fast
+ * Open requests that never are, @rsk_refcnt stays 0.
  */
 struct request_sock {
 	struct request_sock		*dl_next; /* Must be first member! */
@@ -65,14 +74,26 @@ struct request_sock {
 	struct sock			*sk;
 	u32				secid;
 	u32				peer_secid;
+	struct hlist_nulls_node		rsk_node;
+	unsigned int			rsk_hash;
+	atomic_t			rsk_refcnt;
+	struct sock			*rsk_listener;
+	struct timer_list		rsk_timer;
 };
 
 static inline struct request_sock *reqsk_alloc(const struct request_sock_ops *ops)
 {
 	struct request_sock *req = kmem_cache_alloc(ops->slab, GFP_ATOMIC);
 
-	if (req != NULL)
+	if (req != NULL) {
 		req->rsk_ops = ops;
+		req->rsk_listener = NULL;
+		/* Lockless lookups may still walk a recycled request
+		 * (SLAB_DESTROY_BY_RCU): leave rsk_node.next alone.
+		 */
+		req->rsk_node.pprev = NULL;
+		atomic_set(&req->rsk_refcnt, 0);
+	}
 
 	return req;
 }
@@ -85,25 +106,46 @@ static inline void __reqsk_free(struct request_sock *req)
 static inline void reqsk_free(struct request_sock *req)
 {
 	req->rsk_ops->destructor(req);
+	if (req->rsk_listener)
+		sock_put(req->rsk_listener);
 	__reqsk_free(req);
 }
 
+static inline void reqsk_put(struct request_sock *req)
+{
+	if (atomic_dec_and_test(&req->rsk_refcnt))
+		reqsk_free(req);
+}
+
+static inline bool reqsk_unhashed(const struct request_sock *req)
+{
+	return hlist_nulls_unhashed(&req->rsk_node);
+}
+
 extern int sysctl_max_syn_backlog;
 
-/** struct listen_sock - listen state
+/*
+ * For a TCP Fast Open listener -
+ *	lock - protects the access to all the reqsk, which is co-owned by
+ *		the listener and the child socket.
+ *	qlen - pending TFO requests (still in TCP_SYN_RECV).
+ *	max_qlen - max TFO reqs allowed before TFO is disabled.
  *
- * @max_qlen_log - log_2 of maximal queued SYNs/REQUESTs
+ *	The queue is allocated apart from request_sock_queue because TFO
+ *	children may still reference it after the listener is stopped,
+ *	until the listener's sk_refcnt drops to 0.  A listener can also be
+ *	disabled temporarily through shutdown()->tcp_disconnect(), and
+ *	re-enabled later.
  */
-struct listen_sock {
-	u8			max_qlen_log;
-	u8			synflood_warned;
-	/* 2 bytes hole, try to use */
-	int			qlen;
-	int			qlen_young;
-	int			clock_hand;
-	u32			hash_rnd;
-	u32			nr_table_entries;
-	struct request_sock	*syn_table[0];
+struct fastopen_queue {
+	struct request_sock	*rskq_rst_head; /* Keep track of past TFO */
+	struct request_sock	*rskq_rst_tail; /* requests that caused RST.
+						 * This is part of the defense
+						 * against spoofing attack.
+						 */
+	spinlock_t	lock;
+	int		qlen;		/* # of pending (TCP_SYN_RECV) reqs */
+	int		max_qlen;	/* != 0 iff TFO is currently enabled */
 };
 
 /** struct request_sock_queue - queue of request_socks
@@ -111,148 +153,156 @@ struct listen_sock {
  * @rskq_accept_head - FIFO head of established children
  * @rskq_accept_tail - FIFO tail of established children
  * @rskq_defer_accept - User waits for some data after accept()
- * @syn_wait_lock - serializer
- *
- * %syn_wait_lock is necessary only to avoid proc interface having to grab the main
- * lock sock while browsing the listening hash (otherwise it's deadlock prone).
+ * @max_qlen_log - log_2 of maximal queued SYNs/REQUESTs
+ * @qlen - requests waiting in the established hash
+ * @young - requests whose SYN-ACK was not retransmitted yet
+ * @rskq_pending - children queued from softirq context, newest first
+ * @rskq_accept_len - children in the FIFO and in @rskq_pending
  *
- * This lock is acquired in read mode only from listening_get_next() seq_file
- * op and it's acquired in write mode _only_ from code that is actively
- * changing rskq_accept_head. All readers that are holding the master sock lock
- * don't need to grab this lock in read mode too as rskq_accept_head. writes
- * are always protected from the main sock lock.
+ * Children are created without the listener lock and pushed onto the
+ * @rskq_pending stack with cmpxchg().  Only accept() and
+ * inet_csk_listen_stop(), which own the listener lock, consume them:
+ * they take the whole stack with xchg() and append it, oldest first,
+ * to the private FIFO.  inet_csk_listen_stop() leaves RSKQ_CLOSED in
+ * @rskq_pending so that no child is queued to a dead listener.
  */
 struct request_sock_queue {
 	struct request_sock	*rskq_accept_head;
 	struct request_sock	*rskq_accept_tail;
-	rwlock_t		syn_wait_lock;
 	u8			rskq_defer_accept;
-	/* 3 bytes hole, try to pack */
-	struct listen_sock	*listen_opt;
+	u8			max_qlen_log;
+	u8			synflood_warned;
+	/* 1 byte hole, try to pack */
+	atomic_t		qlen;
+	atomic_t		young;
+	struct request_sock	*rskq_pending;
+	atomic_t		rskq_accept_len;
+	struct fastopen_queue	*fastopenq; /* This is non-NULL iff TFO has been
+					     * enabled on this listener. It is
+					     * freed from the listener's
+					     * sk_destruct, see
+					     * tcp_sock_destruct().
+					     */
 };
 
-extern int reqsk_queue_alloc(struct request_sock_queue *queue,
-			     unsigned int nr_table_entries);
+#define RSKQ_CLOSED	((struct request_sock *)1UL)
 
-extern void __reqsk_queue_destroy(struct request_sock_queue *queue);
-extern void reqsk_queue_destroy(struct request_sock_queue *queue);
+extern void reqsk_queue_init(struct request_sock_queue *queue,
+			     unsigned int nr_table_entries);
+extern void reqsk_fastopen_remove(struct sock *sk,
+				  struct request_sock *req, bool reset);
 
-static inline struct request_sock *
-	reqsk_queue_yank_acceptq(struct request_sock_queue *queue)
+static inline int reqsk_queue_empty(const struct request_sock_queue *queue)
 {
-	struct request_sock *req = queue->rskq_accept_head;
+	struct request_sock *pending = ACCESS_ONCE(queue->rskq_pending);
 
-	queue->rskq_accept_head = NULL;
-	return req;
+	return queue->rskq_accept_head == NULL &&
+	       (pending == NULL || pending == RSKQ_CLOSED);
 }
 
-static inline int reqsk_queue_empty(struct request_sock_queue *queue)
+/* Called from softirq context, without the listener lock.  Returns false
+ * if the listener was stopped and the child cannot be queued.
+ */
+static inline bool reqsk_queue_add(struct request_sock_queue *queue,
+				   struct request_sock *req,
+				   struct sock *child)
 {
-	return queue->rskq_accept_head == NULL;
-}
+	struct request_sock *head;
 
-static inline void reqsk_queue_unlink(struct request_sock_queue *queue,
-				      struct request_sock *req,
-				      struct request_sock **prev_req)
-{
-	write_lock(&queue->syn_wait_lock);
-	*prev_req = req->dl_next;
-	write_unlock(&queue->syn_wait_lock);
+	req->sk = child;
+	atomic_inc(&queue->rskq_accept_len);
+	do {
+		head = ACCESS_ONCE(queue->rskq_pending);
+		if (unlikely(head == RSKQ_CLOSED)) {
+			atomic_dec(&queue->rskq_accept_len);
+			return false;
+		}
+		req->dl_next = head;
+	} while (cmpxchg(&queue->rskq_pending, head, req) != head);
+
+	return true;
 }
 
-static inline void reqsk_queue_add(struct request_sock_queue *queue,
-				   struct request_sock *req,
-				   struct sock *parent,
-				   struct sock *child)
+/* Move the pending children onto the FIFO, in arrival order, and leave
+ * @pending (NULL or RSKQ_CLOSED) on the stack.  Caller owns the listener
+ * lock.
+ */
+static inline void reqsk_queue_splice(struct request_sock_queue *queue,
+				      struct request_sock *pending)
 {
-	req->sk = child;
-	sk_acceptq_added(parent);
+	struct request_sock *req, *tail, *fifo = NULL;
+
+	req = xchg(&queue->rskq_pending, pending);
+	if (req == NULL || req == RSKQ_CLOSED)
+		return;
+
+	tail = req;
+	do {
+		struct request_sock *next = req->dl_next;
+
+		req->dl_next = fifo;
+		fifo = req;
+		req = next;
+	} while (req != NULL);
 
 	if (queue->rskq_accept_head == NULL)
-		queue->rskq_accept_head = req;
+		queue->rskq_accept_head = fifo;
 	else
-		queue->rskq_accept_tail->dl_next = req;
-
-	queue->rskq_accept_tail = req;
-	req->dl_next = NULL;
+		queue->rskq_accept_tail->dl_next = fifo;
+	queue->rskq_accept_tail = tail;
 }
 
 static inline struct request_sock *reqsk_queue_remove(struct request_sock_queue *queue)
 {
-	struct request_sock *req = queue->rskq_accept_head;
+	struct request_sock *req;
+
+	if (queue->rskq_accept_head == NULL)
+		reqsk_queue_splice(queue, NULL);
 
-	WARN_ON(req == NULL);
+	req = queue->rskq_accept_head;
+	if (req == NULL)
+		return NULL;
 
 	queue->rskq_accept_head = req->dl_next;
 	if (queue->rskq_accept_head == NULL)
 		queue->rskq_accept_tail = NULL;
+	atomic_dec(&queue->rskq_accept_len);
 
 	return req;
 }
 
-static inline struct sock *reqsk_queue_get_child(struct request_sock_queue *queue,
-						 struct sock *parent)
+static inline void reqsk_queue_removed(struct request_sock_queue *queue,
+				       const struct request_sock *req)
 {
-	struct request_sock *req = reqsk_queue_remove(queue);
-	struct sock *child = req->sk;
-
-	WARN_ON(child == NULL);
-
-	sk_acceptq_removed(parent);
-	__reqsk_free(req);
-	return child;
-}
-
-static inline int reqsk_queue_removed(struct request_sock_queue *queue,
-				      struct request_sock *req)
-{
-	struct listen_sock *lopt = queue->listen_opt;
-
 	if (req->retrans == 0)
-		--lopt->qlen_young;
-
-	return --lopt->qlen;
+		atomic_dec(&queue->young);
+	atomic_dec(&queue->qlen);
 }
 
-static inline int reqsk_queue_added(struct request_sock_queue *queue)
+static inline void reqsk_queue_added(struct request_sock_queue *queue)
 {
-	struct listen_sock *lopt = queue->listen_opt;
-	const int prev_qlen = lopt->qlen;
-
-	lopt->qlen_young++;
-	lopt->qlen++;
-	return prev_qlen;
+	atomic_inc(&queue->young);
+	atomic_inc(&queue->qlen);
 }
 
 static inline int reqsk_queue_len(const struct request_sock_queue *queue)
 {
-	return queue->listen_opt != NULL ? queue->listen_opt->qlen : 0;
+	return atomic_read(&queue->qlen);
 }
 
 static inline int reqsk_queue_len_young(const struct request_sock_queue *queue)
 {
-	return queue->listen_opt->qlen_young;
+	return atomic_read(&queue->young);
 }
 
 static inline int reqsk_queue_is_full(const struct request_sock_queue *queue)
 {
-	return queue->listen_opt->qlen >> queue->listen_opt->max_qlen_log;
+	return reqsk_queue_len(queue) >> queue->max_qlen_log;
 }
 
-static inline void reqsk_queue_hash_req(struct request_sock_queue *queue,
-					u32 hash, struct request_sock *req,
-					unsigned long timeout)
+static inline int reqsk_queue_accept_len(const struct request_sock_queue *queue)
 {
-	struct listen_sock *lopt = queue->listen_opt;
-
-	req->expires = jiffies + timeout;
-	req->retrans = 0;
-	req->sk = NULL;
-	req->dl_next = lopt->syn_table[hash];
-
-	write_lock(&queue->syn_wait_lock);
-	lopt->syn_table[hash] = req;
-	write_unlock(&queue->syn_wait_lock);
+	return atomic_read(&queue->rskq_accept_len);
 }
 
 #endif /* _REQUEST_SOCK_H */
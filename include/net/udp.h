@@ -267,6 +267,28 @@ extern void udp_init(void);
 extern int udp4_ufo_send_check(struct sk_buff *skb);
 extern struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb,
 	netdev_features_t features);
+
+/*
+ * Layout of a UDP encapsulation, registered by the owner of the tunnel
+ * socket on @port so that GRO can aggregate the inner TCP flows and GSO
+ * can split them again.  @hlen bytes of tunnel header, identical for all
+ * packets of a flow, follow the UDP header, then a packet of @inner_proto
+ * (ETH_P_IP, ETH_P_IPV6, or ETH_P_TEB for an Ethernet frame).  Only
+ * datagrams without a UDP checksum are aggregated.  The tunnel's receive
+ * path must clear SKB_GSO_UDP_TUNNEL before handing the inner packet on.
+ */
+struct udp_offload {
+	__be16			port;
+	__be16			inner_proto;
+	unsigned int		hlen;
+	struct list_head	list;
+};
+
+extern int udp_add_offload(struct udp_offload *uo);
+extern void udp_del_offload(struct udp_offload *uo);
+extern struct sk_buff **udp4_gro_receive(struct sk_buff **head,
+					 struct sk_buff *skb);
+extern int udp4_gro_complete(struct sk_buff *skb, int nhoff);
 extern void udp_encap_enable(void);
 #if IS_ENABLED(CONFIG_IPV6)
 extern void udpv6_encap_enable(void);
@@ -0,0 +1,377 @@
+/*
+ * Extended BPF core: interpreter and program lifetime
+ *
+ * eBPF programs are sequences of 64-bit register instructions that use a
+ * small fixed-size stack.  They are checked by the verifier at load time,
+ * so the interpreter below does no bounds or type checking of its own.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ */
+#include <linux/bpf.h>
+#include <linux/filter.h>
+#include <linux/skbuff.h>
+#include <linux/vmalloc.h>
+#include <linux/slab.h>
+#include <linux/ratelimit.h>
+#include <linux/atomic.h>
+#include <linux/math64.h>
+#include <asm/unaligned.h>
+
+/* Registers */
+#define BPF_R0	regs[BPF_REG_0]
+#define BPF_R1	regs[BPF_REG_1]
+#define BPF_R2	regs[BPF_REG_2]
+#define BPF_R3	regs[BPF_REG_3]
+#define BPF_R4	regs[BPF_REG_4]
+#define BPF_R5	regs[BPF_REG_5]
+#define BPF_R6	regs[BPF_REG_6]
+#define BPF_FP	regs[BPF_REG_10]
+
+/* Named registers */
+#define DST	regs[insn->dst_reg]
+#define SRC	regs[insn->src_reg]
+#define CTX	BPF_R6
+#define IMM	insn->imm
+
+/**
+ *	bpf_ld_skb - load packet data for BPF_LD | BPF_ABS and BPF_IND
+ *	@skb: buffer to load from
+ *	@off: offset, negative values use the SKF_NET_OFF/SKF_LL_OFF bases
+ *	@size: 1, 2 or 4 bytes
+ *
+ * Returns the value converted from network byte order, or BPF_LD_SKB_ERR
+ * if the bytes are out of bounds.  Shared by the interpreter and the JITs.
+ */
+u64 bpf_ld_skb(const struct sk_buff *skb, int off, unsigned int size)
+{
+	u8 buf[4];
+	void *ptr;
+
+	if (off >= 0)
+		ptr = skb_header_pointer(skb, off, size, buf);
+	else
+		ptr = bpf_internal_load_pointer_neg_helper(skb, off, size);
+	if (!ptr)
+		return BPF_LD_SKB_ERR;
+
+	switch (size) {
+	case 4:
+		return get_unaligned_be32(ptr);
+	case 2:
+		return get_unaligned_be16(ptr);
+	}
+	return *(u8 *)ptr;
+}
+
+/* Base for the imm field of BPF_CALL after the verifier rewrote it */
+noinline u64 __bpf_call_base(u64 r1, u64 r2, u64 r3, u64 r4, u64 r5)
+{
+	return 0;
+}
+
+/**
+ *	__bpf_prog_run - run eBPF program on a given context
+ *	@ctx: is the data we are operating on (the skb for socket filters)
+ *	@insn: is the array of eBPF instructions
+ *
+ * Decode and execute eBPF instructions.  Division by zero and failed
+ * packet loads end the program with a return value of 0, like classic BPF.
+ */
+static unsigned int __bpf_prog_run(const struct sk_buff *ctx,
+				   const struct bpf_insn *insn)
+{
+	u64 stack[MAX_BPF_STACK / sizeof(u64)];
+	u64 regs[MAX_BPF_REG], tmp;
+	int off;
+
+	BPF_FP = (u64) (unsigned long) &stack[ARRAY_SIZE(stack)];
+	BPF_R1 = (u64) (unsigned long) ctx;
+
+	for (;; insn++) {
+		switch (insn->code) {
+#define ALU(OPCODE, OP)						\
+		case BPF_ALU64 | OPCODE | BPF_X:			\
+			DST = DST OP SRC;				\
+			continue;					\
+		case BPF_ALU | OPCODE | BPF_X:				\
+			DST = (u32) DST OP (u32) SRC;			\
+			continue;					\
+		case BPF_ALU64 | OPCODE | BPF_K:			\
+			DST = DST OP IMM;				\
+			continue;					\
+		case BPF_ALU | OPCODE | BPF_K:				\
+			DST = (u32) DST OP (u32) IMM;			\
+			continue;
+		ALU(BPF_ADD, +)
+		ALU(BPF_SUB, -)
+		ALU(BPF_AND, &)
+		ALU(BPF_OR,  |)
+		ALU(BPF_XOR, ^)
+		ALU(BPF_MUL, *)
+#undef ALU
+
+		/* shift counts are masked to the operand width, as on x86 */
+#define SHIFT(OPCODE, OP)					\
+		case BPF_ALU64 | OPCODE | BPF_X:			\
+			DST = DST OP (SRC & 63);			\
+			continue;					\
+		case BPF_ALU | OPCODE | BPF_X:				\
+			DST = (u32) DST OP ((u32) SRC & 31);		\
+			continue;					\
+		case BPF_ALU64 | OPCODE | BPF_K:			\
+			DST = DST OP (IMM & 63);			\
+			continue;					\
+		case BPF_ALU | OPCODE | BPF_K:				\
+			DST = (u32) DST OP (IMM & 31);			\
+			continue;
+		SHIFT(BPF_LSH, <<)
+		SHIFT(BPF_RSH, >>)
+#undef SHIFT
+		case BPF_ALU64 | BPF_ARSH | BPF_X:
+			DST = (s64) DST >> (SRC & 63);
+			continue;
+		case BPF_ALU | BPF_ARSH | BPF_X:
+			DST = (u32) ((s32) DST >> (SRC & 31));
+			continue;
+		case BPF_ALU64 | BPF_ARSH | BPF_K:
+			DST = (s64) DST >> (IMM & 63);
+			continue;
+		case BPF_ALU | BPF_ARSH | BPF_K:
+			DST = (u32) ((s32) DST >> (IMM & 31));
+			continue;
+
+		case BPF_ALU | BPF_NEG:
+			DST = (u32) -DST;
+			continue;
+		case BPF_ALU64 | BPF_NEG:
+			DST = -DST;
+			continue;
+
+		case BPF_ALU | BPF_MOV | BPF_X:
+			DST = (u32) SRC;
+			continue;
+		case BPF_ALU | BPF_MOV | BPF_K:
+			DST = (u32) IMM;
+			continue;
+		case BPF_ALU64 | BPF_MOV | BPF_X:
+			DST = SRC;
+			continue;
+		case BPF_ALU64 | BPF_MOV | BPF_K:
+			DST = IMM;
+			continue;
+
+		case BPF_ALU64 | BPF_DIV | BPF_X:
+			if (unlikely(SRC == 0))
+				return 0;
+			DST = div64_u64(DST, SRC);
+			continue;
+		case BPF_ALU | BPF_DIV | BPF_X:
+			if (unlikely((u32) SRC == 0))
+				return 0;
+			DST = (u32) DST / (u32) SRC;
+			continue;
+		case BPF_ALU64 | BPF_DIV | BPF_K:
+			DST = div64_u64(DST, (u64) IMM);
+			continue;
+		case BPF_ALU | BPF_DIV | BPF_K:
+			DST = (u32) DST / (u32) IMM;
+			continue;
+		case BPF_ALU64 | BPF_MOD | BPF_X:
+			if (unlikely(SRC == 0))
+				return 0;
+			tmp = div64_u64(DST, SRC);
+			DST -= tmp * SRC;
+			continue;
+		case BPF_ALU | BPF_MOD | BPF_X:
+			if (unlikely((u32) SRC == 0))
+				return 0;
+			DST = (u32) DST % (u32) SRC;
+			continue;
+		case BPF_ALU64 | BPF_MOD | BPF_K:
+			tmp = div64_u64(DST, (u64) IMM);
+			DST -= tmp * (u64) IMM;
+			continue;
+		case BPF_ALU | BPF_MOD | BPF_K:
+			DST = (u32) DST % (u32) IMM;
+			continue;
+
+		case BPF_ALU | BPF_END | BPF_TO_BE:
+			switch (IMM) {
+			case 16:
+				DST = (__force u16) cpu_to_be16(DST);
+				break;
+			case 32:
+				DST = (__force u32) cpu_to_be32(DST);
+				break;
+			case 64:
+				DST = (__force u64) cpu_to_be64(DST);
+				break;
+			}
+			continue;
+		case BPF_ALU | BPF_END | BPF_TO_LE:
+			switch (IMM) {
+			case 16:
+				DST = (__force u16) cpu_to_le16(DST);
+				break;
+			case 32:
+				DST = (__force u32) cpu_to_le32(DST);
+				break;
+			case 64:
+				DST = (__force u64) cpu_to_le64(DST);
+				break;
+			}
+			continue;
+
+		case BPF_LD | BPF_IMM | BPF_DW:
+			DST = (u64) (u32) insn[0].imm | ((u64) (u32) insn[1].imm) << 32;
+			insn++;
+			continue;
+
+		/* Jumps */
+		case BPF_JMP | BPF_JA:
+			insn += insn->off;
+			continue;
+#define COND_JMP(OPCODE, COND_X, COND_K)			\
+		case BPF_JMP | OPCODE | BPF_X:				\
+			if (COND_X)					\
+				insn += insn->off;			\
+			continue;					\
+		case BPF_JMP | OPCODE | BPF_K:				\
+			if (COND_K)					\
+				insn += insn->off;			\
+			continue;
+		COND_JMP(BPF_JEQ,  DST == SRC, DST == IMM)
+		COND_JMP(BPF_JNE,  DST != SRC, DST != IMM)
+		COND_JMP(BPF_JGT,  DST > SRC, DST > IMM)
+		COND_JMP(BPF_JGE,  DST >= SRC, DST >= IMM)
+		COND_JMP(BPF_JSGT, (s64) DST > (s64) SRC, (s64) DST > (s64) IMM)
+		COND_JMP(BPF_JSGE, (s64) DST >= (s64) SRC, (s64) DST >= (s64) IMM)
+		COND_JMP(BPF_JSET, DST & SRC, DST & IMM)
+#undef COND_JMP
+
+		case BPF_JMP | BPF_CALL:
+			/* Function call scratches BPF_R1-BPF_R5 registers,
+			 * preserves BPF_R6-BPF_R9, and stores return value
+			 * into BPF_R0.
+			 */
+			BPF_R0 = (__bpf_call_base + insn->imm)(BPF_R1, BPF_R2,
+							       BPF_R3, BPF_R4,
+							       BPF_R5);
+			continue;
+		case BPF_JMP | BPF_EXIT:
+			return BPF_R0;
+
+		/* Loads and stores, bounds were checked by the verifier */
+#define LDST(SIZEOP, SIZE)						\
+		case BPF_STX | BPF_MEM | SIZEOP:			\
+			*(SIZE *) (unsigned long) (DST + insn->off) = SRC;	\
+			continue;					\
+		case BPF_ST | BPF_MEM | SIZEOP:				\
+			*(SIZE *) (unsigned long) (DST + insn->off) = IMM;	\
+			continue;					\
+		case BPF_LDX | BPF_MEM | SIZEOP:			\
+			DST = *(SIZE *) (unsigned long) (SRC + insn->off);	\
+			continue;
+		LDST(BPF_B,   u8)
+		LDST(BPF_H,  u16)
+		LDST(BPF_W,  u32)
+		LDST(BPF_DW, u64)
+#undef LDST
+		case BPF_STX | BPF_XADD | BPF_W:
+			atomic_add((u32) SRC, (atomic_t *)
+				   (unsigned long) (DST + insn->off));
+			continue;
+		case BPF_STX | BPF_XADD | BPF_DW:
+			atomic64_add((u64) SRC, (atomic64_t *)
+				     (unsigned long) (DST + insn->off));
+			continue;
+
+		/* Classic packet loads: R6 holds the skb, BPF_R1-BPF_R5
+		 * are scratched, the result goes to BPF_R0.
+		 */
+#define LD_SKB(SIZEOP, SIZE)						\
+		case BPF_LD | BPF_ABS | SIZEOP:				\
+			off = IMM;					\
+			goto load_##SIZE;				\
+		case BPF_LD | BPF_IND | SIZEOP:				\
+			off = IMM + (u32) SRC;				\
+		load_##SIZE:						\
+			tmp = bpf_ld_skb((struct sk_buff *) (unsigned long) CTX, \
+					 off, SIZE);			\
+			if (unlikely(tmp & BPF_LD_SKB_ERR))		\
+				return 0;				\
+			BPF_R0 = tmp;					\
+			continue;
+		LD_SKB(BPF_W, 4)
+		LD_SKB(BPF_H, 2)
+		LD_SKB(BPF_B, 1)
+#undef LD_SKB
+
+		default:
+			/* the verifier rejects anything else */
+			WARN_RATELIMIT(1, "unknown opcode %02x\n", insn->code);
+			return 0;
+		}
+	}
+}
+
+/* weak hooks for architectures without an eBPF JIT */
+void __weak bpf_int_jit_compile(struct bpf_prog *prog)
+{
+}
+
+void __weak bpf_int_jit_free(struct bpf_prog *prog)
+{
+}
+
+struct bpf_prog *bpf_prog_alloc(unsigned int insn_cnt)
+{
+	struct bpf_prog *prog;
+
+	prog = vzalloc(bpf_prog_size(insn_cnt));
+	if (!prog)
+		return NULL;
+
+	atomic_set(&prog->refcnt, 1);
+	prog->len = insn_cnt;
+	return prog;
+}
+
+/**
+ *	bpf_prog_select_runtime - select execution runtime for a program
+ *	@prog: verified program
+ *
+ * Use the JITed image if the architecture could compile the program,
+ * and the interpreter otherwise.
+ */
+void bpf_prog_select_runtime(struct bpf_prog *prog)
+{
+	prog->bpf_func = __bpf_prog_run;
+	bpf_int_jit_compile(prog);
+}
+
+static void bpf_prog_free_deferred(struct work_struct *work)
+{
+	struct bpf_prog *prog = container_of(work, struct bpf_prog, work);
+	u32 i;
+
+	for (i = 0; i < prog->used_map_cnt; i++)
+		bpf_map_put(prog->used_maps[i]);
+	kfree(prog->used_maps);
+
+	if (prog->jited)
+		bpf_int_jit_free(prog);
+	vfree(prog);
+}
+
+/* Free a program and drop its map references.  The last reference may be
+ * dropped from softirq context, so vfree() and the JIT image release are
+ * deferred to process context.
+ */
+void bpf_prog_free(struct bpf_prog *prog)
+{
+	INIT_WORK(&prog->work, bpf_prog_free_deferred);
+	schedule_work(&prog->work);
+}
@@ -0,0 +1,552 @@
+/*
+ * bpf() system call: maps and program loading
+ *
+ * Maps and programs are reference counted objects handed to userspace as
+ * anonymous inode file descriptors.  A program holds a reference on every
+ * map it uses, so maps stay alive while a program that uses them is
+ * attached somewhere, even after userspace closed the map fd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of version 2 of the GNU General Public
+ * License as published by the Free Software Foundation.
+ */
+#include <linux/bpf.h>
+#include <linux/syscalls.h>
+#include <linux/slab.h>
+#include <linux/anon_inodes.h>
+#include <linux/file.h>
+#include <linux/license.h>
+#include <linux/capability.h>
+#include <linux/uaccess.h>
+#include <linux/export.h>
+
+static LIST_HEAD(bpf_map_types);
+static LIST_HEAD(bpf_prog_types);
+
+static struct bpf_map *find_and_alloc_map(union bpf_attr *attr)
+{
+	struct bpf_map_type_list *tl;
+	struct bpf_map *map;
+
+	list_for_each_entry(tl, &bpf_map_types, list_node) {
+		if (tl->type == attr->map_type) {
+			map = tl->ops->map_alloc(attr);
+			if (IS_ERR(map))
+				return map;
+			map->ops = tl->ops;
+			map->map_type = attr->map_type;
+			return map;
+		}
+	}
+	return ERR_PTR(-EINVAL);
+}
+
+/* boot time registration of different map implementations */
+void bpf_register_map_type(struct bpf_map_type_list *tl)
+{
+	list_add(&tl->list_node, &bpf_map_types);
+}
+
+/* called from workqueue */
+static void bpf_map_free_deferred(struct work_struct *work)
+{
+	struct bpf_map *map = container_of(work, struct bpf_map, work);
+
+	/* implementation dependent freeing */
+	map->ops->map_free(map);
+}
+
+/* decrement map refcnt and schedule it for freeing via workqueue
+ * (underlying map implementation ops->map_free() might sleep)
+ */
+void bpf_map_put(struct bpf_map *map)
+{
+	if (atomic_dec_and_test(&map->refcnt)) {
+		INIT_WORK(&map->work, bpf_map_free_deferred);
+		schedule_work(&map->work);
+	}
+}
+
+static int bpf_map_release(struct inode *inode, struct file *filp)
+{
+	struct bpf_map *map = filp->private_data;
+
+	bpf_map_put(map);
+	return 0;
+}
+
+static const struct file_operations bpf_map_fops = {
+	.release = bpf_map_release,
+};
+
+/* helper macro to check that unused fields 'union bpf_attr' are zero */
+#define CHECK_ATTR(CMD) \
+	memchr_inv((void *) &attr->CMD##_LAST_FIELD + \
+		   sizeof(attr->CMD##_LAST_FIELD), 0, \
+		   sizeof(*attr) - \
+		   offsetof(union bpf_attr, CMD##_LAST_FIELD) - \
+		   sizeof(attr->CMD##_LAST_FIELD)) != NULL
+
+#define BPF_MAP_CREATE_LAST_FIELD max_entries
+/* called via syscall */
+static int map_create(union bpf_attr *attr)
+{
+	struct bpf_map *map;
+	int err;
+
+	if (CHECK_ATTR(BPF_MAP_CREATE))
+		return -EINVAL;
+
+	/* find map type and init map */
+	map = find_and_alloc_map(attr);
+	if (IS_ERR(map))
+		return PTR_ERR(map);
+
+	atomic_set(&map->refcnt, 1);
+
+	err = anon_inode_getfd("bpf-map", &bpf_map_fops, map, O_RDWR | O_CLOEXEC);
+	if (err < 0)
+		/* failed to allocate fd */
+		goto free_map;
+
+	return err;
+
+free_map:
+	map->ops->map_free(map);
+	return err;
+}
+
+/**
+ *	bpf_map_get - get a map from its file
+ *	@file: file from fget() of a map fd
+ *
+ * Returns the map without taking a reference, or ERR_PTR(-EINVAL) if
+ * @file is not a map.  The caller either holds the file or takes its
+ * own reference on the map before dropping the file.
+ */
+struct bpf_map *bpf_map_get(struct file *file)
+{
+	if (file->f_op != &bpf_map_fops)
+		return ERR_PTR(-EINVAL);
+
+	return file->private_data;
+}
+
+/* helper to convert user pointers passed inside __aligned_u64 fields */
+static void __user *u64_to_ptr(__u64 val)
+{
+	return (void __user *) (unsigned long) val;
+}
+
+static void *copy_key_from_user(struct bpf_map *map, __u64 ukey)
+{
+	void *key;
+
+	key = kmalloc(map->key_size, GFP_USER);
+	if (!key)
+		return ERR_PTR(-ENOMEM);
+
+	if (copy_from_user(key, u64_to_ptr(ukey), map->key_size)) {
+		kfree(key);
+		return ERR_PTR(-EFAULT);
+	}
+	return key;
+}
+
+/* last field in 'union bpf_attr' used by this command */
+#define BPF_MAP_LOOKUP_ELEM_LAST_FIELD value
+
+static int map_lookup_elem(union bpf_attr *attr)
+{
+	struct bpf_map *map;
+	void *key, *value, *ptr;
+	struct file *file;
+	int err;
+
+	if (CHECK_ATTR(BPF_MAP_LOOKUP_ELEM))
+		return -EINVAL;
+
+	file = fget(attr->map_fd);
+	if (!file)
+		return -EBADF;
+	map = bpf_map_get(file);
+	if (IS_ERR(map)) {
+		err = PTR_ERR(map);
+		goto err_put;
+	}
+
+	key = copy_key_from_user(map, attr->key);
+	if (IS_ERR(key)) {
+		err = PTR_ERR(key);
+		goto err_put;
+	}
+
+	err = -ENOMEM;
+	value = kmalloc(map->value_size, GFP_USER);
+	if (!value)
+		goto free_key;
+
+	rcu_read_lock();
+	ptr = map->ops->map_lookup_elem(map, key);
+	if (ptr)
+		memcpy(value, ptr, map->value_size);
+	rcu_read_unlock();
+
+	err = -ENOENT;
+	if (!ptr)
+		goto free_value;
+
+	err = -EFAULT;
+	if (copy_to_user(u64_to_ptr(attr->value), value, map->value_size))
+		goto free_value;
+
+	err = 0;
+
+free_value:
+	kfree(value);
+free_key:
+	kfree(key);
+err_put:
+	fput(file);
+	return err;
+}
+
+#define BPF_MAP_UPDATE_ELEM_LAST_FIELD flags
+
+static int map_update_elem(union bpf_attr *attr)
+{
+	struct bpf_map *map;
+	void *key, *value;
+	struct file *file;
+	int err;
+
+	if (CHECK_ATTR(BPF_MAP_UPDATE_ELEM))
+		return -EINVAL;
+
+	file = fget(attr->map_fd);
+	if (!file)
+		return -EBADF;
+	map = bpf_map_get(file);
+	if (IS_ERR(map)) {
+		err = PTR_ERR(map);
+		goto err_put;
+	}
+
+	key = copy_key_from_user(map, attr->key);
+	if (IS_ERR(key)) {
+		err = PTR_ERR(key);
+		goto err_put;
+	}
+
+	err = -ENOMEM;
+	value = kmalloc(map->value_size, GFP_USER);
+	if (!value)
+		goto free_key;
+
+	err = -EFAULT;
+	if (copy_from_user(value, u64_to_ptr(attr->value), map->value_size))
+		goto free_value;
+
+	/* eBPF program that use maps are running under rcu_read_lock(),
+	 * therefore all map accessors rely on this fact, so do the same here
+	 */
+	rcu_read_lock();
+	err = map->ops->map_update_elem(map, key, value, attr->flags);
+	rcu_read_unlock();
+
+free_value:
+	kfree(value);
+free_key:
+	kfree(key);
+err_put:
+	fput(file);
+	return err;
+}
+
+#define BPF_MAP_DELETE_ELEM_LAST_FIELD key
+
+static int map_delete_elem(union bpf_attr *attr)
+{
+	struct bpf_map *map;
+	struct file *file;
+	void *key;
+	int err;
+
+	if (CHECK_ATTR(BPF_MAP_DELETE_ELEM))
+		return -EINVAL;
+
+	file = fget(attr->map_fd);
+	if (!file)
+		return -EBADF;
+	map = bpf_map_get(file);
+	if (IS_ERR(map)) {
+		err = PTR_ERR(map);
+		goto err_put;
+	}
+
+	key = copy_key_from_user(map, attr->key);
+	if (IS_ERR(key)) {
+		err = PTR_ERR(key);
+		goto err_put;
+	}
+
+	rcu_read_lock();
+	err = map->ops->map_delete_elem(map, key);
+	rcu_read_unlock();
+
+	kfree(key);
+err_put:
+	fput(file);
+	return err;
+}
+
+/* last field in 'union bpf_attr' used by this command */
+#define BPF_MAP_GET_NEXT_KEY_LAST_FIELD next_key
+
+static int map_get_next_key(union bpf_attr *attr)
+{
+	struct bpf_map *map;
+	void *key, *next_key;
+	struct file *file;
+	int err;
+
+	if (CHECK_ATTR(BPF_MAP_GET_NEXT_KEY))
+		return -EINVAL;
+
+	file = fget(attr->map_fd);
+	if (!file)
+		return -EBADF;
+	map = bpf_map_get(file);
+	if (IS_ERR(map)) {
+		err = PTR_ERR(map);
+		goto err_put;
+	}
+
+	key = copy_key_from_user(map, attr->key);
+	if (IS_ERR(key)) {
+		err = PTR_ERR(key);
+		goto err_put;
+	}
+
+	err = -ENOMEM;
+	next_key = kmalloc(map->key_size, GFP_USER);
+	if (!next_key)
+		goto free_key;
+
+	rcu_read_lock();
+	err = map->ops->map_get_next_key(map, key, next_key);
+	rcu_read_unlock();
+	if (err)
+		goto free_next_key;
+
+	err = -EFAULT;
+	if (copy_to_user(u64_to_ptr(attr->next_key), next_key, map->key_size))
+		goto free_next_key;
+
+	err = 0;
+
+free_next_key:
+	kfree(next_key);
+free_key:
+	kfree(key);
+err_put:
+	fput(file);
+	return err;
+}
+
+static const struct bpf_verifier_ops *find_prog_type(enum bpf_prog_type type)
+{
+	struct bpf_prog_type_list *tl;
+
+	list_for_each_entry(tl, &bpf_prog_types, list_node) {
+		if (tl->type == type)
+			return tl->ops;
+	}
+	return NULL;
+}
+
+/* boot time registration of program types, e.g. socket filters */
+void bpf_register_prog_type(struct bpf_prog_type_list *tl)
+{
+	list_add(&tl->list_node, &bpf_prog_types);
+}
+
+void bpf_prog_put(struct bpf_prog *prog)
+{
+	if (atomic_dec_and_test(&prog->refcnt))
+		bpf_prog_free(prog);
+}
+EXPORT_SYMBOL_GPL(bpf_prog_put);
+
+static int bpf_prog_release(struct inode *inode, struct file *filp)
+{
+	struct bpf_prog *prog = filp->private_data;
+
+	bpf_prog_put(prog);
+	return 0;
+}
+
+static const struct file_operations bpf_prog_fops = {
+	.release = bpf_prog_release,
+};
+
+/**
+ *	bpf_prog_get - get a program from its fd
+ *	@ufd: program fd returned by BPF_PROG_LOAD
+ *
+ * Returns the program with a reference taken, to be dropped with
+ * bpf_prog_put(), or an ERR_PTR().
+ */
+struct bpf_prog *bpf_prog_get(u32 ufd)
+{
+	struct bpf_prog *prog;
+	struct file *file;
+
+	file = fget(ufd);
+	if (!file)
+		return ERR_PTR(-EBADF);
+
+	if (file->f_op != &bpf_prog_fops) {
+		fput(file);
+		return ERR_PTR(-EINVAL);
+	}
+
+	prog = file->private_data;
+	atomic_inc(&prog->refcnt);
+	fput(file);
+	return prog;
+}
+EXPORT_SYMBOL_GPL(bpf_prog_get);
+
+/* last field in 'union bpf_attr' used by this command */
+#define BPF_PROG_LOAD_LAST_FIELD log_buf
+
+static int bpf_prog_load(union bpf_attr *attr)
+{
+	enum bpf_prog_type type = attr->prog_type;
+	struct bpf_prog *prog;
+	char license[128];
+	int err;
+
+	if (CHECK_ATTR(BPF_PROG_LOAD))
+		return -EINVAL;
+
+	/* copy eBPF program license from user space */
+	if (strncpy_from_user(license, u64_to_ptr(attr->license),
+			      sizeof(license) - 1) < 0)
+		return -EFAULT;
+	license[sizeof(license) - 1] = 0;
+
+	if (attr->insn_cnt == 0 || attr->insn_cnt > BPF_MAXINSNS)
+		return -EINVAL;
+
+	/* plain bpf_prog allocation */
+	prog = bpf_prog_alloc(attr->insn_cnt);
+	if (!prog)
+		return -ENOMEM;
+
+	err = -EFAULT;
+	if (copy_from_user(prog->insnsi, u64_to_ptr(attr->insns),
+			   prog->len * sizeof(struct bpf_insn)))
+		goto free_prog;
+
+	/* eBPF programs must be GPL compatible to use GPL-ed functions */
+	prog->gpl_compatible = license_is_gpl_compatible(license);
+
+	/* find program type */
+	err = -EINVAL;
+	prog->ops = find_prog_type(type);
+	if (!prog->ops)
+		goto free_prog;
+	prog->type = type;
+
+	/* run eBPF verifier */
+	err = bpf_check(prog, attr);
+	if (err < 0)
+		goto free_prog;
+
+	/* eBPF program is ready to be JITed */
+	bpf_prog_select_runtime(prog);
+
+	err = anon_inode_getfd("bpf-prog", &bpf_prog_fops, prog, O_RDWR | O_CLOEXEC);
+	if (err < 0)
+		/* failed to allocate fd */
+		goto free_prog;
+
+	return err;
+
+free_prog:
+	bpf_prog_free(prog);
+	return err;
+}
+
+SYSCALL_DEFINE3(bpf, int, cmd, union bpf_attr __user *, uattr, unsigned int, size)
+{
+	union bpf_attr attr = {};
+	int err;
+
+	/* programs can read kernel pointers out of maps and compare them,
+	 * so the whole interface is restricted to CAP_SYS_ADMIN
+	 */
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+
+	if (!access_ok(VERIFY_READ, uattr, 1))
+		return -EFAULT;
+
+	if (size > PAGE_SIZE)	/* silly large */
+		return -E2BIG;
+
+	/* If we're handed a bigger struct than we know of,
+	 * ensure all the unknown bits are 0 - i.e. new
+	 * user-space does not rely on any kernel feature
+	 * extensions we dont know about yet.
+	 */
+	if (size > sizeof(attr)) {
+		unsigned char __user *addr;
+		unsigned char __user *end;
+		unsigned char val;
+
+		addr = (void __user *)uattr + sizeof(attr);
+		end  = (void __user *)uattr + size;
+
+		for (; addr < end; addr++) {
+			err = get_user(val, addr);
+			if (err)
+				return err;
+			if (val)
+				return -E2BIG;
+		}
+		size = sizeof(attr);
+	}
+
+	/* copy attributes from user space, may be less than sizeof(bpf_attr) */
+	if (copy_from_user(&attr, uattr, size) != 0)
+		return -EFAULT;
+
+	switch (cmd) {
+	case BPF_MAP_CREATE:
+		err = map_create(&attr);
+		break;
+	case BPF_MAP_LOOKUP_ELEM:
+		err = map_lookup_elem(&attr);
+		break;
+	case BPF_MAP_UPDATE_ELEM:
+		err = map_update_elem(&attr);
+		break;
+	case BPF_MAP_DELETE_ELEM:
+		err = map_delete_elem(&attr);
+		break;
+	case BPF_MAP_GET_NEXT_KEY:
+		err = map_get_next_key(&attr);
+		break;
+	case BPF_PROG_LOAD:
+		err = bpf_prog_load(&attr);
+		break;
+	default:
+		err = -EINVAL;
+		break;
+	}
+
+	return err;
+}
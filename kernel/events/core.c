@@ -2569,6 +2569,20 @@ void perf_event_task_tick(void)
 	}
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * Frequency adjustment and multiplexing rotation are driven from the
+ * tick, so it must keep running while any context asks for them.
+ */
+bool perf_event_can_stop_tick(void)
+{
+	if (list_empty(&__get_cpu_var(rotation_list)))
+		return true;
+	else
+		return false;
+}
+#endif
+
 static int event_enable_on_exec(struct perf_event *event,
 				struct perf_event_context *ctx)
 {
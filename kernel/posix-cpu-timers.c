@@ -9,6 +9,8 @@
 #include <asm/uaccess.h>
 #include <linux/kernel_stat.h>
 #include <trace/events/timer.h>
+#include <linux/tick.h>
+#include <linux/workqueue.h>
 
 /*
  * Called after updating RLIMIT_CPU to run cpu timer and update
@@ -25,6 +27,28 @@ void update_rlimit_cpu(struct task_struct *task, unsigned long rlim_new)
 	spin_unlock_irq(&task->sighand->siglock);
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+static void nohz_kick_work_fn(struct work_struct *work)
+{
+	tick_nohz_full_kick_all();
+}
+
+static DECLARE_WORK(nohz_kick_work, nohz_kick_work_fn);
+
+/*
+ * A full dynticks CPU may be running the task the timer was armed on,
+ * with its tick stopped. The kick is deferred to a workqueue as this
+ * can be called with the siglock held and interrupts disabled.
+ */
+static void posix_cpu_timer_kick_nohz(void)
+{
+	if (tick_nohz_full_enabled())
+		schedule_work(&nohz_kick_work);
+}
+#else
+static inline void posix_cpu_timer_kick_nohz(void) { }
+#endif
+
 static int check_clock(const clockid_t which_clock)
 {
 	int error = 0;
@@ -797,6 +821,8 @@ static int posix_cpu_timer_set(struct k_itimer *timer, int flags,
 	}
 
 	ret = 0;
+	if (new_expires.sched != 0)
+		posix_cpu_timer_kick_nohz();
  out:
 	if (old) {
 		sample_to_timespec(timer->it_clock,
@@ -1031,6 +1057,27 @@ static inline int task_cputime_zero(const struct task_cputime *cputime)
 	return 0;
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+/**
+ * posix_cpu_timers_can_stop_tick - check whether cputimers need the tick
+ *
+ * @tsk:	The task running on the full dynticks CPU.
+ *
+ * The per-thread and process wide cputimers are only checked for
+ * expiry from the tick, so it can't be stopped while any is armed.
+ */
+bool posix_cpu_timers_can_stop_tick(struct task_struct *tsk)
+{
+	if (!task_cputime_zero(&tsk->cputime_expires))
+		return false;
+
+	if (tsk->signal->cputimer.running)
+		return false;
+
+	return true;
+}
+#endif
+
 /*
  * Check for any per-thread CPU timers that have fired and move them
  * off the tsk->*_timers list onto the firing list.  Per-thread timers
@@ -1389,6 +1436,8 @@ void set_process_cpu_timer(struct task_struct *tsk, unsigned int clock_idx,
 			tsk->signal->cputime_expires.virt_exp = *newval;
 		break;
 	}
+
+	posix_cpu_timer_kick_nohz();
 }
 
 static int do_cpu_nanosleep(const clockid_t which_clock, int flags,
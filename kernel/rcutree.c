@@ -51,7 +51,7 @@
 #include <linux/kthread.h>
 #include <linux/prefetch.h>
 #include <linux/delay.h>
-#include <linux/stop_machine.h>
+#include <linux/tick.h>
 
 #include "rcutree.h"
 #include <trace/events/rcu.h>
@@ -62,7 +62,7 @@
 
 static struct lock_class_key rcu_node_class[RCU_NUM_LVLS];
 
-#define RCU_STATE_INITIALIZER(sname, cr) { \
+#define RCU_STATE_INITIALIZER(sname, sabbr, cr) { \
 	.level = { &sname##_state.node[0] }, \
 	.call = cr, \
 	.fqs_state = RCU_GP_IDLE, \
@@ -74,13 +74,15 @@ static struct lock_class_key rcu_node_class[RCU_NUM_LVLS];
 	.barrier_mutex = __MUTEX_INITIALIZER(sname##_state.barrier_mutex), \
 	.fqslock = __RAW_SPIN_LOCK_UNLOCKED(&sname##_state.fqslock), \
 	.name = #sname, \
+	.abbr = sabbr, \
 }
 
 struct rcu_state rcu_sched_state =
-	RCU_STATE_INITIALIZER(rcu_sched, call_rcu_sched);
+	RCU_STATE_INITIALIZER(rcu_sched, 's', call_rcu_sched);
 DEFINE_PER_CPU(struct rcu_data, rcu_sched_data);
 
-struct rcu_state rcu_bh_state = RCU_STATE_INITIALIZER(rcu_bh, call_rcu_bh);
+struct rcu_state rcu_bh_state =
+	RCU_STATE_INITIALIZER(rcu_bh, 'b', call_rcu_bh);
 DEFINE_PER_CPU(struct rcu_data, rcu_bh_data);
 
 static struct rcu_state *rcu_state;
@@ -171,6 +173,8 @@ static int rcu_gp_in_progress(struct rcu_state *rsp)
  * one since the start of the grace period, this just sets a flag.
  * The caller must have disabled preemption.
  */
+static void rcu_report_exp_sched_rdp(struct rcu_data *rdp);
+
 void rcu_sched_qs(int cpu)
 {
 	struct rcu_data *rdp = &per_cpu(rcu_sched_data, cpu);
@@ -180,6 +184,8 @@ void rcu_sched_qs(int cpu)
 	if (rdp->passed_quiesce == 0)
 		trace_rcu_grace_period("rcu_sched", rdp->gpnum, "cpuqs");
 	rdp->passed_quiesce = 1;
+	if (unlikely(ACCESS_ONCE(rdp->exp_need_qs)))
+		rcu_report_exp_sched_rdp(rdp);
 }
 
 void rcu_bh_qs(int cpu)
@@ -697,6 +703,14 @@ static int rcu_implicit_dynticks_qs(struct rcu_data *rdp)
 		return 1;
 	}
 
+	/*
+	 * A full dynticks CPU running a task may have stopped its tick,
+	 * in which case nothing reports its quiescent states. Kick it so
+	 * that it restarts the tick until it has caught up.
+	 */
+	if (tick_nohz_full_cpu(rdp->cpu))
+		tick_nohz_full_kick_cpu(rdp->cpu);
+
 	/* Go check for the CPU being offline. */
 	return rcu_implicit_offline_qs(rdp);
 }
@@ -1401,6 +1415,10 @@ static void rcu_adopt_orphan_cbs(struct rcu_state *rsp)
 	    rsp->rcu_barrier_in_progress != current)
 		return;
 
+	/* No-CBs CPUs are handled specially. */
+	if (rcu_nocb_adopt_orphan_cbs(rsp, rdp))
+		return;
+
 	/* Do the accounting first. */
 	rdp->qlen_lazy += rsp->qlen_lazy;
 	rdp->qlen += rsp->qlen;
@@ -1940,6 +1958,12 @@ __call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *rcu),
 	local_irq_save(flags);
 	rdp = this_cpu_ptr(rsp->rda);
 
+	/* No-CBs CPUs hand their callbacks over to their rcuo kthread. */
+	if (unlikely(__call_rcu_nocb(rdp, head, lazy))) {
+		local_irq_restore(flags);
+		return;
+	}
+
 	/* Add the callback to our list. */
 	ACCESS_ONCE(rdp->qlen)++;
 	if (lazy)
@@ -2057,22 +2081,176 @@ EXPORT_SYMBOL_GPL(synchronize_rcu_bh);
 
 static atomic_t sync_sched_expedited_started = ATOMIC_INIT(0);
 static atomic_t sync_sched_expedited_done = ATOMIC_INIT(0);
+static DEFINE_MUTEX(sync_sched_expedited_mutex);
+static DECLARE_WAIT_QUEUE_HEAD(sync_sched_expedited_wq);
 
-static int synchronize_sched_expedited_cpu_stop(void *data)
+/*
+ * Report an expedited quiescent state for the CPU corresponding to the
+ * specified rcu_data structure, clearing its bit in ->exp_qsmask and
+ * propagating up the rcu_node tree as groups empty.  The task waiting
+ * for the expedited grace period is awakened once the root is clear.
+ */
+static void rcu_report_exp_sched_rdp(struct rcu_data *rdp)
 {
-	/*
-	 * There must be a full memory barrier on each affected CPU
-	 * between the time that try_stop_cpus() is called and the
-	 * time that it returns.
-	 *
-	 * In the current initial implementation of cpu_stop, the
-	 * above condition is already met when the control reaches
-	 * this point and the following smp_mb() is not strictly
-	 * necessary.  Do smp_mb() anyway for documentation and
-	 * robustness against future implementation changes.
-	 */
-	smp_mb(); /* See above comment block. */
-	return 0;
+	struct rcu_node *rnp = rdp->mynode;
+	unsigned long mask = rdp->grpmask;
+	unsigned long flags;
+	bool wake = false;
+
+	raw_spin_lock_irqsave(&rnp->lock, flags);
+	if (!rdp->exp_need_qs) {
+		raw_spin_unlock_irqrestore(&rnp->lock, flags);
+		return;
+	}
+	rdp->exp_need_qs = false;
+	for (;;) {
+		rnp->exp_qsmask &= ~mask;
+		if (rnp->exp_qsmask)
+			break;
+		if (rnp->parent == NULL) {
+			wake = true;
+			break;
+		}
+		mask = rnp->grpmask;
+		raw_spin_unlock(&rnp->lock); /* irqs remain disabled. */
+		rnp = rnp->parent;
+		raw_spin_lock(&rnp->lock); /* irqs already disabled. */
+	}
+	raw_spin_unlock_irqrestore(&rnp->lock, flags);
+
+	if (wake)
+		wake_up(&sync_sched_expedited_wq);
+}
+
+/*
+ * IPI handler for expedited RCU-sched grace periods.  An interrupted
+ * idle loop is a quiescent state that can be reported right away.
+ * Anything else might be an RCU-sched read-side critical section, so
+ * just force a trip through the scheduler, which will report the
+ * quiescent state from rcu_sched_qs().
+ */
+static void sync_sched_exp_handler(void *unused)
+{
+	struct rcu_data *rdp = &__get_cpu_var(rcu_sched_data);
+
+	if (!ACCESS_ONCE(rdp->exp_need_qs))
+		return;
+	if (rcu_is_cpu_rrupt_from_idle())
+		rcu_report_exp_sched_rdp(rdp);
+	else
+		set_tsk_need_resched(current);
+}
+
+/* IPI those CPUs of the specified leaf that still owe a quiescent state. */
+static void sync_sched_exp_leaf_ipis(struct rcu_node *rnp)
+{
+	unsigned long flags;
+	unsigned long mask;
+	int cpu;
+
+	raw_spin_lock_irqsave(&rnp->lock, flags);
+	mask = rnp->exp_qsmask;
+	raw_spin_unlock_irqrestore(&rnp->lock, flags);
+
+	for (cpu = rnp->grplo; cpu <= rnp->grphi; cpu++)
+		if (mask & (1UL << (cpu - rnp->grplo)))
+			smp_call_function_single(cpu, sync_sched_exp_handler,
+						 NULL, 0);
+}
+
+static void sync_sched_exp_work_fn(struct work_struct *work)
+{
+	sync_sched_exp_leaf_ipis(container_of(work, struct rcu_node, exp_work));
+}
+
+/*
+ * Set up the rcu_node tree for a new expedited RCU-sched grace period.
+ * Each leaf's ->exp_qsmask gets the online CPUs that are not already in
+ * an extended quiescent state, with the bits of the non-empty groups
+ * set all the way up to the root.  Only then are the CPUs told they
+ * owe a quiescent state, so no report can race with the setup.
+ *
+ * Returns true if some CPU needs to be waited for.
+ */
+static bool sync_sched_exp_select_cpus(struct rcu_state *rsp)
+{
+	struct rcu_node *rnp, *rnp_up;
+	unsigned long flags;
+	unsigned long mask;
+	int cpu, self = raw_smp_processor_id();
+
+	rcu_for_each_leaf_node(rsp, rnp) {
+		mask = 0;
+		for (cpu = rnp->grplo; cpu <= rnp->grphi; cpu++) {
+			struct rcu_data *rdp = per_cpu_ptr(rsp->rda, cpu);
+
+			/* The caller's CPU is running the caller: a QS. */
+			if (!cpu_online(cpu) || cpu == self)
+				continue;
+			/* Dyntick-idle CPUs are in an extended QS. */
+			if (!(atomic_add_return(0, &rdp->dynticks->dynticks) &
+			      0x1))
+				continue;
+			mask |= rdp->grpmask;
+		}
+
+		raw_spin_lock_irqsave(&rnp->lock, flags);
+		rnp->exp_qsmask = mask;
+		raw_spin_unlock_irqrestore(&rnp->lock, flags);
+		if (!mask)
+			continue;
+
+		/* Stop at the first ancestor some other leaf already set. */
+		for (rnp_up = rnp; rnp_up->parent; rnp_up = rnp_up->parent) {
+			struct rcu_node *rnp_p = rnp_up->parent;
+			bool was_set;
+
+			raw_spin_lock_irqsave(&rnp_p->lock, flags);
+			was_set = rnp_p->exp_qsmask & rnp_up->grpmask;
+			rnp_p->exp_qsmask |= rnp_up->grpmask;
+			raw_spin_unlock_irqrestore(&rnp_p->lock, flags);
+			if (was_set)
+				break;
+		}
+	}
+
+	rcu_for_each_leaf_node(rsp, rnp) {
+		raw_spin_lock_irqsave(&rnp->lock, flags);
+		for (cpu = rnp->grplo; cpu <= rnp->grphi; cpu++)
+			if (rnp->exp_qsmask & (1UL << (cpu - rnp->grplo)))
+				per_cpu_ptr(rsp->rda, cpu)->exp_need_qs = true;
+		raw_spin_unlock_irqrestore(&rnp->lock, flags);
+	}
+
+	return ACCESS_ONCE(rcu_get_root(rsp)->exp_qsmask) != 0;
+}
+
+/*
+ * Send the expedited IPIs.  With more than one leaf, each leaf's IPIs
+ * are sent from a work item running on one of its own CPUs so that
+ * large machines are covered in parallel.
+ */
+static void sync_sched_exp_send_ipis(struct rcu_state *rsp)
+{
+	struct rcu_node *rnp;
+	int cpu;
+
+	if (rcu_num_nodes == 1 || !keventd_up()) {
+		rcu_for_each_leaf_node(rsp, rnp)
+			sync_sched_exp_leaf_ipis(rnp);
+		return;
+	}
+
+	rcu_for_each_leaf_node(rsp, rnp) {
+		if (!ACCESS_ONCE(rnp->exp_qsmask))
+			continue;
+		for (cpu = rnp->grplo; cpu <= rnp->grphi; cpu++)
+			if (cpu_online(cpu))
+				break;
+		schedule_work_on(cpu, &rnp->exp_work);
+	}
+	rcu_for_each_leaf_node(rsp, rnp)
+		flush_work(&rnp->exp_work);
 }
 
 /**
@@ -2091,88 +2269,66 @@ static int synchronize_sched_expedited_cpu_stop(void *data)
  * to call this function from a CPU-hotplug notifier.  Failing to observe
  * these restriction will result in deadlock.
  *
- * This implementation can be thought of as an application of ticket
- * locking to RCU, with sync_sched_expedited_started and
- * sync_sched_expedited_done taking on the roles of the halves
- * of the ticket-lock word.  Each task atomically increments
- * sync_sched_expedited_started upon entry, snapshotting the old value,
- * then attempts to stop all the CPUs.  If this succeeds, then each
- * CPU will have executed a context switch, resulting in an RCU-sched
- * grace period.  We are then done, so we use atomic_cmpxchg() to
- * update sync_sched_expedited_done to match our snapshot -- but
- * only if someone else has not already advanced past our snapshot.
+ * Rather than stopping all CPUs, only the online CPUs that are not in
+ * dyntick-idle mode are asked for a quiescent state, and those are sent
+ * an IPI that forces a trip through the scheduler.  Each CPU reports
+ * its quiescent state up the rcu_node tree through ->exp_qsmask, much
+ * as normal grace periods do with ->qsmask, and the caller sleeps until
+ * the root's mask is clear.
  *
- * On the other hand, if try_stop_cpus() fails, we check the value
- * of sync_sched_expedited_done.  If it has advanced past our
- * initial snapshot, then someone else must have forced a grace period
- * some time after we took our snapshot.  In this case, our work is
- * done for us, and we can simply return.  Otherwise, we try again,
- * but keep our initial snapshot for purposes of checking for someone
- * doing our work for us.
- *
- * If we fail too many times in a row, we fall back to synchronize_sched().
+ * Expedited grace periods are serialized by sync_sched_expedited_mutex,
+ * with sync_sched_expedited_started and sync_sched_expedited_done taking
+ * on the roles of the halves of a ticket-lock word.  Each task atomically
+ * increments sync_sched_expedited_started upon entry and, once it holds
+ * the mutex, checks whether sync_sched_expedited_done has advanced past
+ * its ticket, in which case someone else's grace period started after
+ * it did and it can simply return.  Otherwise it snapshots
+ * sync_sched_expedited_started, so that the grace period it drives also
+ * covers everyone who queued up behind the mutex meanwhile, and
+ * advances sync_sched_expedited_done to that snapshot when done.
  */
 void synchronize_sched_expedited(void)
 {
-	int firstsnap, s, snap, trycount = 0;
+	struct rcu_state *rsp = &rcu_sched_state;
+	int firstsnap, s, snap;
 
-	/* Note that atomic_inc_return() implies full memory barrier. */
-	firstsnap = snap = atomic_inc_return(&sync_sched_expedited_started);
-	get_online_cpus();
-	WARN_ON_ONCE(cpu_is_offline(raw_smp_processor_id()));
+	if (rcu_blocking_is_gp())
+		return;
 
-	/*
-	 * Each pass through the following loop attempts to force a
-	 * context switch on each CPU.
-	 */
-	while (try_stop_cpus(cpu_online_mask,
-			     synchronize_sched_expedited_cpu_stop,
-			     NULL) == -EAGAIN) {
-		put_online_cpus();
-
-		/* No joy, try again later.  Or just synchronize_sched(). */
-		if (trycount++ < 10) {
-			udelay(trycount * num_online_cpus());
-		} else {
-			synchronize_sched();
-			return;
-		}
+	/* Note that atomic_inc_return() implies full memory barrier. */
+	firstsnap = atomic_inc_return(&sync_sched_expedited_started);
 
-		/* Check to see if someone else did our work for us. */
-		s = atomic_read(&sync_sched_expedited_done);
-		if (UINT_CMP_GE((unsigned)s, (unsigned)firstsnap)) {
-			smp_mb(); /* ensure test happens before caller kfree */
-			return;
-		}
+	mutex_lock(&sync_sched_expedited_mutex);
 
-		/*
-		 * Refetching sync_sched_expedited_started allows later
-		 * callers to piggyback on our grace period.  We subtract
-		 * 1 to get the same token that the last incrementer got.
-		 * We retry after they started, so our grace period works
-		 * for them, and they started after our first try, so their
-		 * grace period works for us.
-		 */
-		get_online_cpus();
-		snap = atomic_read(&sync_sched_expedited_started);
-		smp_mb(); /* ensure read is before try_stop_cpus(). */
+	/* Check to see if someone else did our work for us. */
+	s = atomic_read(&sync_sched_expedited_done);
+	if (UINT_CMP_GE((unsigned)s, (unsigned)firstsnap)) {
+		mutex_unlock(&sync_sched_expedited_mutex);
+		smp_mb(); /* ensure test happens before caller kfree */
+		return;
 	}
 
 	/*
-	 * Everyone up to our most recent fetch is covered by our grace
-	 * period.  Update the counter, but only if our work is still
-	 * relevant -- which it won't be if someone who started later
-	 * than we did beat us to the punch.
+	 * Everyone up to this fetch is covered by our grace period,
+	 * which starts after it.
 	 */
-	do {
-		s = atomic_read(&sync_sched_expedited_done);
-		if (UINT_CMP_GE((unsigned)s, (unsigned)snap)) {
-			smp_mb(); /* ensure test happens before caller kfree */
-			break;
-		}
-	} while (atomic_cmpxchg(&sync_sched_expedited_done, s, snap) != s);
+	snap = atomic_read(&sync_sched_expedited_started);
+	smp_mb(); /* ensure read is before the CPUs are sampled. */
+
+	get_online_cpus();
+	WARN_ON_ONCE(cpu_is_offline(raw_smp_processor_id()));
+
+	if (sync_sched_exp_select_cpus(rsp)) {
+		sync_sched_exp_send_ipis(rsp);
+		wait_event(sync_sched_expedited_wq,
+			   !ACCESS_ONCE(rcu_get_root(rsp)->exp_qsmask));
+	}
 
 	put_online_cpus();
+
+	smp_mb(); /* ensure grace period is before the counter update. */
+	atomic_set(&sync_sched_expedited_done, snap);
+	mutex_unlock(&sync_sched_expedited_mutex);
 }
 EXPORT_SYMBOL_GPL(synchronize_sched_expedited);
 
@@ -2278,6 +2434,32 @@ static int rcu_cpu_has_callbacks(int cpu)
 	return 0;
 }
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * Check to see if a full dynticks CPU running a task still needs the
+ * scheduling-clock interrupt, returning 1 if so.  It does while the
+ * current grace period waits on it, while it hasn't caught up with
+ * grace-period changes, and while it has callbacks of its own to
+ * advance and invoke.  Past that, force_quiescent_state() kicks it
+ * back into this check whenever it holds up a new grace period.
+ */
+int rcu_nohz_full_needs_tick(int cpu)
+{
+	struct rcu_state *rsp;
+	struct rcu_data *rdp;
+
+	for_each_rcu_flavor(rsp) {
+		rdp = per_cpu_ptr(rsp->rda, cpu);
+		if (rdp->qs_pending)
+			return 1;
+		if (ACCESS_ONCE(rdp->mynode->gpnum) != rdp->gpnum ||
+		    ACCESS_ONCE(rdp->mynode->completed) != rdp->completed)
+			return 1;
+	}
+	return rcu_cpu_has_callbacks(cpu);
+}
+#endif /* CONFIG_NO_HZ_FULL */
+
 /*
  * Helper function for _rcu_barrier() tracing.  If tracing is disabled,
  * the compiler is expected to optimize this away.
@@ -2402,7 +2584,17 @@ static void _rcu_barrier(struct rcu_state *rsp)
 	for_each_possible_cpu(cpu) {
 		preempt_disable();
 		rdp = per_cpu_ptr(rsp->rda, cpu);
-		if (cpu_is_offline(cpu)) {
+		if (rcu_is_nocb_cpu(cpu)) {
+			/*
+			 * The rcuo kthread invokes the callbacks in order
+			 * whether or not the CPU is online.
+			 */
+			_rcu_barrier_trace(rsp, "NoCB", cpu,
+					   rsp->n_barrier_done);
+			atomic_inc(&rsp->barrier_cpu_count);
+			rcu_nocb_barrier(rdp, rcu_barrier_callback);
+			preempt_enable();
+		} else if (cpu_is_offline(cpu)) {
 			_rcu_barrier_trace(rsp, "Offline", cpu,
 					   rsp->n_barrier_done);
 			preempt_enable();
@@ -2499,6 +2691,7 @@ rcu_boot_init_percpu_data(int cpu, struct rcu_state *rsp)
 	WARN_ON_ONCE(atomic_read(&rdp->dynticks->dynticks) != 1);
 	rdp->cpu = cpu;
 	rdp->rsp = rsp;
+	rcu_boot_init_nocb_percpu_data(rdp);
 	raw_spin_unlock_irqrestore(&rnp->lock, flags);
 }
 
@@ -2723,6 +2916,7 @@ static void __init rcu_init_one(struct rcu_state *rsp,
 			}
 			rnp->level = i;
 			INIT_LIST_HEAD(&rnp->blkd_tasks);
+			INIT_WORK(&rnp->exp_work, sync_sched_exp_work_fn);
 		}
 	}
 
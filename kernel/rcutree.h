@@ -27,6 +27,7 @@
 #include <linux/threads.h>
 #include <linux/cpumask.h>
 #include <linux/seqlock.h>
+#include <linux/workqueue.h>
 
 /*
  * Define shape of hierarchy based on NR_CPUS, CONFIG_RCU_FANOUT, and
@@ -134,6 +135,12 @@ struct rcu_node {
 				/*  elements that need to drain to allow the */
 				/*  current expedited grace period to */
 				/*  complete (only for TREE_PREEMPT_RCU). */
+	unsigned long exp_qsmask;
+				/* CPUs or groups that still need to pass */
+				/*  through a quiescent state for the */
+				/*  current expedited RCU-sched grace period. */
+	struct work_struct exp_work;
+				/* Sends this leaf's expedited IPIs. */
 	atomic_t wakemask;	/* CPUs whose kthread needs to be awakened. */
 				/*  Since this has meaning only for leaf */
 				/*  rcu_node structures, 32 bits suffices. */
@@ -251,6 +258,7 @@ struct rcu_data {
 	bool		qs_pending;	/* Core waits for quiesc state. */
 	bool		beenonline;	/* CPU online at least once. */
 	bool		preemptible;	/* Preemptible RCU? */
+	bool		exp_need_qs;	/* Expedited GP waits for this CPU. */
 	struct rcu_node *mynode;	/* This CPU's leaf of hierarchy */
 	unsigned long grpmask;		/* Mask to apply to leaf qsmask. */
 #ifdef CONFIG_RCU_CPU_STALL_INFO
@@ -318,6 +326,21 @@ struct rcu_data {
 	/* 6) _rcu_barrier() callback. */
 	struct rcu_head barrier_head;
 
+#ifdef CONFIG_RCU_NOCB_CPU
+	/* 7) Callback offloading. */
+	struct rcu_head *nocb_head;	/* CBs waiting for kthread. */
+	struct rcu_head **nocb_tail;
+	atomic_long_t nocb_q_count;	/* # CBs waiting for kthread */
+	atomic_long_t nocb_q_count_lazy; /*  (approximate). */
+	long nocb_p_count;		/* # CBs being invoked by kthread */
+	long nocb_p_count_lazy;		/*  (approximate). */
+	unsigned long n_nocbs_invoked;	/* count of no-CBs RCU cbs invoked. */
+	wait_queue_head_t nocb_wq;	/* For nocb kthreads to sleep on. */
+	struct task_struct *nocb_kthread;
+	struct rcu_head nocb_gp_head;	/* Kthread's grace-period wait. */
+	struct completion nocb_gp_done;
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU */
+
 	int cpu;
 	struct rcu_state *rsp;
 };
@@ -423,6 +446,7 @@ struct rcu_state {
 	unsigned long gp_max;			/* Maximum GP duration in */
 						/*  jiffies. */
 	char *name;				/* Name of structure. */
+	char abbr;				/* Abbreviated name. */
 	struct list_head flavors;		/* List of RCU flavors. */
 };
 
@@ -510,5 +534,13 @@ static void print_cpu_stall_info(struct rcu_state *rsp, int cpu);
 static void print_cpu_stall_info_end(void);
 static void zero_cpu_stall_ticks(struct rcu_data *rdp);
 static void increment_cpu_stall_ticks(void);
+static bool rcu_is_nocb_cpu(int cpu);
+static bool __call_rcu_nocb(struct rcu_data *rdp, struct rcu_head *rhp,
+			    bool lazy);
+static void rcu_nocb_barrier(struct rcu_data *rdp,
+			     void (*func)(struct rcu_head *rhp));
+static bool rcu_nocb_adopt_orphan_cbs(struct rcu_state *rsp,
+				      struct rcu_data *rdp);
+static void rcu_boot_init_nocb_percpu_data(struct rcu_data *rdp);
 
 #endif /* #ifndef RCU_TREE_NONCORE */
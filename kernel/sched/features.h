@@ -69,3 +69,9 @@ SCHED_FEAT(TTWU_QUEUE, true)
 SCHED_FEAT(FORCE_SD_OVERLAP, false)
 SCHED_FEAT(RT_RUNTIME_SHARE, true)
 SCHED_FEAT(LB_MIN, false)
+
+/*
+ * Bound the select_idle_sibling() scan of the LLC by the expected idle
+ * time of this cpu over the average cost of scanning one cpu.
+ */
+SCHED_FEAT(SIS_PROP, true)
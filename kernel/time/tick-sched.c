@@ -11,12 +11,16 @@
  *
  *  Distribute under GPLv2.
  */
+#include <linux/bootmem.h>
 #include <linux/cpu.h>
 #include <linux/err.h>
 #include <linux/hrtimer.h>
 #include <linux/interrupt.h>
+#include <linux/irq_work.h>
 #include <linux/kernel_stat.h>
 #include <linux/percpu.h>
+#include <linux/perf_event.h>
+#include <linux/posix-timers.h>
 #include <linux/profile.h>
 #include <linux/sched.h>
 #include <linux/module.h>
@@ -123,6 +127,75 @@ static int __init setup_tick_nohz(char *str)
 
 __setup("nohz=", setup_tick_nohz);
 
+#ifdef CONFIG_NO_HZ_FULL
+/*
+ * CPUs which stop their tick while running a single task, as set up
+ * on the command line with nohz_full=
+ */
+cpumask_var_t tick_nohz_full_mask;
+bool tick_nohz_full_running;
+
+static int __init tick_nohz_full_setup(char *str)
+{
+	alloc_bootmem_cpumask_var(&tick_nohz_full_mask);
+	if (cpulist_parse(str, tick_nohz_full_mask) < 0) {
+		pr_warning("NO_HZ: Incorrect nohz_full cpumask\n");
+		return 1;
+	}
+	tick_nohz_full_running = true;
+
+	return 1;
+}
+__setup("nohz_full=", tick_nohz_full_setup);
+
+static int __cpuinit tick_nohz_cpu_down_callback(struct notifier_block *nfb,
+						 unsigned long action,
+						 void *hcpu)
+{
+	unsigned int cpu = (unsigned long)hcpu;
+
+	switch (action & ~CPU_TASKS_FROZEN) {
+	case CPU_DOWN_PREPARE:
+		/*
+		 * The full dynticks CPUs never take over the do_timer
+		 * duty, so the CPU doing it for them can't go away.
+		 */
+		if (tick_nohz_full_running && tick_do_timer_cpu == cpu)
+			return NOTIFY_BAD;
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+static char __initdata nohz_full_buf[NR_CPUS];
+
+void __init tick_nohz_init(void)
+{
+	int cpu;
+
+	if (!tick_nohz_full_running)
+		return;
+
+	/* The boot CPU keeps the timekeeping going for everybody else */
+	cpu = smp_processor_id();
+	if (cpumask_test_cpu(cpu, tick_nohz_full_mask)) {
+		pr_warning("NO_HZ: Clearing %d from nohz_full range for timekeeping\n",
+			   cpu);
+		cpumask_clear_cpu(cpu, tick_nohz_full_mask);
+	}
+
+	if (cpumask_empty(tick_nohz_full_mask)) {
+		tick_nohz_full_running = false;
+		return;
+	}
+
+	cpu_notifier(tick_nohz_cpu_down_callback, 0);
+	cpulist_scnprintf(nohz_full_buf, sizeof(nohz_full_buf),
+			  tick_nohz_full_mask);
+	pr_info("NO_HZ: Full dynticks CPUs: %s.\n", nohz_full_buf);
+}
+#endif /* CONFIG_NO_HZ_FULL */
+
 /**
  * tick_nohz_update_jiffies - update jiffies when idle was interrupted
  *
@@ -301,6 +374,15 @@ static ktime_t tick_nohz_stop_sched_tick(struct tick_sched *ts,
 			delta_jiffies = rcu_delta_jiffies;
 		}
 	}
+	/*
+	 * A full dynticks CPU running a task still wants the scheduler
+	 * tick once a second to keep its load statistics going.
+	 */
+	if (!ts->inidle && delta_jiffies > HZ) {
+		next_jiffies = last_jiffies + HZ;
+		delta_jiffies = HZ;
+	}
+
 	/*
 	 * Do not stop the tick, if we are only one off
 	 * or if the cpu is required for rcu
@@ -372,8 +454,10 @@ static ktime_t tick_nohz_stop_sched_tick(struct tick_sched *ts,
 		 * the scheduler tick in nohz_restart_sched_tick.
 		 */
 		if (!ts->tick_stopped) {
-			select_nohz_load_balancer(1);
-			calc_load_enter_idle();
+			if (ts->inidle) {
+				select_nohz_load_balancer(1);
+				calc_load_enter_idle();
+			}
 
 			ts->last_tick = hrtimer_get_expires(&ts->sched_timer);
 			ts->tick_stopped = 1;
@@ -444,9 +528,237 @@ static bool can_stop_idle_tick(int cpu, struct tick_sched *ts)
 		return false;
 	}
 
+	if (tick_nohz_full_enabled()) {
+		/*
+		 * Keep the tick alive to guarantee timekeeping progression
+		 * if there are full dynticks CPUs around
+		 */
+		if (tick_do_timer_cpu == cpu)
+			return false;
+		/*
+		 * Boot safety: make sure the timekeeping duty has been
+		 * assigned before entering dyntick-idle mode,
+		 */
+		if (tick_do_timer_cpu == TICK_DO_TIMER_NONE)
+			return false;
+	}
+
+	return true;
+}
+
+#ifdef CONFIG_NO_HZ_FULL
+static void tick_nohz_restart(struct tick_sched *ts, ktime_t now);
+
+/*
+ * Can the tick of this busy CPU be stopped? Only if nothing depends on
+ * it while the single runnable task keeps going.
+ */
+static bool can_stop_full_tick(int cpu)
+{
+	WARN_ON_ONCE(!irqs_disabled());
+
+	if (!sched_can_stop_tick())
+		return false;
+
+	if (!posix_cpu_timers_can_stop_tick(current))
+		return false;
+
+	if (!perf_event_can_stop_tick())
+		return false;
+
+	if (rcu_nohz_full_needs_tick(cpu))
+		return false;
+
+#ifdef CONFIG_HAVE_UNSTABLE_SCHED_CLOCK
+	/*
+	 * sched_clock() is corrected by the tick when it isn't stable,
+	 * so it would drift without it.
+	 */
+	if (!sched_clock_stable)
+		return false;
+#endif
+
 	return true;
 }
 
+/*
+ * Charge the jiffies that went by with the tick stopped to @p, as they
+ * didn't get sampled by update_process_times().
+ */
+static void tick_nohz_full_account_ticks(struct tick_sched *ts,
+					 struct task_struct *p)
+{
+	unsigned long ticks = jiffies - ts->busy_jiffies;
+
+	/*
+	 * We might be one off. Do not randomly account a huge number of ticks!
+	 */
+	if (ticks && ticks < LONG_MAX) {
+		account_busy_ticks(p, ts->busy_user, ticks);
+		ts->busy_jiffies = jiffies;
+	}
+}
+
+/*
+ * Restart the tick of a busy CPU. Unlike tick_nohz_restart_sched_tick()
+ * this leaves the idle load and nohz balancing state alone.
+ */
+static void tick_nohz_full_restart(struct tick_sched *ts)
+{
+	ktime_t now = ktime_get();
+
+	tick_do_update_jiffies64(now);
+	ts->tick_stopped = 0;
+	tick_nohz_restart(ts, now);
+}
+
+static void tick_nohz_full_update_tick(struct tick_sched *ts)
+{
+	int cpu = smp_processor_id();
+	struct pt_regs *regs = get_irq_regs();
+	int was_stopped = ts->tick_stopped;
+
+	if (!tick_nohz_full_cpu(cpu) || is_idle_task(current))
+		return;
+
+	if (unlikely(ts->nohz_mode == NOHZ_MODE_INACTIVE))
+		return;
+
+	if (was_stopped) {
+		if (regs)
+			ts->busy_user = user_mode(regs);
+		tick_nohz_full_account_ticks(ts, current);
+	}
+
+	if (!can_stop_full_tick(cpu)) {
+		if (was_stopped)
+			tick_nohz_full_restart(ts);
+		return;
+	}
+
+	tick_nohz_stop_sched_tick(ts, ktime_get(), cpu);
+	if (!was_stopped && ts->tick_stopped) {
+		ts->busy_jiffies = jiffies;
+		ts->busy_user = regs ? user_mode(regs) : 0;
+	}
+}
+
+/*
+ * The residual tick of a busy full dynticks CPU: charge what ran tickless
+ * so far, except for the jiffy that update_process_times() samples.
+ */
+static void tick_nohz_full_tick_stopped(struct tick_sched *ts,
+					struct pt_regs *regs)
+{
+	ts->busy_user = user_mode(regs);
+	ts->busy_jiffies++;
+	tick_nohz_full_account_ticks(ts, current);
+}
+
+/**
+ * tick_nohz_full_check - re-evaluate the tick of a full dynticks CPU
+ *
+ * Called on a kick, when something that may need the tick showed up:
+ * restart it if so, otherwise reprogram it for the next event.
+ */
+void tick_nohz_full_check(void)
+{
+	tick_nohz_full_update_tick(&__get_cpu_var(tick_cpu_sched));
+}
+
+static void nohz_full_kick_work_func(struct irq_work *work)
+{
+	tick_nohz_full_check();
+}
+
+static DEFINE_PER_CPU(struct irq_work, nohz_full_kick_work) = {
+	.func = nohz_full_kick_work_func,
+};
+
+/**
+ * tick_nohz_full_kick - kick the local full dynticks CPU
+ *
+ * Safe to call from contexts which can't restart the tick themselves,
+ * such as with the runqueue lock held.
+ */
+void tick_nohz_full_kick(void)
+{
+	if (__get_cpu_var(tick_cpu_sched).tick_stopped)
+		irq_work_queue(&__get_cpu_var(nohz_full_kick_work));
+}
+
+/**
+ * tick_nohz_full_kick_cpu - kick a full dynticks CPU
+ * @cpu: the CPU to kick
+ *
+ * Makes @cpu re-evaluate its tick from the interrupt exit path.
+ * Called with preemption disabled.
+ */
+void tick_nohz_full_kick_cpu(int cpu)
+{
+	if (!tick_nohz_full_cpu(cpu))
+		return;
+
+	if (cpu == smp_processor_id())
+		tick_nohz_full_kick();
+	else
+		smp_send_reschedule(cpu);
+}
+
+static void nohz_full_kick_ipi(void *info)
+{
+	tick_nohz_full_check();
+}
+
+/**
+ * tick_nohz_full_kick_all - kick all full dynticks CPUs
+ *
+ * Used when something global, like a process wide cputimer, may
+ * require the tick everywhere.
+ */
+void tick_nohz_full_kick_all(void)
+{
+	if (!tick_nohz_full_running)
+		return;
+
+	preempt_disable();
+	smp_call_function_many(tick_nohz_full_mask,
+			       nohz_full_kick_ipi, NULL, false);
+	tick_nohz_full_kick_cpu(smp_processor_id());
+	preempt_enable();
+}
+
+/*
+ * Called on context switch: charge the outgoing task with the time it
+ * ran tickless, and check the tick dependencies of the incoming one.
+ */
+void __tick_nohz_task_switch(struct task_struct *prev)
+{
+	struct tick_sched *ts;
+	unsigned long flags;
+
+	local_irq_save(flags);
+
+	if (!tick_nohz_full_cpu(smp_processor_id()))
+		goto out;
+
+	ts = &__get_cpu_var(tick_cpu_sched);
+	if (ts->tick_stopped && !ts->inidle) {
+		tick_nohz_full_account_ticks(ts, prev);
+		ts->busy_user = 0;
+		if (!is_idle_task(current) &&
+		    !can_stop_full_tick(smp_processor_id()))
+			tick_nohz_full_restart(ts);
+	}
+out:
+	local_irq_restore(flags);
+}
+#else
+static inline void tick_nohz_full_update_tick(struct tick_sched *ts) { }
+static inline void tick_nohz_full_tick_stopped(struct tick_sched *ts,
+					       struct pt_regs *regs) { }
+#endif /* CONFIG_NO_HZ_FULL */
+
 static void __tick_nohz_idle_enter(struct tick_sched *ts)
 {
 	ktime_t now, expires;
@@ -505,6 +817,15 @@ void tick_nohz_idle_enter(void)
 	 * update of the idle time accounting in tick_nohz_start_idle().
 	 */
 	ts->inidle = 1;
+	/*
+	 * A full dynticks CPU may come here with the tick already stopped
+	 * while it was busy: do the idle entry bookkeeping now.
+	 */
+	if (ts->tick_stopped) {
+		select_nohz_load_balancer(1);
+		calc_load_enter_idle();
+		ts->idle_jiffies = jiffies;
+	}
 	__tick_nohz_idle_enter(ts);
 
 	local_irq_enable();
@@ -517,15 +838,16 @@ void tick_nohz_idle_enter(void)
  * a reschedule, it may still add, modify or delete a timer, enqueue
  * an RCU callback, etc...
  * So we need to re-calculate and reprogram the next tick event.
+ * A busy full dynticks CPU also stops or restarts its tick here.
  */
 void tick_nohz_irq_exit(void)
 {
 	struct tick_sched *ts = &__get_cpu_var(tick_cpu_sched);
 
-	if (!ts->inidle)
-		return;
-
-	__tick_nohz_idle_enter(ts);
+	if (ts->inidle)
+		__tick_nohz_idle_enter(ts);
+	else
+		tick_nohz_full_update_tick(ts);
 }
 
 /**
@@ -660,7 +982,8 @@ static void tick_nohz_handler(struct clock_event_device *dev)
 	 * this duty, then the jiffies update is still serialized by
 	 * xtime_lock.
 	 */
-	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE))
+	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE) &&
+	    !tick_nohz_full_cpu(cpu))
 		tick_do_timer_cpu = cpu;
 
 	/* Check, if the jiffies need an update */
@@ -677,7 +1000,10 @@ static void tick_nohz_handler(struct clock_event_device *dev)
 	 */
 	if (ts->tick_stopped) {
 		touch_softlockup_watchdog();
-		ts->idle_jiffies++;
+		if (idle_cpu(cpu))
+			ts->idle_jiffies++;
+		else
+			tick_nohz_full_tick_stopped(ts, regs);
 	}
 
 	update_process_times(user_mode(regs));
@@ -776,6 +1102,8 @@ static inline void tick_check_nohz(int cpu)
 
 static inline void tick_nohz_switch_to_nohz(void) { }
 static inline void tick_check_nohz(int cpu) { }
+static inline void tick_nohz_full_tick_stopped(struct tick_sched *ts,
+					       struct pt_regs *regs) { }
 
 #endif /* NO_HZ */
 
@@ -812,7 +1140,8 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 	 * this duty, then the jiffies update is still serialized by
 	 * xtime_lock.
 	 */
-	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE))
+	if (unlikely(tick_do_timer_cpu == TICK_DO_TIMER_NONE) &&
+	    !tick_nohz_full_cpu(cpu))
 		tick_do_timer_cpu = cpu;
 #endif
 
@@ -837,6 +1166,8 @@ static enum hrtimer_restart tick_sched_timer(struct hrtimer *timer)
 			touch_softlockup_watchdog();
 			if (idle_cpu(cpu))
 				ts->idle_jiffies++;
+			else
+				tick_nohz_full_tick_stopped(ts, regs);
 		}
 		update_process_times(user_mode(regs));
 		profile_tick(CPU_PROFILING);
@@ -253,7 +253,8 @@ static void timekeeping_update(struct timekeeper *tk, bool clearntp)
 		ntp_clear();
 	}
 	xt = tk_xtime(tk);
-	update_vsyscall(&xt, &tk->wall_to_monotonic, tk->clock, tk->mult);
+	update_vsyscall(&xt, &tk->wall_to_monotonic, &tk->raw_time,
+			&tk->total_sleep_time, tk->clock, tk->mult);
 }
 
 /**
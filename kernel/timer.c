@@ -55,22 +55,55 @@ u64 jiffies_64 __cacheline_aligned_in_smp = INITIAL_JIFFIES;
 EXPORT_SYMBOL(jiffies_64);
 
 /*
- * per-CPU timer vector definitions:
+ * The per-CPU timer wheel has LVL_DEPTH levels of LVL_SIZE buckets each.
+ * Each level runs off its own clock, LVL_CLK_DIV times slower than the
+ * one below, so the granularity of a level is LVL_CLK_DIV times coarser
+ * than that of the level below.  A timer is queued into the level whose
+ * range covers its timeout, with the expiry rounded up to the level's
+ * granularity, and stays there until it expires.  There is no cascading
+ * of timers from the upper levels into the lower ones: timeouts far in
+ * the future are simply less precise, which is fine for the typical
+ * networking and watchdog timers that are canceled long before expiry.
+ *
+ * HZ 1000, LVL_DEPTH 9:
+ *
+ * Level Offset  Granularity            Range
+ *  0	  0         1 ms                0 ms -         62 ms
+ *  1	 64         8 ms               63 ms -        503 ms
+ *  2	128        64 ms              504 ms -       4031 ms (~4s)
+ *  3	192       512 ms (~0.5s)        ~4s  -        ~32s
+ *  4	256      4096 ms (~4s)         ~32s  -         ~4m
+ *  5	320     32768 ms (~32s)         ~4m  -        ~34m
+ *  6	384    262144 ms (~4m)         ~34m  -        ~4.5h
+ *  7	448   2097152 ms (~34m)        ~4.5h -        ~1.5d
+ *  8	512  16777216 ms (~4.5h)       ~1.5d -         ~12d
+ *
+ * Timeouts beyond the capacity of the wheel are clamped to its last
+ * bucket.  Level 0 is exact, so short timers behave as before.
  */
-#define TVN_BITS (CONFIG_BASE_SMALL ? 4 : 6)
-#define TVR_BITS (CONFIG_BASE_SMALL ? 6 : 8)
-#define TVN_SIZE (1 << TVN_BITS)
-#define TVR_SIZE (1 << TVR_BITS)
-#define TVN_MASK (TVN_SIZE - 1)
-#define TVR_MASK (TVR_SIZE - 1)
-
-struct tvec {
-	struct list_head vec[TVN_SIZE];
-};
+#define LVL_CLK_SHIFT	3
+#define LVL_CLK_DIV	(1UL << LVL_CLK_SHIFT)
+#define LVL_CLK_MASK	(LVL_CLK_DIV - 1)
+#define LVL_SHIFT(n)	((n) * LVL_CLK_SHIFT)
+#define LVL_GRAN(n)	(1UL << LVL_SHIFT(n))
+
+#define LVL_BITS	(CONFIG_BASE_SMALL ? 5 : 6)
+#define LVL_SIZE	(1UL << LVL_BITS)
+#define LVL_MASK	(LVL_SIZE - 1)
+#define LVL_OFFS(n)	((n) * LVL_SIZE)
+
+/* First timeout (relative to the wheel clock) handled by level n > 0 */
+#define LVL_START(n)	((LVL_SIZE - 1) << (((n) - 1) * LVL_CLK_SHIFT))
+
+#if HZ > 100
+# define LVL_DEPTH	9
+#else
+# define LVL_DEPTH	8
+#endif
 
-struct tvec_root {
-	struct list_head vec[TVR_SIZE];
-};
+#define WHEEL_TIMEOUT_CUTOFF	(LVL_START(LVL_DEPTH))
+#define WHEEL_TIMEOUT_MAX	(WHEEL_TIMEOUT_CUTOFF - LVL_GRAN(LVL_DEPTH - 1))
+#define WHEEL_SIZE		(LVL_SIZE * LVL_DEPTH)
 
 struct tvec_base {
 	spinlock_t lock;
@@ -78,11 +111,8 @@ struct tvec_base {
 	unsigned long timer_jiffies;
 	unsigned long next_timer;
 	unsigned long active_timers;
-	struct tvec_root tv1;
-	struct tvec tv2;
-	struct tvec tv3;
-	struct tvec tv4;
-	struct tvec tv5;
+	DECLARE_BITMAP(pending_map, WHEEL_SIZE);
+	struct list_head vectors[WHEEL_SIZE];
 } ____cacheline_aligned;
 
 struct tvec_base boot_tvec_bases;
@@ -331,58 +361,110 @@ void set_timer_slack(struct timer_list *timer, int slack_hz)
 }
 EXPORT_SYMBOL_GPL(set_timer_slack);
 
-static void
-__internal_add_timer(struct tvec_base *base, struct timer_list *timer)
+/*
+ * Helper function to calculate the array index and the expiry of the
+ * bucket for a given level.  Level 0 is exact; on the other levels the
+ * expiry is rounded up to the level granularity so that a timer never
+ * fires early.
+ */
+static inline unsigned int calc_index(unsigned long expires, unsigned int lvl,
+				      unsigned long *bucket_expiry)
+{
+	if (lvl) {
+		expires = (expires + LVL_GRAN(lvl) - 1) >> LVL_SHIFT(lvl);
+		*bucket_expiry = expires << LVL_SHIFT(lvl);
+	} else {
+		*bucket_expiry = expires;
+	}
+	return LVL_OFFS(lvl) + (expires & LVL_MASK);
+}
+
+static unsigned int calc_wheel_index(unsigned long expires, unsigned long clk,
+				     unsigned long *bucket_expiry)
 {
-	unsigned long expires = timer->expires;
-	unsigned long idx = expires - base->timer_jiffies;
-	struct list_head *vec;
-
-	if (idx < TVR_SIZE) {
-		int i = expires & TVR_MASK;
-		vec = base->tv1.vec + i;
-	} else if (idx < 1 << (TVR_BITS + TVN_BITS)) {
-		int i = (expires >> TVR_BITS) & TVN_MASK;
-		vec = base->tv2.vec + i;
-	} else if (idx < 1 << (TVR_BITS + 2 * TVN_BITS)) {
-		int i = (expires >> (TVR_BITS + TVN_BITS)) & TVN_MASK;
-		vec = base->tv3.vec + i;
-	} else if (idx < 1 << (TVR_BITS + 3 * TVN_BITS)) {
-		int i = (expires >> (TVR_BITS + 2 * TVN_BITS)) & TVN_MASK;
-		vec = base->tv4.vec + i;
-	} else if ((signed long) idx < 0) {
+	unsigned long delta = expires - clk;
+	unsigned int lvl;
+
+	if ((long) delta < 0) {
 		/*
 		 * Can happen if you add a timer with expires == jiffies,
 		 * or you set a timer to go off in the past
 		 */
-		vec = base->tv1.vec + (base->timer_jiffies & TVR_MASK);
-	} else {
-		int i;
-		/* If the timeout is larger than 0xffffffff on 64-bit
-		 * architectures then we use the maximum timeout:
-		 */
-		if (idx > 0xffffffffUL) {
-			idx = 0xffffffffUL;
-			expires = idx + base->timer_jiffies;
-		}
-		i = (expires >> (TVR_BITS + 3 * TVN_BITS)) & TVN_MASK;
-		vec = base->tv5.vec + i;
+		*bucket_expiry = clk;
+		return clk & LVL_MASK;
 	}
+
+	/*
+	 * Force the expiry into the last level if the timeout exceeds
+	 * the capacity of the wheel.
+	 */
+	if (delta >= WHEEL_TIMEOUT_CUTOFF) {
+		expires = clk + WHEEL_TIMEOUT_MAX;
+		delta = WHEEL_TIMEOUT_MAX;
+	}
+
+	for (lvl = 0; lvl < LVL_DEPTH - 1; lvl++)
+		if (delta < LVL_START(lvl + 1))
+			break;
+
+	return calc_index(expires, lvl, bucket_expiry);
+}
+
+/*
+ * Returns the expiry of the bucket the timer was queued to, which is
+ * when __run_timers() will actually run it.
+ */
+static unsigned long
+__internal_add_timer(struct tvec_base *base, struct timer_list *timer)
+{
+	unsigned long bucket_expiry;
+	unsigned int idx;
+
+	idx = calc_wheel_index(timer->expires, base->timer_jiffies,
+			       &bucket_expiry);
 	/*
 	 * Timers are FIFO:
 	 */
-	list_add_tail(&timer->entry, vec);
+	list_add_tail(&timer->entry, base->vectors + idx);
+	__set_bit(idx, base->pending_map);
+	timer->idx = idx;
+
+	return bucket_expiry;
+}
+
+static unsigned long __next_timer_interrupt(struct tvec_base *base,
+					    bool deferrable);
+
+/*
+ * While a CPU is idle its wheel clock is not advanced, and a timer
+ * queued relative to a stale clock would land on a level that is far
+ * too coarse for it.  Catch the clock up with jiffies, but never past
+ * the first pending bucket, so that no bucket is skipped.
+ */
+static void forward_timer_base(struct tvec_base *base)
+{
+	unsigned long jnow = jiffies;
+	unsigned long next;
+
+	if ((long) (jnow - base->timer_jiffies) < 2)
+		return;
+
+	next = __next_timer_interrupt(base, true);
+	base->timer_jiffies = time_after(next, jnow) ? jnow : next;
 }
 
 static void internal_add_timer(struct tvec_base *base, struct timer_list *timer)
 {
-	__internal_add_timer(base, timer);
+	unsigned long bucket_expiry;
+
+	forward_timer_base(base);
+	bucket_expiry = __internal_add_timer(base, timer);
 	/*
 	 * Update base->active_timers and base->next_timer
 	 */
 	if (!tbase_get_deferrable(timer->base)) {
-		if (time_before(timer->expires, base->next_timer))
-			base->next_timer = timer->expires;
+		if (time_before(bucket_expiry, base->next_timer))
+			base->next_timer = bucket_expiry;
 		base->active_timers++;
 	}
 }
@@ -692,13 +774,25 @@ detach_expired_timer(struct timer_list *timer, struct tvec_base *base)
 static int detach_if_pending(struct timer_list *timer, struct tvec_base *base,
 			     bool clear_pending)
 {
+	unsigned int idx = timer->idx;
+	bool emptied;
+
 	if (!timer_pending(timer))
 		return 0;
 
+	/*
+	 * Expired timers sit on a private list of __run_timers() rather
+	 * than in their bucket, which must then be left alone.
+	 */
+	emptied = timer->entry.next == timer->entry.prev &&
+		  timer->entry.next == base->vectors + idx;
+
 	detach_timer(timer, clear_pending);
+	if (emptied)
+		__clear_bit(idx, base->pending_map);
 	if (!tbase_get_deferrable(timer->base)) {
 		timer->base->active_timers--;
-		if (timer->expires == base->next_timer)
+		if (emptied)
 			base->next_timer = base->timer_jiffies;
 	}
 	return 1;
@@ -747,7 +841,28 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 	timer_stats_timer_set_start_info(timer);
 	BUG_ON(!timer->function);
 
-	base = lock_timer_base(timer, &flags);
+	/*
+	 * If the timer stays in the same bucket, only its expiry needs
+	 * updating: it is run at the bucket's expiry either way.  Check
+	 * timer_pending() locklessly first, so that inactive timers go
+	 * straight to the slow path.  A timer that __run_timers() already
+	 * took off the wheel can not match, since the wheel clock has
+	 * moved past its bucket and a new expiry lands in a higher level.
+	 */
+	if (timer_pending(timer)) {
+		unsigned long bucket_expiry;
+
+		base = lock_timer_base(timer, &flags);
+		if (timer_pending(timer) &&
+		    calc_wheel_index(expires, base->timer_jiffies,
+				     &bucket_expiry) == timer->idx) {
+			timer->expires = expires;
+			ret = 1;
+			goto out_unlock;
+		}
+	} else {
+		base = lock_timer_base(timer, &flags);
+	}
 
 	ret = detach_if_pending(timer, base, false);
 	if (!ret && pending_only)
@@ -758,7 +873,8 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 	cpu = smp_processor_id();
 
 #if defined(CONFIG_NO_HZ) && defined(CONFIG_SMP)
-	if (!pinned && get_sysctl_timer_migration() && idle_cpu(cpu))
+	if (!pinned && get_sysctl_timer_migration() &&
+	    (idle_cpu(cpu) || tick_nohz_full_cpu(cpu)))
 		cpu = get_nohz_timer_target();
 #endif
 	new_base = per_cpu(tvec_bases, cpu);
@@ -784,6 +900,13 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 	timer->expires = expires;
 	internal_add_timer(base, timer);
 
+	/*
+	 * A timer pinned to a full dynticks CPU running tickless may
+	 * expire before the next programmed tick.
+	 */
+	if (tick_nohz_full_cpu(cpu))
+		tick_nohz_full_kick();
+
 out_unlock:
 	spin_unlock_irqrestore(&base->lock, flags);
 
@@ -815,6 +938,10 @@ EXPORT_SYMBOL(mod_timer_pending);
  *   3) use this bit to make a mask
  *   4) use the bitmask to round down the maximum time, so that all last
  *      bits are zeros
+ *
+ * The default slack (-1) needs no rounding any more: the wheel levels
+ * above the first one already batch timers at a granularity of more
+ * than 1/64 of their timeout.
  */
 static inline
 unsigned long apply_slack(struct timer_list *timer, unsigned long expires)
@@ -822,16 +949,10 @@ unsigned long apply_slack(struct timer_list *timer, unsigned long expires)
 	unsigned long expires_limit, mask;
 	int bit;
 
-	if (timer->slack >= 0) {
-		expires_limit = expires + timer->slack;
-	} else {
-		long delta = expires - jiffies;
-
-		if (delta < 256)
-			return expires;
+	if (timer->slack < 0)
+		return expires;
 
-		expires_limit = expires + delta / 256;
-	}
+	expires_limit = expires + timer->slack;
 	mask = expires ^ expires_limit;
 	if (mask == 0)
 		return expires;
@@ -954,9 +1075,9 @@ void add_timer_on(struct timer_list *timer, int cpu)
 	 * active. We are protected against the other CPU fiddling
 	 * with the timer by holding the timer base lock. This also
 	 * makes sure that a CPU on the way to idle can not evaluate
-	 * the timer wheel.
+	 * the timer wheel. A busy full dynticks CPU is kicked as well.
 	 */
-	wake_up_idle_cpu(cpu);
+	wake_up_nohz_cpu(cpu);
 	spin_unlock_irqrestore(&base->lock, flags);
 }
 EXPORT_SYMBOL_GPL(add_timer_on);
@@ -1084,27 +1205,6 @@ int del_timer_sync(struct timer_list *timer)
 EXPORT_SYMBOL(del_timer_sync);
 #endif
 
-static int cascade(struct tvec_base *base, struct tvec *tv, int index)
-{
-	/* cascade all the timers from tv up one level */
-	struct timer_list *timer, *tmp;
-	struct list_head tv_list;
-
-	list_replace_init(tv->vec + index, &tv_list);
-
-	/*
-	 * We are removing _all_ timers from the list, so we
-	 * don't have to detach them individually.
-	 */
-	list_for_each_entry_safe(timer, tmp, &tv_list, entry) {
-		BUG_ON(tbase_get_base(timer->base) != base);
-		/* No accounting, while moving them */
-		__internal_add_timer(base, timer);
-	}
-
-	return index;
-}
-
 static void call_timer_fn(struct timer_list *timer, void (*fn)(unsigned long),
 			  unsigned long data)
 {
@@ -1148,133 +1248,157 @@ static void call_timer_fn(struct timer_list *timer, void (*fn)(unsigned long),
 	}
 }
 
-#define INDEX(N) ((base->timer_jiffies >> (TVR_BITS + (N) * TVN_BITS)) & TVN_MASK)
+static void expire_timers(struct tvec_base *base, struct list_head *head)
+{
+	struct timer_list *timer;
+
+	while (!list_empty(head)) {
+		void (*fn)(unsigned long);
+		unsigned long data;
+
+		timer = list_first_entry(head, struct timer_list, entry);
+		fn = timer->function;
+		data = timer->data;
+
+		timer_stats_account_timer(timer);
+
+		base->running_timer = timer;
+		detach_expired_timer(timer, base);
+
+		spin_unlock_irq(&base->lock);
+		call_timer_fn(timer, fn, data);
+		spin_lock_irq(&base->lock);
+	}
+}
+
+/*
+ * Move the buckets that expire at base->timer_jiffies off the wheel.
+ * Level n is only looked at when the clocks of all levels below it have
+ * wrapped, i.e. once every LVL_CLK_DIV^n jiffies.
+ */
+static int collect_expired_timers(struct tvec_base *base,
+				  struct list_head *heads)
+{
+	unsigned long clk = base->timer_jiffies;
+	unsigned int idx;
+	int i, levels = 0;
+
+	for (i = 0; i < LVL_DEPTH; i++) {
+		idx = (clk & LVL_MASK) + i * LVL_SIZE;
+
+		if (__test_and_clear_bit(idx, base->pending_map))
+			list_replace_init(base->vectors + idx, heads + levels++);
+		/* Is it time to look at the next level? */
+		if (clk & LVL_CLK_MASK)
+			break;
+		clk >>= LVL_CLK_SHIFT;
+	}
+	return levels;
+}
 
 /**
  * __run_timers - run all expired timers (if any) on this CPU.
  * @base: the timer vector to be processed.
  *
- * This function cascades all vectors and executes all expired timer
- * vectors.
+ * This function collects the expired buckets of all levels and executes
+ * the timers on them.  Timers never move between levels, so nothing is
+ * cascaded under base->lock, and a clock that fell behind (e.g. after a
+ * long idle period) is fast-forwarded over the empty buckets.
  */
 static inline void __run_timers(struct tvec_base *base)
 {
-	struct timer_list *timer;
+	struct list_head heads[LVL_DEPTH];
+	int levels;
 
 	spin_lock_irq(&base->lock);
 	while (time_after_eq(jiffies, base->timer_jiffies)) {
-		struct list_head work_list;
-		struct list_head *head = &work_list;
-		int index = base->timer_jiffies & TVR_MASK;
-
-		/*
-		 * Cascade timers:
-		 */
-		if (!index &&
-			(!cascade(base, &base->tv2, INDEX(0))) &&
-				(!cascade(base, &base->tv3, INDEX(1))) &&
-					!cascade(base, &base->tv4, INDEX(2)))
-			cascade(base, &base->tv5, INDEX(3));
+		forward_timer_base(base);
+		levels = collect_expired_timers(base, heads);
 		++base->timer_jiffies;
-		list_replace_init(base->tv1.vec + index, &work_list);
-		while (!list_empty(head)) {
-			void (*fn)(unsigned long);
-			unsigned long data;
 
-			timer = list_first_entry(head, struct timer_list,entry);
-			fn = timer->function;
-			data = timer->data;
+		while (levels--)
+			expire_timers(base, heads + levels);
+	}
+	base->running_timer = NULL;
+	spin_unlock_irq(&base->lock);
+}
 
-			timer_stats_account_timer(timer);
+static bool bucket_has_active_timers(struct list_head *head)
+{
+	struct timer_list *nte;
 
-			base->running_timer = timer;
-			detach_expired_timer(timer, base);
+	list_for_each_entry(nte, head, entry)
+		if (!tbase_get_deferrable(nte->base))
+			return true;
+	return false;
+}
 
-			spin_unlock_irq(&base->lock);
-			call_timer_fn(timer, fn, data);
-			spin_lock_irq(&base->lock);
+/*
+ * Search the bucket bitmap of the level at @offset for the first bucket
+ * at or after @clk, wrapping around.  Unless @deferrable is set, buckets
+ * that hold only deferrable timers are skipped.  Returns the distance of
+ * that bucket from @clk, or -1 if there is none.
+ */
+static int next_pending_bucket(struct tvec_base *base, unsigned int offset,
+			       unsigned int clk, bool deferrable)
+{
+	unsigned int start = offset + clk;
+	unsigned int lo = start, hi = offset + LVL_SIZE;
+	unsigned int pos;
+	int pass;
+
+	for (pass = 0; pass < 2; pass++) {
+		for (pos = find_next_bit(base->pending_map, hi, lo); pos < hi;
+		     pos = find_next_bit(base->pending_map, hi, pos + 1)) {
+			if (deferrable ||
+			    bucket_has_active_timers(base->vectors + pos))
+				return pass ? pos + LVL_SIZE - start :
+					      pos - start;
 		}
+		lo = offset;
+		hi = start;
 	}
-	base->running_timer = NULL;
-	spin_unlock_irq(&base->lock);
+	return -1;
 }
 
-#ifdef CONFIG_NO_HZ
 /*
- * Find out when the next timer event is due to happen. This
- * is used on S/390 to stop all activity when a CPU is idle.
- * This function needs to be called with interrupts disabled.
+ * Find the jiffy at which the first pending bucket is due to be run,
+ * considering deferrable timers only if @deferrable is set.  Must be
+ * called with base->lock held.
  */
-static unsigned long __next_timer_interrupt(struct tvec_base *base)
+static unsigned long __next_timer_interrupt(struct tvec_base *base,
+					    bool deferrable)
 {
-	unsigned long timer_jiffies = base->timer_jiffies;
-	unsigned long expires = timer_jiffies + NEXT_TIMER_MAX_DELTA;
-	int index, slot, array, found = 0;
-	struct timer_list *nte;
-	struct tvec *varray[4];
-
-	/* Look for timer events in tv1. */
-	index = slot = timer_jiffies & TVR_MASK;
-	do {
-		list_for_each_entry(nte, base->tv1.vec + slot, entry) {
-			if (tbase_get_deferrable(nte->base))
-				continue;
-
-			found = 1;
-			expires = nte->expires;
-			/* Look at the cascade bucket(s)? */
-			if (!index || slot < index)
-				goto cascade;
-			return expires;
-		}
-		slot = (slot + 1) & TVR_MASK;
-	} while (slot != index);
-
-cascade:
-	/* Calculate the next cascade event */
-	if (index)
-		timer_jiffies += TVR_SIZE - index;
-	timer_jiffies >>= TVR_BITS;
-
-	/* Check tv2-tv5. */
-	varray[0] = &base->tv2;
-	varray[1] = &base->tv3;
-	varray[2] = &base->tv4;
-	varray[3] = &base->tv5;
-
-	for (array = 0; array < 4; array++) {
-		struct tvec *varp = varray[array];
-
-		index = slot = timer_jiffies & TVN_MASK;
-		do {
-			list_for_each_entry(nte, varp->vec + slot, entry) {
-				if (tbase_get_deferrable(nte->base))
-					continue;
-
-				found = 1;
-				if (time_before(nte->expires, expires))
-					expires = nte->expires;
-			}
-			/*
-			 * Do we still search for the first timer or are
-			 * we looking up the cascade buckets ?
-			 */
-			if (found) {
-				/* Look at the cascade bucket(s)? */
-				if (!index || slot < index)
-					break;
-				return expires;
-			}
-			slot = (slot + 1) & TVN_MASK;
-		} while (slot != index);
+	unsigned long clk = base->timer_jiffies;
+	unsigned long next = clk + NEXT_TIMER_MAX_DELTA;
+	unsigned int offset = 0;
+	int lvl;
+
+	for (lvl = 0; lvl < LVL_DEPTH; lvl++, offset += LVL_SIZE) {
+		int pos = next_pending_bucket(base, offset, clk & LVL_MASK,
+					      deferrable);
+		unsigned long adj;
+
+		if (pos >= 0) {
+			unsigned long tmp = clk + (unsigned long) pos;
 
-		if (index)
-			timer_jiffies += TVN_SIZE - index;
-		timer_jiffies >>= TVN_BITS;
+			tmp <<= LVL_SHIFT(lvl);
+			if (time_before(tmp, next))
+				next = tmp;
+		}
+		/*
+		 * The clock of the next level is the current one rounded
+		 * up: a partially elapsed period of the next level is not
+		 * going to be collected before it has elapsed completely.
+		 */
+		adj = clk & LVL_CLK_MASK ? 1 : 0;
+		clk >>= LVL_CLK_SHIFT;
+		clk += adj;
 	}
-	return expires;
+	return next;
 }
 
+#ifdef CONFIG_NO_HZ
 /*
  * Check, if the next hrtimer event is before the next timer wheel
  * event:
@@ -1338,7 +1462,7 @@ unsigned long get_next_timer_interrupt(unsigned long now)
 	spin_lock(&base->lock);
 	if (base->active_timers) {
 		if (time_before_eq(base->next_timer, base->timer_jiffies))
-			base->next_timer = __next_timer_interrupt(base);
+			base->next_timer = __next_timer_interrupt(base, false);
 		expires = base->next_timer;
 	}
 	spin_unlock(&base->lock);
@@ -1697,14 +1821,9 @@ static int __cpuinit init_timers_cpu(int cpu)
 
 	spin_lock_init(&base->lock);
 
-	for (j = 0; j < TVN_SIZE; j++) {
-		INIT_LIST_HEAD(base->tv5.vec + j);
-		INIT_LIST_HEAD(base->tv4.vec + j);
-		INIT_LIST_HEAD(base->tv3.vec + j);
-		INIT_LIST_HEAD(base->tv2.vec + j);
-	}
-	for (j = 0; j < TVR_SIZE; j++)
-		INIT_LIST_HEAD(base->tv1.vec + j);
+	for (j = 0; j < WHEEL_SIZE; j++)
+		INIT_LIST_HEAD(base->vectors + j);
+	bitmap_zero(base->pending_map, WHEEL_SIZE);
 
 	base->timer_jiffies = jiffies;
 	base->next_timer = base->timer_jiffies;
@@ -1744,14 +1863,9 @@ static void __cpuinit migrate_timers(int cpu)
 
 	BUG_ON(old_base->running_timer);
 
-	for (i = 0; i < TVR_SIZE; i++)
-		migrate_timer_list(new_base, old_base->tv1.vec + i);
-	for (i = 0; i < TVN_SIZE; i++) {
-		migrate_timer_list(new_base, old_base->tv2.vec + i);
-		migrate_timer_list(new_base, old_base->tv3.vec + i);
-		migrate_timer_list(new_base, old_base->tv4.vec + i);
-		migrate_timer_list(new_base, old_base->tv5.vec + i);
-	}
+	for_each_set_bit(i, old_base->pending_map, WHEEL_SIZE)
+		migrate_timer_list(new_base, old_base->vectors + i);
+	bitmap_zero(old_base->pending_map, WHEEL_SIZE);
 
 	spin_unlock(&old_base->lock);
 	spin_unlock_irq(&new_base->lock);
@@ -41,6 +41,7 @@
 #include <linux/debug_locks.h>
 #include <linux/lockdep.h>
 #include <linux/idr.h>
+#include <linux/device.h>
 
 #include "workqueue_sched.h"
 
@@ -122,6 +123,8 @@ enum {
  * F: wq->flush_mutex protected.
  *
  * W: workqueue_lock protected.
+ *
+ * A: wq_attrs_mutex protected.
  */
 
 struct global_cwq;
@@ -148,6 +151,7 @@ struct worker {
 	unsigned long		last_active;	/* L: last active timestamp */
 	unsigned int		flags;		/* X: flags */
 	int			id;		/* I: worker id */
+	unsigned int		attrs_seq;	/* A: gcwq attrs applied */
 
 	/* for rebinding worker to CPU */
 	struct idle_rebind	*idle_rebind;	/* L: for idle worker */
@@ -187,6 +191,16 @@ struct global_cwq {
 	struct worker_pool	pools[2];	/* normal and highpri pools */
 
 	wait_queue_head_t	rebind_hold;	/* rebind hold wait */
+
+	/*
+	 * Attributes of an unbound gcwq.  Workers apply them to
+	 * themselves when they notice @attrs_seq has moved, which is
+	 * bumped under both wq_attrs_mutex and gcwq->lock.
+	 */
+	int			nice;		/* A: nice of normal pool */
+	cpumask_var_t		cpumask;	/* A: cpus workers may use */
+	bool			custom_cpumask;	/* A: set from userland */
+	unsigned int		attrs_seq;	/* A+L: attrs generation */
 } ____cacheline_aligned_in_smp;
 
 /*
@@ -206,6 +220,17 @@ struct cpu_workqueue_struct {
 	struct list_head	delayed_works;	/* L: delayed works */
 };
 
+/*
+ * cwqs are forced aligned according to WORK_STRUCT_FLAG_BITS.  Make
+ * sure that the alignment isn't lower than that of unsigned long long.
+ * The cwqs of an unbound workqueue are laid out back to back at this
+ * stride, one for each unbound gcwq.
+ */
+#define CWQ_ALIGN		max_t(size_t, 1 << WORK_STRUCT_FLAG_BITS, \
+				      __alignof__(unsigned long long))
+#define UNBOUND_CWQ_STRIDE	ALIGN(sizeof(struct cpu_workqueue_struct), \
+				      CWQ_ALIGN)
+
 /*
  * Structure used to wait for workqueue flush.
  */
@@ -292,6 +317,12 @@ EXPORT_SYMBOL_GPL(system_nrt_freezable_wq);
 	for (i = 0; i < BUSY_WORKER_HASH_SIZE; i++)			\
 		hlist_for_each_entry(worker, pos, &gcwq->busy_hash[i], hentry)
 
+/*
+ * Number of unbound gcwqs: the global one, followed by one per NUMA
+ * node if there's more than one node.  Set once by init_workqueues().
+ */
+static unsigned int wq_nr_unbound __read_mostly = 1;
+
 static inline int __next_gcwq_cpu(int cpu, const struct cpumask *mask,
 				  unsigned int sw)
 {
@@ -303,7 +334,8 @@ static inline int __next_gcwq_cpu(int cpu, const struct cpumask *mask,
 		}
 		if (sw & 2)
 			return WORK_CPU_UNBOUND;
-	}
+	} else if ((sw & 2) && cpu + 1 < WORK_CPU_UNBOUND + wq_nr_unbound)
+		return cpu + 1;
 	return WORK_CPU_NONE;
 }
 
@@ -316,15 +348,17 @@ static inline int __next_wq_cpu(int cpu, const struct cpumask *mask,
 /*
  * CPU iterators
  *
- * An extra gcwq is defined for an invalid cpu number
- * (WORK_CPU_UNBOUND) to host workqueues which are not bound to any
- * specific CPU.  The following iterators are similar to
- * for_each_*_cpu() iterators but also considers the unbound gcwq.
+ * Extra gcwqs are defined for invalid cpu numbers starting at
+ * WORK_CPU_UNBOUND to host workqueues which are not bound to any
+ * specific CPU: the global unbound gcwq at WORK_CPU_UNBOUND and, on
+ * NUMA machines, one per node right after it.  The following iterators
+ * are similar to for_each_*_cpu() iterators but also consider the
+ * unbound gcwqs.
  *
- * for_each_gcwq_cpu()		: possible CPUs + WORK_CPU_UNBOUND
- * for_each_online_gcwq_cpu()	: online CPUs + WORK_CPU_UNBOUND
+ * for_each_gcwq_cpu()		: possible CPUs + unbound gcwqs
+ * for_each_online_gcwq_cpu()	: online CPUs + unbound gcwqs
  * for_each_cwq_cpu()		: possible CPUs for bound workqueues,
- *				  WORK_CPU_UNBOUND for unbound workqueues
+ *				  unbound gcwqs for unbound workqueues
  */
 #define for_each_gcwq_cpu(cpu)						\
 	for ((cpu) = __next_gcwq_cpu(-1, cpu_possible_mask, 3);		\
@@ -471,15 +505,24 @@ static DEFINE_PER_CPU(struct global_cwq, global_cwq);
 static DEFINE_PER_CPU_SHARED_ALIGNED(atomic_t, pool_nr_running[NR_WORKER_POOLS]);
 
 /*
- * Global cpu workqueue and nr_running counter for unbound gcwq.  The
- * gcwq is always online, has GCWQ_DISASSOCIATED set, and all its
- * workers have WORKER_UNBOUND set.
+ * Global cpu workqueues and nr_running counter for unbound gcwqs.
+ * unbound_gcwqs[0] is the global unbound gcwq whose workers may run
+ * anywhere; on NUMA machines it's followed by one gcwq per node whose
+ * workers are affine to the node's CPUs.  Unbound gcwqs are always
+ * online, have GCWQ_DISASSOCIATED set, and all their workers have
+ * WORKER_UNBOUND set.
  */
 static struct global_cwq unbound_global_cwq;
+static struct global_cwq *unbound_gcwqs[1 + MAX_NUMNODES] = {
+	[0]				= &unbound_global_cwq,
+};
 static atomic_t unbound_pool_nr_running[NR_WORKER_POOLS] = {
 	[0 ... NR_WORKER_POOLS - 1]	= ATOMIC_INIT(0),	/* always 0 */
 };
 
+/* serializes changes to the attributes of unbound gcwqs */
+static DEFINE_MUTEX(wq_attrs_mutex);
+
 static int worker_thread(void *__worker);
 
 static int worker_pool_pri(struct worker_pool *pool)
@@ -489,10 +532,18 @@ static int worker_pool_pri(struct worker_pool *pool)
 
 static struct global_cwq *get_gcwq(unsigned int cpu)
 {
-	if (cpu != WORK_CPU_UNBOUND)
+	if (cpu < WORK_CPU_UNBOUND)
 		return &per_cpu(global_cwq, cpu);
 	else
-		return &unbound_global_cwq;
+		return unbound_gcwqs[cpu - WORK_CPU_UNBOUND];
+}
+
+/* NUMA node served by an unbound gcwq, NUMA_NO_NODE for the global one */
+static int gcwq_node(struct global_cwq *gcwq)
+{
+	if (gcwq->cpu <= WORK_CPU_UNBOUND)
+		return NUMA_NO_NODE;
+	return gcwq->cpu - WORK_CPU_UNBOUND - 1;
 }
 
 static atomic_t *get_pool_nr_running(struct worker_pool *pool)
@@ -500,7 +551,7 @@ static atomic_t *get_pool_nr_running(struct worker_pool *pool)
 	int cpu = pool->gcwq->cpu;
 	int idx = worker_pool_pri(pool);
 
-	if (cpu != WORK_CPU_UNBOUND)
+	if (cpu < WORK_CPU_UNBOUND)
 		return &per_cpu(pool_nr_running, cpu)[idx];
 	else
 		return &unbound_pool_nr_running[idx];
@@ -512,11 +563,35 @@ static struct cpu_workqueue_struct *get_cwq(unsigned int cpu,
 	if (!(wq->flags & WQ_UNBOUND)) {
 		if (likely(cpu < nr_cpu_ids))
 			return per_cpu_ptr(wq->cpu_wq.pcpu, cpu);
-	} else if (likely(cpu == WORK_CPU_UNBOUND))
-		return wq->cpu_wq.single;
+	} else if (likely(cpu >= WORK_CPU_UNBOUND &&
+			  cpu < WORK_CPU_UNBOUND + wq_nr_unbound))
+		return (void *)wq->cpu_wq.single +
+			(cpu - WORK_CPU_UNBOUND) * UNBOUND_CWQ_STRIDE;
 	return NULL;
 }
 
+/**
+ * wq_unbound_cpu - pick the unbound gcwq for a work item
+ * @wq: the unbound workqueue the work item is queued on
+ * @cpu: the cpu the work item is queued from, or WORK_CPU_UNBOUND
+ *
+ * Work items go to the gcwq of the NUMA node of @cpu (or of the local
+ * cpu if @cpu isn't a valid cpu number), so that they are executed
+ * close to where they were issued.  Ordered workqueues need all their
+ * work items to go through a single cwq and always use the global
+ * unbound gcwq.
+ */
+static unsigned int wq_unbound_cpu(struct workqueue_struct *wq,
+				   unsigned int cpu)
+{
+	if (wq_nr_unbound == 1 || (wq->flags & __WQ_ORDERED))
+		return WORK_CPU_UNBOUND;
+
+	if (cpu >= nr_cpu_ids)
+		cpu = raw_smp_processor_id();
+	return WORK_CPU_UNBOUND + 1 + cpu_to_node(cpu);
+}
+
 static unsigned int work_color_to_flags(int color)
 {
 	return color << WORK_STRUCT_COLOR_SHIFT;
@@ -595,7 +670,8 @@ static struct global_cwq *get_work_gcwq(struct work_struct *work)
 	if (cpu == WORK_CPU_NONE)
 		return NULL;
 
-	BUG_ON(cpu >= nr_cpu_ids && cpu != WORK_CPU_UNBOUND);
+	BUG_ON(cpu >= nr_cpu_ids && (cpu < WORK_CPU_UNBOUND ||
+				     cpu >= WORK_CPU_UNBOUND + wq_nr_unbound));
 	return get_gcwq(cpu);
 }
 
@@ -978,7 +1054,7 @@ static bool is_chained_work(struct workqueue_struct *wq)
 static void __queue_work(unsigned int cpu, struct workqueue_struct *wq,
 			 struct work_struct *work)
 {
-	struct global_cwq *gcwq;
+	struct global_cwq *gcwq, *last_gcwq;
 	struct cpu_workqueue_struct *cwq;
 	struct list_head *worklist;
 	unsigned int work_flags;
@@ -993,39 +1069,36 @@ static void __queue_work(unsigned int cpu, struct workqueue_struct *wq,
 
 	/* determine gcwq to use */
 	if (!(wq->flags & WQ_UNBOUND)) {
-		struct global_cwq *last_gcwq;
-
 		if (unlikely(cpu == WORK_CPU_UNBOUND))
 			cpu = raw_smp_processor_id();
-
-		/*
-		 * It's multi cpu.  If @wq is non-reentrant and @work
-		 * was previously on a different cpu, it might still
-		 * be running there, in which case the work needs to
-		 * be queued on that cpu to guarantee non-reentrance.
-		 */
 		gcwq = get_gcwq(cpu);
-		if (wq->flags & WQ_NON_REENTRANT &&
-		    (last_gcwq = get_work_gcwq(work)) && last_gcwq != gcwq) {
-			struct worker *worker;
+	} else
+		gcwq = get_gcwq(wq_unbound_cpu(wq, cpu));
+
+	/*
+	 * It's multi gcwq.  If @wq is non-reentrant and @work was
+	 * previously on a different gcwq, it might still be running
+	 * there, in which case the work needs to be queued on that gcwq
+	 * to guarantee non-reentrance.  Unbound workqueues are always
+	 * non-reentrant even though they're spread over per-node gcwqs.
+	 */
+	if (wq->flags & (WQ_NON_REENTRANT | WQ_UNBOUND) &&
+	    (last_gcwq = get_work_gcwq(work)) && last_gcwq != gcwq) {
+		struct worker *worker;
 
-			spin_lock_irqsave(&last_gcwq->lock, flags);
+		spin_lock_irqsave(&last_gcwq->lock, flags);
 
-			worker = find_worker_executing_work(last_gcwq, work);
+		worker = find_worker_executing_work(last_gcwq, work);
 
-			if (worker && worker->current_cwq->wq == wq)
-				gcwq = last_gcwq;
-			else {
-				/* meh... not running there, queue here */
-				spin_unlock_irqrestore(&last_gcwq->lock, flags);
-				spin_lock_irqsave(&gcwq->lock, flags);
-			}
-		} else
+		if (worker && worker->current_cwq->wq == wq)
+			gcwq = last_gcwq;
+		else {
+			/* meh... not running there, queue here */
+			spin_unlock_irqrestore(&last_gcwq->lock, flags);
 			spin_lock_irqsave(&gcwq->lock, flags);
-	} else {
-		gcwq = get_gcwq(WORK_CPU_UNBOUND);
+		}
+	} else
 		spin_lock_irqsave(&gcwq->lock, flags);
-	}
 
 	/* gcwq determined, get cwq and queue */
 	cwq = get_cwq(gcwq->cpu, wq);
@@ -1156,7 +1229,7 @@ int queue_delayed_work_on(int cpu, struct workqueue_struct *wq,
 		if (!(wq->flags & WQ_UNBOUND)) {
 			struct global_cwq *gcwq = get_work_gcwq(work);
 
-			if (gcwq && gcwq->cpu != WORK_CPU_UNBOUND)
+			if (gcwq && gcwq->cpu < WORK_CPU_UNBOUND)
 				lcpu = gcwq->cpu;
 			else
 				lcpu = raw_smp_processor_id();
@@ -1542,10 +1615,15 @@ static struct worker *create_worker(struct worker_pool *pool)
 	worker->pool = pool;
 	worker->id = id;
 
-	if (gcwq->cpu != WORK_CPU_UNBOUND)
+	if (gcwq->cpu < WORK_CPU_UNBOUND)
 		worker->task = kthread_create_on_node(worker_thread,
 					worker, cpu_to_node(gcwq->cpu),
 					"kworker/%u:%d%s", gcwq->cpu, id, pri);
+	else if (gcwq_node(gcwq) != NUMA_NO_NODE)
+		worker->task = kthread_create_on_node(worker_thread,
+					worker, gcwq_node(gcwq),
+					"kworker/u%d:%d%s", gcwq_node(gcwq),
+					id, pri);
 	else
 		worker->task = kthread_create(worker_thread, worker,
 					      "kworker/u:%d%s", id, pri);
@@ -1555,6 +1633,20 @@ static struct worker *create_worker(struct worker_pool *pool)
 	if (worker_pool_pri(pool))
 		set_user_nice(worker->task, HIGHPRI_NICE_LEVEL);
 
+	/*
+	 * Unbound workers start out with the gcwq attributes.  This has
+	 * to happen before %PF_THREAD_BOUND is set below, later changes
+	 * are applied by the workers themselves.
+	 */
+	if (gcwq->cpu >= WORK_CPU_UNBOUND) {
+		mutex_lock(&wq_attrs_mutex);
+		if (!worker_pool_pri(pool))
+			set_user_nice(worker->task, gcwq->nice);
+		set_cpus_allowed_ptr(worker->task, gcwq->cpumask);
+		worker->attrs_seq = gcwq->attrs_seq;
+		mutex_unlock(&wq_attrs_mutex);
+	}
+
 	/*
 	 * Determine CPU binding of the new worker depending on
 	 * %GCWQ_DISASSOCIATED.  The caller is responsible for ensuring the
@@ -1673,8 +1765,8 @@ static bool send_mayday(struct work_struct *work)
 
 	/* mayday mayday mayday */
 	cpu = cwq->pool->gcwq->cpu;
-	/* WORK_CPU_UNBOUND can't be set in cpumask, use cpu 0 instead */
-	if (cpu == WORK_CPU_UNBOUND)
+	/* unbound gcwqs can't be set in cpumask, use cpu 0 instead */
+	if (cpu >= WORK_CPU_UNBOUND)
 		cpu = 0;
 	if (!mayday_test_and_set_cpu(cpu, wq->mayday_mask))
 		wake_up_process(wq->rescuer->task);
@@ -2130,6 +2222,72 @@ static void process_scheduled_works(struct worker *worker)
 	}
 }
 
+/* default cpumask of an unbound gcwq: its node's cpus, or all of them */
+static void gcwq_dfl_cpumask(struct global_cwq *gcwq, struct cpumask *mask)
+{
+	int node = gcwq_node(gcwq);
+
+	cpumask_copy(mask, cpu_possible_mask);
+	if (node != NUMA_NO_NODE) {
+		cpumask_and(mask, mask, cpumask_of_node(node));
+		if (cpumask_empty(mask))
+			cpumask_copy(mask, cpu_possible_mask);
+	}
+}
+
+/**
+ * gcwq_set_attrs - change the attributes of an unbound gcwq
+ * @gcwq: the unbound gcwq of interest
+ * @nice: new nice level of the normal priority workers
+ * @cpumask: new set of cpus the workers may run on
+ *
+ * Install the new attributes and start a new attribute generation.
+ * Idle workers are kicked so that they pick it up right away, busy
+ * ones catch up on their next wake up.
+ *
+ * CONTEXT:
+ * mutex_lock(wq_attrs_mutex).  Grabs and releases gcwq->lock.
+ */
+static void gcwq_set_attrs(struct global_cwq *gcwq, int nice,
+			   const struct cpumask *cpumask)
+{
+	struct worker_pool *pool;
+	struct worker *worker;
+
+	lockdep_assert_held(&wq_attrs_mutex);
+
+	spin_lock_irq(&gcwq->lock);
+
+	gcwq->nice = nice;
+	if (cpumask != gcwq->cpumask)
+		cpumask_copy(gcwq->cpumask, cpumask);
+	gcwq->attrs_seq++;
+
+	for_each_worker_pool(pool, gcwq)
+		list_for_each_entry(worker, &pool->idle_list, entry)
+			wake_up_process(worker->task);
+
+	spin_unlock_irq(&gcwq->lock);
+}
+
+/*
+ * Apply the current attributes of an unbound gcwq to @worker, which
+ * must be %current.  %PF_THREAD_BOUND only lets a task change its own
+ * affinity, so workers do this themselves when they notice a new
+ * attribute generation on wake up.
+ */
+static void worker_apply_attrs(struct worker *worker)
+{
+	struct global_cwq *gcwq = worker->pool->gcwq;
+
+	mutex_lock(&wq_attrs_mutex);
+	if (!worker_pool_pri(worker->pool))
+		set_user_nice(current, gcwq->nice);
+	set_cpus_allowed_ptr(current, gcwq->cpumask);
+	worker->attrs_seq = gcwq->attrs_seq;
+	mutex_unlock(&wq_attrs_mutex);
+}
+
 /**
  * worker_thread - the worker thread function
  * @__worker: self
@@ -2167,6 +2325,13 @@ woke_up:
 		goto woke_up;
 	}
 
+	/* unbound gcwq attributes changed while we were asleep? */
+	if (unlikely(worker->attrs_seq != gcwq->attrs_seq)) {
+		spin_unlock_irq(&gcwq->lock);
+		worker_apply_attrs(worker);
+		goto woke_up;
+	}
+
 	worker_leave_idle(worker);
 recheck:
 	/* no more worker necessary? */
@@ -2226,6 +2391,41 @@ sleep:
 	goto woke_up;
 }
 
+/* process the works of @cwq on its pool on behalf of @rescuer */
+static void rescue_cwq(struct worker *rescuer,
+		       struct cpu_workqueue_struct *cwq)
+{
+	struct list_head *scheduled = &rescuer->scheduled;
+	struct worker_pool *pool = cwq->pool;
+	struct global_cwq *gcwq = pool->gcwq;
+	struct work_struct *work, *n;
+
+	/* migrate to the target cpu if possible */
+	rescuer->pool = pool;
+	worker_maybe_bind_and_lock(rescuer);
+
+	/*
+	 * Slurp in all works issued via this workqueue and
+	 * process'em.
+	 */
+	BUG_ON(!list_empty(&rescuer->scheduled));
+	list_for_each_entry_safe(work, n, &pool->worklist, entry)
+		if (get_work_cwq(work) == cwq)
+			move_linked_works(work, scheduled, &n);
+
+	process_scheduled_works(rescuer);
+
+	/*
+	 * Leave this gcwq.  If keep_working() is %true, notify a
+	 * regular worker; otherwise, we end up with 0 concurrency
+	 * and stalling the execution.
+	 */
+	if (keep_working(pool))
+		wake_up_worker(pool);
+
+	spin_unlock_irq(&gcwq->lock);
+}
+
 /**
  * rescuer_thread - the rescuer thread function
  * @__wq: the associated workqueue
@@ -2249,7 +2449,6 @@ static int rescuer_thread(void *__wq)
 {
 	struct workqueue_struct *wq = __wq;
 	struct worker *rescuer = wq->rescuer;
-	struct list_head *scheduled = &rescuer->scheduled;
 	bool is_unbound = wq->flags & WQ_UNBOUND;
 	unsigned int cpu;
 
@@ -2262,42 +2461,20 @@ repeat:
 
 	/*
 	 * See whether any cpu is asking for help.  Unbounded
-	 * workqueues use cpu 0 in mayday_mask for CPU_UNBOUND.
+	 * workqueues use cpu 0 in mayday_mask for all unbound gcwqs
+	 * and have every one of them rescued.
 	 */
 	for_each_mayday_cpu(cpu, wq->mayday_mask) {
-		unsigned int tcpu = is_unbound ? WORK_CPU_UNBOUND : cpu;
-		struct cpu_workqueue_struct *cwq = get_cwq(tcpu, wq);
-		struct worker_pool *pool = cwq->pool;
-		struct global_cwq *gcwq = pool->gcwq;
-		struct work_struct *work, *n;
+		unsigned int tcpu;
 
 		__set_current_state(TASK_RUNNING);
 		mayday_clear_cpu(cpu, wq->mayday_mask);
 
-		/* migrate to the target cpu if possible */
-		rescuer->pool = pool;
-		worker_maybe_bind_and_lock(rescuer);
-
-		/*
-		 * Slurp in all works issued via this workqueue and
-		 * process'em.
-		 */
-		BUG_ON(!list_empty(&rescuer->scheduled));
-		list_for_each_entry_safe(work, n, &pool->worklist, entry)
-			if (get_work_cwq(work) == cwq)
-				move_linked_works(work, scheduled, &n);
-
-		process_scheduled_works(rescuer);
-
-		/*
-		 * Leave this gcwq.  If keep_working() is %true, notify a
-		 * regular worker; otherwise, we end up with 0 concurrency
-		 * and stalling the execution.
-		 */
-		if (keep_working(pool))
-			wake_up_worker(pool);
-
-		spin_unlock_irq(&gcwq->lock);
+		if (!is_unbound)
+			rescue_cwq(rescuer, get_cwq(cpu, wq));
+		else
+			for_each_cwq_cpu(tcpu, wq)
+				rescue_cwq(rescuer, get_cwq(tcpu, wq));
 	}
 
 	schedule();
@@ -3114,29 +3291,25 @@ int keventd_up(void)
 
 static int alloc_cwqs(struct workqueue_struct *wq)
 {
-	/*
-	 * cwqs are forced aligned according to WORK_STRUCT_FLAG_BITS.
-	 * Make sure that the alignment isn't lower than that of
-	 * unsigned long long.
-	 */
 	const size_t size = sizeof(struct cpu_workqueue_struct);
-	const size_t align = max_t(size_t, 1 << WORK_STRUCT_FLAG_BITS,
-				   __alignof__(unsigned long long));
+	const size_t align = CWQ_ALIGN;
 
 	if (!(wq->flags & WQ_UNBOUND))
 		wq->cpu_wq.pcpu = __alloc_percpu(size, align);
 	else {
+		const size_t cwqs_size = wq_nr_unbound * UNBOUND_CWQ_STRIDE;
 		void *ptr;
 
 		/*
-		 * Allocate enough room to align cwq and put an extra
-		 * pointer at the end pointing back to the originally
-		 * allocated pointer which will be used for free.
+		 * Allocate enough room to align the cwqs, one for each
+		 * unbound gcwq, and put an extra pointer at the end
+		 * pointing back to the originally allocated pointer
+		 * which will be used for free.
 		 */
-		ptr = kzalloc(size + align + sizeof(void *), GFP_KERNEL);
+		ptr = kzalloc(cwqs_size + align + sizeof(void *), GFP_KERNEL);
 		if (ptr) {
 			wq->cpu_wq.single = PTR_ALIGN(ptr, align);
-			*(void **)(wq->cpu_wq.single + 1) = ptr;
+			*(void **)((void *)wq->cpu_wq.single + cwqs_size) = ptr;
 		}
 	}
 
@@ -3150,8 +3323,9 @@ static void free_cwqs(struct workqueue_struct *wq)
 	if (!(wq->flags & WQ_UNBOUND))
 		free_percpu(wq->cpu_wq.pcpu);
 	else if (wq->cpu_wq.single) {
-		/* the pointer to free is stored right after the cwq */
-		kfree(*(void **)(wq->cpu_wq.single + 1));
+		/* the pointer to free is stored right after the cwqs */
+		kfree(*(void **)((void *)wq->cpu_wq.single +
+				 wq_nr_unbound * UNBOUND_CWQ_STRIDE));
 	}
 }
 
@@ -3199,6 +3373,14 @@ struct workqueue_struct *__alloc_workqueue_key(const char *fmt,
 	if (flags & WQ_MEM_RECLAIM)
 		flags |= WQ_RESCUER;
 
+	/*
+	 * Unbound workqueues with @max_active of one are expected to
+	 * execute their works in queueing order, which can't be honored
+	 * across the per-node gcwqs.  Keep them on the global one.
+	 */
+	if ((flags & WQ_UNBOUND) && max_active == 1)
+		flags |= __WQ_ORDERED;
+
 	max_active = max_active ?: WQ_DFL_ACTIVE;
 	max_active = wq_clamp_max_active(max_active, flags, wq->name);
 
@@ -3359,7 +3541,8 @@ EXPORT_SYMBOL_GPL(workqueue_set_max_active);
  * @cpu: CPU in question
  * @wq: target workqueue
  *
- * Test whether @wq's cpu workqueue for @cpu is congested.  There is
+ * Test whether @wq's cpu workqueue for @cpu is congested.  For an
+ * unbound @wq, the cwq of @cpu's NUMA node is tested.  There is
  * no synchronization around this function and the test result is
  * unreliable and only useful as advisory hints or for debugging.
  *
@@ -3368,7 +3551,11 @@ EXPORT_SYMBOL_GPL(workqueue_set_max_active);
  */
 bool workqueue_congested(unsigned int cpu, struct workqueue_struct *wq)
 {
-	struct cpu_workqueue_struct *cwq = get_cwq(cpu, wq);
+	struct cpu_workqueue_struct *cwq;
+
+	if (wq->flags & WQ_UNBOUND)
+		cpu = wq_unbound_cpu(wq, cpu);
+	cwq = get_cwq(cpu, wq);
 
 	return !list_empty(&cwq->delayed_works);
 }
@@ -3510,6 +3697,32 @@ static void gcwq_unbind_fn(struct work_struct *work)
 		atomic_set(get_pool_nr_running(pool), 0);
 }
 
+/* scratch mask for wq_node_cpu_online(), protected by wq_attrs_mutex */
+static cpumask_var_t wq_online_cpumask;
+
+/*
+ * Node cpumasks fill up as CPUs come online, most of them after
+ * init_workqueues().  Let the gcwq of @cpu's node follow unless its
+ * cpumask has been set from userland.
+ */
+static void wq_node_cpu_online(unsigned int cpu)
+{
+	struct global_cwq *gcwq;
+
+	if (wq_nr_unbound == 1)
+		return;
+
+	gcwq = get_gcwq(WORK_CPU_UNBOUND + 1 + cpu_to_node(cpu));
+
+	mutex_lock(&wq_attrs_mutex);
+	if (!gcwq->custom_cpumask) {
+		gcwq_dfl_cpumask(gcwq, wq_online_cpumask);
+		if (!cpumask_equal(wq_online_cpumask, gcwq->cpumask))
+			gcwq_set_attrs(gcwq, gcwq->nice, wq_online_cpumask);
+	}
+	mutex_unlock(&wq_attrs_mutex);
+}
+
 /*
  * Workqueues should be brought up before normal priority CPU notifiers.
  * This will be registered high priority CPU notifier.
@@ -3546,6 +3759,7 @@ static int __devinit workqueue_cpu_up_callback(struct notifier_block *nfb,
 		gcwq->flags &= ~GCWQ_DISASSOCIATED;
 		rebind_workers(gcwq);
 		gcwq_release_management_and_unlock(gcwq);
+		wq_node_cpu_online(cpu);
 		break;
 	}
 	return NOTIFY_OK;
@@ -3762,6 +3976,20 @@ static int __init init_workqueues(void)
 	cpu_notifier(workqueue_cpu_up_callback, CPU_PRI_WORKQUEUE_UP);
 	cpu_notifier(workqueue_cpu_down_callback, CPU_PRI_WORKQUEUE_DOWN);
 
+	/* on NUMA, unbound works are served by per-node gcwqs */
+	if (nr_node_ids > 1) {
+		int node;
+
+		for (node = 0; node < nr_node_ids; node++) {
+			unbound_gcwqs[1 + node] = kzalloc_node(
+					sizeof(struct global_cwq), GFP_KERNEL,
+					node_online(node) ? node : NUMA_NO_NODE);
+			BUG_ON(!unbound_gcwqs[1 + node]);
+		}
+		wq_nr_unbound = 1 + nr_node_ids;
+	}
+	BUG_ON(!alloc_cpumask_var(&wq_online_cpumask, GFP_KERNEL));
+
 	/* initialize gcwqs */
 	for_each_gcwq_cpu(cpu) {
 		struct global_cwq *gcwq = get_gcwq(cpu);
@@ -3791,6 +4019,11 @@ static int __init init_workqueues(void)
 		}
 
 		init_waitqueue_head(&gcwq->rebind_hold);
+
+		if (cpu >= WORK_CPU_UNBOUND) {
+			BUG_ON(!alloc_cpumask_var(&gcwq->cpumask, GFP_KERNEL));
+			gcwq_dfl_cpumask(gcwq, gcwq->cpumask);
+		}
 	}
 
 	/* create the initial worker */
@@ -3798,7 +4031,7 @@ static int __init init_workqueues(void)
 		struct global_cwq *gcwq = get_gcwq(cpu);
 		struct worker_pool *pool;
 
-		if (cpu != WORK_CPU_UNBOUND)
+		if (cpu < WORK_CPU_UNBOUND)
 			gcwq->flags &= ~GCWQ_DISASSOCIATED;
 
 		for_each_worker_pool(pool, gcwq) {
@@ -3827,3 +4060,153 @@ static int __init init_workqueues(void)
 	return 0;
 }
 early_initcall(init_workqueues);
+
+#ifdef CONFIG_SYSFS
+/*
+ * The attributes of unbound gcwqs are exposed under
+ * /sys/devices/system/workqueue/, "unbound" being the global gcwq used
+ * by ordered workqueues and "nodeN" the gcwqs of the NUMA nodes.
+ *
+ *  nice	RW	nice level of the normal priority workers
+ *  cpumask	RW	cpus the workers are allowed to run on
+ */
+struct wq_device {
+	struct global_cwq	*gcwq;
+	struct device		dev;
+};
+
+static struct global_cwq *dev_to_gcwq(struct device *dev)
+{
+	return container_of(dev, struct wq_device, dev)->gcwq;
+}
+
+static ssize_t wq_nice_show(struct device *dev,
+			    struct device_attribute *attr, char *buf)
+{
+	struct global_cwq *gcwq = dev_to_gcwq(dev);
+	int nice;
+
+	mutex_lock(&wq_attrs_mutex);
+	nice = gcwq->nice;
+	mutex_unlock(&wq_attrs_mutex);
+
+	return sprintf(buf, "%d\n", nice);
+}
+
+static ssize_t wq_nice_store(struct device *dev,
+			     struct device_attribute *attr,
+			     const char *buf, size_t count)
+{
+	struct global_cwq *gcwq = dev_to_gcwq(dev);
+	int nice, ret;
+
+	ret = kstrtoint(buf, 0, &nice);
+	if (ret)
+		return ret;
+	if (nice < -20 || nice > 19)
+		return -EINVAL;
+
+	mutex_lock(&wq_attrs_mutex);
+	gcwq_set_attrs(gcwq, nice, gcwq->cpumask);
+	mutex_unlock(&wq_attrs_mutex);
+
+	return count;
+}
+
+static ssize_t wq_cpumask_show(struct device *dev,
+			       struct device_attribute *attr, char *buf)
+{
+	struct global_cwq *gcwq = dev_to_gcwq(dev);
+	int written;
+
+	mutex_lock(&wq_attrs_mutex);
+	written = cpumask_scnprintf(buf, PAGE_SIZE, gcwq->cpumask);
+	mutex_unlock(&wq_attrs_mutex);
+
+	written += scnprintf(buf + written, PAGE_SIZE - written, "\n");
+	return written;
+}
+
+static ssize_t wq_cpumask_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct global_cwq *gcwq = dev_to_gcwq(dev);
+	cpumask_var_t cpumask;
+	int ret;
+
+	if (!alloc_cpumask_var(&cpumask, GFP_KERNEL))
+		return -ENOMEM;
+
+	ret = bitmap_parse(buf, count, cpumask_bits(cpumask),
+			   nr_cpumask_bits);
+	if (!ret) {
+		cpumask_and(cpumask, cpumask, cpu_possible_mask);
+		if (cpumask_empty(cpumask))
+			ret = -EINVAL;
+	}
+
+	if (!ret) {
+		mutex_lock(&wq_attrs_mutex);
+		gcwq->custom_cpumask = true;
+		gcwq_set_attrs(gcwq, gcwq->nice, cpumask);
+		mutex_unlock(&wq_attrs_mutex);
+	}
+
+	free_cpumask_var(cpumask);
+	return ret ?: count;
+}
+
+static struct device_attribute wq_dev_attrs[] = {
+	__ATTR(nice, 0644, wq_nice_show, wq_nice_store),
+	__ATTR(cpumask, 0644, wq_cpumask_show, wq_cpumask_store),
+	__ATTR_NULL,
+};
+
+static struct bus_type wq_subsys = {
+	.name		= "workqueue",
+	.dev_name	= "workqueue",
+	.dev_attrs	= wq_dev_attrs,
+};
+
+static void wq_device_release(struct device *dev)
+{
+	kfree(container_of(dev, struct wq_device, dev));
+}
+
+static int __init wq_sysfs_init(void)
+{
+	unsigned int cpu;
+	int ret;
+
+	ret = subsys_system_register(&wq_subsys, NULL);
+	if (ret)
+		return ret;
+
+	for (cpu = WORK_CPU_UNBOUND; cpu < WORK_CPU_UNBOUND + wq_nr_unbound;
+	     cpu++) {
+		struct global_cwq *gcwq = get_gcwq(cpu);
+		struct wq_device *wq_dev;
+
+		wq_dev = kzalloc(sizeof(*wq_dev), GFP_KERNEL);
+		if (!wq_dev)
+			return -ENOMEM;
+
+		wq_dev->gcwq = gcwq;
+		wq_dev->dev.bus = &wq_subsys;
+		wq_dev->dev.release = wq_device_release;
+		if (gcwq_node(gcwq) == NUMA_NO_NODE)
+			dev_set_name(&wq_dev->dev, "unbound");
+		else
+			dev_set_name(&wq_dev->dev, "node%d", gcwq_node(gcwq));
+
+		ret = device_register(&wq_dev->dev);
+		if (ret) {
+			put_device(&wq_dev->dev);
+			return ret;
+		}
+	}
+	return 0;
+}
+core_initcall(wq_sysfs_init);
+#endif /* CONFIG_SYSFS */
@@ -36,9 +36,44 @@
 /* How many pages do we try to swap or page in/out together? */
 int page_cluster;
 
-static DEFINE_PER_CPU(struct pagevec[NR_LRU_LISTS], lru_add_pvecs);
-static DEFINE_PER_CPU(struct pagevec, lru_rotate_pvecs);
-static DEFINE_PER_CPU(struct pagevec, lru_deactivate_pvecs);
+/*
+ * The per-cpu LRU caches live in percpu memory rather than on the stack,
+ * so they can hold many more pages than a pagevec.  How many of those
+ * slots are filled before the cache is flushed under zone->lru_lock adapts
+ * to contention on that lock: while the lock is uncontended it is taken
+ * every PAGEVEC_SIZE pages, so new pages become visible to reclaim quickly;
+ * each contended acquisition doubles the batch, up to LRU_PAGEVEC_SIZE.
+ */
+#define LRU_PAGEVEC_SIZE	63
+
+/* 63 pointers + two int's align the lru_pagevec structure to 512 bytes */
+struct lru_pagevec {
+	unsigned int nr;
+	unsigned int batch;
+	struct page *pages[LRU_PAGEVEC_SIZE];
+};
+
+static DEFINE_PER_CPU(struct lru_pagevec[NR_LRU_LISTS], lru_add_pvecs);
+static DEFINE_PER_CPU(struct lru_pagevec, lru_rotate_pvecs);
+static DEFINE_PER_CPU(struct lru_pagevec, lru_deactivate_pvecs);
+
+static inline unsigned lru_pvec_count(struct lru_pagevec *lpvec)
+{
+	return lpvec->nr;
+}
+
+/*
+ * Add a page to a per-cpu LRU cache.  Returns the number of slots still
+ * available in the current batch.
+ */
+static inline unsigned lru_pvec_add(struct lru_pagevec *lpvec,
+				    struct page *page)
+{
+	unsigned int batch = max_t(unsigned int, lpvec->batch, PAGEVEC_SIZE);
+
+	lpvec->pages[lpvec->nr++] = page;
+	return batch - lpvec->nr;
+}
 
 /*
  * This path almost never happens for VM activity - pages are normally
@@ -288,24 +323,35 @@ int get_kernel_page(unsigned long start, int write, struct page **pages)
 }
 EXPORT_SYMBOL_GPL(get_kernel_page);
 
-static void pagevec_lru_move_fn(struct pagevec *pvec,
-	void (*move_fn)(struct page *page, struct lruvec *lruvec, void *arg),
-	void *arg)
+typedef void (*lru_move_fn_t)(struct page *page, struct lruvec *lruvec,
+			      void *arg);
+
+/*
+ * Apply @move_fn to each page under its zone's lru_lock, then drop the
+ * references held on the pages.  Returns true if any of the lru_locks
+ * was found contended.
+ */
+static bool lru_move_pages(struct page **pages, int nr, int cold,
+			   lru_move_fn_t move_fn, void *arg)
 {
 	int i;
 	struct zone *zone = NULL;
 	struct lruvec *lruvec;
 	unsigned long flags = 0;
+	bool contended = false;
 
-	for (i = 0; i < pagevec_count(pvec); i++) {
-		struct page *page = pvec->pages[i];
+	for (i = 0; i < nr; i++) {
+		struct page *page = pages[i];
 		struct zone *pagezone = page_zone(page);
 
 		if (pagezone != zone) {
 			if (zone)
 				spin_unlock_irqrestore(&zone->lru_lock, flags);
 			zone = pagezone;
-			spin_lock_irqsave(&zone->lru_lock, flags);
+			if (!spin_trylock_irqsave(&zone->lru_lock, flags)) {
+				contended = true;
+				spin_lock_irqsave(&zone->lru_lock, flags);
+			}
 		}
 
 		lruvec = mem_cgroup_page_lruvec(page, zone);
@@ -313,10 +359,36 @@ static void pagevec_lru_move_fn(struct pagevec *pvec,
 	}
 	if (zone)
 		spin_unlock_irqrestore(&zone->lru_lock, flags);
-	release_pages(pvec->pages, pvec->nr, pvec->cold);
+	release_pages(pages, nr, cold);
+	return contended;
+}
+
+static void pagevec_lru_move_fn(struct pagevec *pvec,
+				lru_move_fn_t move_fn, void *arg)
+{
+	lru_move_pages(pvec->pages, pagevec_count(pvec), pvec->cold,
+		       move_fn, arg);
 	pagevec_reinit(pvec);
 }
 
+/*
+ * Flush a per-cpu LRU cache and resize its batch: grow it while the
+ * lru_lock is contended, shrink it back once it is not.
+ */
+static void lru_pvec_move_fn(struct lru_pagevec *lpvec,
+			     lru_move_fn_t move_fn, void *arg)
+{
+	unsigned int batch = max_t(unsigned int, lpvec->batch, PAGEVEC_SIZE);
+
+	if (lru_move_pages(lpvec->pages, lru_pvec_count(lpvec), 0,
+			   move_fn, arg))
+		batch = min_t(unsigned int, batch * 2, LRU_PAGEVEC_SIZE);
+	else
+		batch = max_t(unsigned int, batch / 2, PAGEVEC_SIZE);
+	lpvec->batch = batch;
+	lpvec->nr = 0;
+}
+
 static void pagevec_move_tail_fn(struct page *page, struct lruvec *lruvec,
 				 void *arg)
 {
@@ -333,11 +405,11 @@ static void pagevec_move_tail_fn(struct page *page, struct lruvec *lruvec,
  * pagevec_move_tail() must be called with IRQ disabled.
  * Otherwise this may cause nasty races.
  */
-static void pagevec_move_tail(struct pagevec *pvec)
+static void pagevec_move_tail(struct lru_pagevec *lpvec)
 {
 	int pgmoved = 0;
 
-	pagevec_lru_move_fn(pvec, pagevec_move_tail_fn, &pgmoved);
+	lru_pvec_move_fn(lpvec, pagevec_move_tail_fn, &pgmoved);
 	__count_vm_events(PGROTATED, pgmoved);
 }
 
@@ -350,14 +422,14 @@ void rotate_reclaimable_page(struct page *page)
 {
 	if (!PageLocked(page) && !PageDirty(page) && !PageActive(page) &&
 	    !PageUnevictable(page) && PageLRU(page)) {
-		struct pagevec *pvec;
+		struct lru_pagevec *lpvec;
 		unsigned long flags;
 
 		page_cache_get(page);
 		local_irq_save(flags);
-		pvec = &__get_cpu_var(lru_rotate_pvecs);
-		if (!pagevec_add(pvec, page))
-			pagevec_move_tail(pvec);
+		lpvec = &__get_cpu_var(lru_rotate_pvecs);
+		if (!lru_pvec_add(lpvec, page))
+			pagevec_move_tail(lpvec);
 		local_irq_restore(flags);
 	}
 }
@@ -390,24 +462,29 @@ static void __activate_page(struct page *page, struct lruvec *lruvec,
 }
 
 #ifdef CONFIG_SMP
-static DEFINE_PER_CPU(struct pagevec, activate_page_pvecs);
+static DEFINE_PER_CPU(struct lru_pagevec, activate_page_pvecs);
 
 static void activate_page_drain(int cpu)
 {
-	struct pagevec *pvec = &per_cpu(activate_page_pvecs, cpu);
+	struct lru_pagevec *lpvec = &per_cpu(activate_page_pvecs, cpu);
+
+	if (lru_pvec_count(lpvec))
+		lru_pvec_move_fn(lpvec, __activate_page, NULL);
+}
 
-	if (pagevec_count(pvec))
-		pagevec_lru_move_fn(pvec, __activate_page, NULL);
+static bool activate_page_pending(int cpu)
+{
+	return lru_pvec_count(&per_cpu(activate_page_pvecs, cpu)) != 0;
 }
 
 void activate_page(struct page *page)
 {
 	if (PageLRU(page) && !PageActive(page) && !PageUnevictable(page)) {
-		struct pagevec *pvec = &get_cpu_var(activate_page_pvecs);
+		struct lru_pagevec *lpvec = &get_cpu_var(activate_page_pvecs);
 
 		page_cache_get(page);
-		if (!pagevec_add(pvec, page))
-			pagevec_lru_move_fn(pvec, __activate_page, NULL);
+		if (!lru_pvec_add(lpvec, page))
+			lru_pvec_move_fn(lpvec, __activate_page, NULL);
 		put_cpu_var(activate_page_pvecs);
 	}
 }
@@ -417,6 +494,11 @@ static inline void activate_page_drain(int cpu)
 {
 }
 
+static inline bool activate_page_pending(int cpu)
+{
+	return false;
+}
+
 void activate_page(struct page *page)
 {
 	struct zone *zone = page_zone(page);
@@ -440,19 +522,46 @@ void mark_page_accessed(struct page *page)
 			PageReferenced(page) && PageLRU(page)) {
 		activate_page(page);
 		ClearPageReferenced(page);
+		if (page_is_file_cache(page))
+			workingset_activation(page);
 	} else if (!PageReferenced(page)) {
 		SetPageReferenced(page);
 	}
 }
 EXPORT_SYMBOL(mark_page_accessed);
 
+static void __pagevec_lru_add_fn(struct page *page, struct lruvec *lruvec,
+				 void *arg)
+{
+	enum lru_list lru = (enum lru_list)arg;
+	int file = is_file_lru(lru);
+	int active = is_active_lru(lru);
+
+	VM_BUG_ON(PageActive(page));
+	VM_BUG_ON(PageUnevictable(page));
+	VM_BUG_ON(PageLRU(page));
+
+	SetPageLRU(page);
+	if (active)
+		SetPageActive(page);
+	add_page_to_lru_list(page, lruvec, lru);
+	update_page_reclaim_stat(lruvec, file, active);
+}
+
+static void lru_pvec_add_drain(struct lru_pagevec *lpvec, enum lru_list lru)
+{
+	VM_BUG_ON(is_unevictable_lru(lru));
+
+	lru_pvec_move_fn(lpvec, __pagevec_lru_add_fn, (void *)lru);
+}
+
 void __lru_cache_add(struct page *page, enum lru_list lru)
 {
-	struct pagevec *pvec = &get_cpu_var(lru_add_pvecs)[lru];
+	struct lru_pagevec *lpvec = &get_cpu_var(lru_add_pvecs)[lru];
 
 	page_cache_get(page);
-	if (!pagevec_add(pvec, page))
-		__pagevec_lru_add(pvec, lru);
+	if (!lru_pvec_add(lpvec, page))
+		lru_pvec_add_drain(lpvec, lru);
 	put_cpu_var(lru_add_pvecs);
 }
 EXPORT_SYMBOL(__lru_cache_add);
@@ -573,33 +682,53 @@ static void lru_deactivate_fn(struct page *page, struct lruvec *lruvec,
  */
 void lru_add_drain_cpu(int cpu)
 {
-	struct pagevec *pvecs = per_cpu(lru_add_pvecs, cpu);
-	struct pagevec *pvec;
+	struct lru_pagevec *lpvecs = per_cpu(lru_add_pvecs, cpu);
+	struct lru_pagevec *lpvec;
 	int lru;
 
 	for_each_lru(lru) {
-		pvec = &pvecs[lru - LRU_BASE];
-		if (pagevec_count(pvec))
-			__pagevec_lru_add(pvec, lru);
+		lpvec = &lpvecs[lru - LRU_BASE];
+		if (lru_pvec_count(lpvec))
+			lru_pvec_add_drain(lpvec, lru);
 	}
 
-	pvec = &per_cpu(lru_rotate_pvecs, cpu);
-	if (pagevec_count(pvec)) {
+	lpvec = &per_cpu(lru_rotate_pvecs, cpu);
+	if (lru_pvec_count(lpvec)) {
 		unsigned long flags;
 
 		/* No harm done if a racing interrupt already did this */
 		local_irq_save(flags);
-		pagevec_move_tail(pvec);
+		pagevec_move_tail(lpvec);
 		local_irq_restore(flags);
 	}
 
-	pvec = &per_cpu(lru_deactivate_pvecs, cpu);
-	if (pagevec_count(pvec))
-		pagevec_lru_move_fn(pvec, lru_deactivate_fn, NULL);
+	lpvec = &per_cpu(lru_deactivate_pvecs, cpu);
+	if (lru_pvec_count(lpvec))
+		lru_pvec_move_fn(lpvec, lru_deactivate_fn, NULL);
 
 	activate_page_drain(cpu);
 }
 
+/*
+ * Peek at another cpu's LRU caches without any locking.  A racing
+ * addition may be missed, which is no worse than the page being added
+ * just after the drain.
+ */
+static bool lru_add_drain_pending(int cpu)
+{
+	struct lru_pagevec *lpvecs = per_cpu(lru_add_pvecs, cpu);
+	int lru;
+
+	for_each_lru(lru) {
+		if (lru_pvec_count(&lpvecs[lru - LRU_BASE]))
+			return true;
+	}
+
+	return lru_pvec_count(&per_cpu(lru_rotate_pvecs, cpu)) ||
+		lru_pvec_count(&per_cpu(lru_deactivate_pvecs, cpu)) ||
+		activate_page_pending(cpu);
+}
+
 /**
  * deactivate_page - forcefully deactivate a page
  * @page: page to deactivate
@@ -618,10 +747,10 @@ void deactivate_page(struct page *page)
 		return;
 
 	if (likely(get_page_unless_zero(page))) {
-		struct pagevec *pvec = &get_cpu_var(lru_deactivate_pvecs);
+		struct lru_pagevec *lpvec = &get_cpu_var(lru_deactivate_pvecs);
 
-		if (!pagevec_add(pvec, page))
-			pagevec_lru_move_fn(pvec, lru_deactivate_fn, NULL);
+		if (!lru_pvec_add(lpvec, page))
+			lru_pvec_move_fn(lpvec, lru_deactivate_fn, NULL);
 		put_cpu_var(lru_deactivate_pvecs);
 	}
 }
@@ -637,12 +766,40 @@ static void lru_add_drain_per_cpu(struct work_struct *dummy)
 	lru_add_drain();
 }
 
+static DEFINE_PER_CPU(struct work_struct, lru_add_drain_work);
+
 /*
+ * Only cpus which actually hold pages in their LRU caches are asked to
+ * drain them; on a large machine most of them usually hold none.
+ *
  * Returns 0 for success
  */
 int lru_add_drain_all(void)
 {
-	return schedule_on_each_cpu(lru_add_drain_per_cpu);
+	static DEFINE_MUTEX(lock);
+	static struct cpumask has_work;
+	int cpu;
+
+	mutex_lock(&lock);
+	get_online_cpus();
+	cpumask_clear(&has_work);
+
+	for_each_online_cpu(cpu) {
+		struct work_struct *work = &per_cpu(lru_add_drain_work, cpu);
+
+		if (lru_add_drain_pending(cpu)) {
+			INIT_WORK(work, lru_add_drain_per_cpu);
+			schedule_work_on(cpu, work);
+			cpumask_set_cpu(cpu, &has_work);
+		}
+	}
+
+	for_each_cpu(cpu, &has_work)
+		flush_work(&per_cpu(lru_add_drain_work, cpu));
+
+	put_online_cpus();
+	mutex_unlock(&lock);
+	return 0;
 }
 
 /*
@@ -777,24 +934,6 @@ void lru_add_page_tail(struct page *page, struct page *page_tail,
 }
 #endif /* CONFIG_TRANSPARENT_HUGEPAGE */
 
-static void __pagevec_lru_add_fn(struct page *page, struct lruvec *lruvec,
-				 void *arg)
-{
-	enum lru_list lru = (enum lru_list)arg;
-	int file = is_file_lru(lru);
-	int active = is_active_lru(lru);
-
-	VM_BUG_ON(PageActive(page));
-	VM_BUG_ON(PageUnevictable(page));
-	VM_BUG_ON(PageLRU(page));
-
-	SetPageLRU(page);
-	if (active)
-		SetPageActive(page);
-	add_page_to_lru_list(page, lruvec, lru);
-	update_page_reclaim_stat(lruvec, file, active);
-}
-
 /*
  * Add the passed pages to the LRU, then drop the caller's refcount
  * on them.  Reinitialises the caller's pagevec.
@@ -183,6 +183,60 @@ int invalidate_inode_page(struct page *page)
 	return invalidate_complete_page(mapping, page);
 }
 
+/**
+ * clear_shadow_entries - remove shadow entries from a page cache range
+ * @mapping: mapping to clean up
+ * @start: first page index
+ * @end: last page index, inclusive
+ *
+ * Removes the shadow entries that reclaim left behind for evicted pages
+ * (see mm/workingset.c) from the given range of @mapping.  Pages are not
+ * touched.  Must not be used on shmem/tmpfs mappings, whose exceptional
+ * entries are swap entries.
+ */
+void clear_shadow_entries(struct address_space *mapping,
+			  pgoff_t start, pgoff_t end)
+{
+	void **slots[PAGEVEC_SIZE];
+	pgoff_t indices[PAGEVEC_SIZE];
+	pgoff_t index = start;
+	unsigned int i, nr, nr_shadows;
+
+	while (index <= end && mapping->nrshadows) {
+		spin_lock_irq(&mapping->tree_lock);
+		nr = radix_tree_gang_lookup_slot(&mapping->page_tree, slots,
+						 indices, index, PAGEVEC_SIZE);
+		if (!nr) {
+			spin_unlock_irq(&mapping->tree_lock);
+			break;
+		}
+		/*
+		 * Collect the indices first: deleting entries can free
+		 * tree nodes and with them the slots looked up above.
+		 */
+		nr_shadows = 0;
+		for (i = 0; i < nr; i++) {
+			void *entry;
+
+			index = indices[i];
+			if (index > end)
+				break;
+			entry = radix_tree_deref_slot_protected(slots[i],
+						&mapping->tree_lock);
+			if (radix_tree_exceptional_entry(entry))
+				indices[nr_shadows++] = index;
+		}
+		for (i = 0; i < nr_shadows; i++)
+			radix_tree_delete(&mapping->page_tree, indices[i]);
+		if (nr_shadows)
+			workingset_shadows_removed(mapping, nr_shadows);
+		spin_unlock_irq(&mapping->tree_lock);
+		if (index > end || !++index)
+			break;
+		cond_resched();
+	}
+}
+
 /**
  * truncate_inode_pages_range - truncate range of pages specified by start & end byte offsets
  * @mapping: mapping to truncate
@@ -214,12 +268,15 @@ void truncate_inode_pages_range(struct address_space *mapping,
 	int i;
 
 	cleancache_invalidate_inode(mapping);
-	if (mapping->nrpages == 0)
-		return;
-
 	BUG_ON((lend & (PAGE_CACHE_SIZE - 1)) != (PAGE_CACHE_SIZE - 1));
 	end = (lend >> PAGE_CACHE_SHIFT);
 
+	if (mapping->nrpages == 0) {
+		if (mapping->nrshadows)
+			clear_shadow_entries(mapping, start, end);
+		return;
+	}
+
 	pagevec_init(&pvec, 0);
 	index = start;
 	while (index <= end && pagevec_lookup(&pvec, mapping, index,
@@ -292,6 +349,8 @@ void truncate_inode_pages_range(struct address_space *mapping,
 		mem_cgroup_uncharge_end();
 		index++;
 	}
+	if (mapping->nrshadows)
+		clear_shadow_entries(mapping, start, end);
 	cleancache_invalidate_inode(mapping);
 }
 EXPORT_SYMBOL(truncate_inode_pages_range);
@@ -400,7 +459,7 @@ invalidate_complete_page2(struct address_space *mapping, struct page *page)
 
 	clear_page_mlock(page);
 	BUG_ON(page_has_private(page));
-	__delete_from_page_cache(page);
+	__delete_from_page_cache(page, NULL);
 	spin_unlock_irq(&mapping->tree_lock);
 	mem_cgroup_uncharge_cache_page(page);
 
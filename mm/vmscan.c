@@ -92,6 +92,9 @@ struct scan_control {
 	 * are scanned.
 	 */
 	nodemask_t	*nodemask;
+
+	/* Which of the node's kswapd workers is reclaiming, 0 for kswapd */
+	int kswapd_worker;
 };
 
 #define lru_to_page(_head) (list_entry((_head)->prev, struct page, lru))
@@ -128,6 +131,7 @@ struct scan_control {
  * From 0 .. 100.  Higher means more swappy.
  */
 int vm_swappiness = 60;
+int kswapd_threads = 1;		/* Reclaim threads per node, kswapd included */
 long vm_total_pages;	/* The total number of pages which the VM controls */
 
 static LIST_HEAD(shrinker_list);
@@ -449,7 +453,8 @@ static pageout_t pageout(struct page *page, struct address_space *mapping,
  * Same as remove_mapping, but if the page is removed from the mapping, it
  * gets returned with a refcount of 0.
  */
-static int __remove_mapping(struct address_space *mapping, struct page *page)
+static int __remove_mapping(struct address_space *mapping, struct page *page,
+			    bool reclaimed)
 {
 	BUG_ON(!PageLocked(page));
 	BUG_ON(mapping != page_mapping(page));
@@ -495,10 +500,23 @@ static int __remove_mapping(struct address_space *mapping, struct page *page)
 		swapcache_free(swap, page);
 	} else {
 		void (*freepage)(struct page *);
+		void *shadow = NULL;
 
 		freepage = mapping->a_ops->freepage;
-
-		__delete_from_page_cache(page);
+		/*
+		 * Remember a shadow entry for reclaimed file cache in
+		 * order to detect refaults, thus thrashing, later on.
+		 *
+		 * Only do this for the inode's own page cache, not for
+		 * private caches that manage their radix tree by hand,
+		 * and not once the inode is being evicted: eviction has
+		 * to empty out the radix tree or its nodes are leaked.
+		 */
+		if (reclaimed && page_is_file_cache(page) &&
+		    mapping->host && mapping->host->i_mapping == mapping &&
+		    !mapping_exiting(mapping))
+			shadow = workingset_eviction(mapping, page);
+		__delete_from_page_cache(page, shadow);
 		spin_unlock_irq(&mapping->tree_lock);
 		mem_cgroup_uncharge_cache_page(page);
 
@@ -521,7 +539,7 @@ cannot_free:
  */
 int remove_mapping(struct address_space *mapping, struct page *page)
 {
-	if (__remove_mapping(mapping, page)) {
+	if (__remove_mapping(mapping, page, false)) {
 		/*
 		 * Unfreezing the refcount with 1 rather than 2 effectively
 		 * drops the pagecache ref for us without requiring another
@@ -899,7 +917,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			}
 		}
 
-		if (!mapping || !__remove_mapping(mapping, page))
+		if (!mapping || !__remove_mapping(mapping, page, true))
 			goto keep_locked;
 
 		/*
@@ -1268,9 +1286,11 @@ shrink_inactive_list(unsigned long nr_to_scan, struct lruvec *lruvec,
 
 	if (global_reclaim(sc)) {
 		zone->pages_scanned += nr_scanned;
-		if (current_is_kswapd())
+		if (current_is_kswapd()) {
 			__count_zone_vm_events(PGSCAN_KSWAPD, zone, nr_scanned);
-		else
+			__count_vm_events(PGSCAN_KSWAPD_WORKER_0 +
+					  sc->kswapd_worker, nr_scanned);
+		} else
 			__count_zone_vm_events(PGSCAN_DIRECT, zone, nr_scanned);
 	}
 	spin_unlock_irq(&zone->lru_lock);
@@ -1286,10 +1306,12 @@ shrink_inactive_list(unsigned long nr_to_scan, struct lruvec *lruvec,
 	reclaim_stat->recent_scanned[file] += nr_taken;
 
 	if (global_reclaim(sc)) {
-		if (current_is_kswapd())
+		if (current_is_kswapd()) {
 			__count_zone_vm_events(PGSTEAL_KSWAPD, zone,
 					       nr_reclaimed);
-		else
+			__count_vm_events(PGSTEAL_KSWAPD_WORKER_0 +
+					  sc->kswapd_worker, nr_reclaimed);
+		} else
 			__count_zone_vm_events(PGSTEAL_DIRECT, zone,
 					       nr_reclaimed);
 	}
@@ -2462,6 +2484,93 @@ static bool prepare_kswapd_sleep(pg_data_t *pgdat, int order, long remaining,
 		return all_zones_ok;
 }
 
+/*
+ * Kswapd reclaims only single pages with compaction enabled. Trying too
+ * hard to reclaim until contiguous free pages have become available can
+ * hurt performance by evicting too much useful data from memory.
+ * Do not reclaim more than needed for compaction.
+ */
+static int kswapd_testorder(struct zone *zone, int order)
+{
+	if (COMPACTION_BUILD && order &&
+	    compaction_suitable(zone, order) != COMPACT_SKIPPED)
+		return 0;
+	return order;
+}
+
+/*
+ * Whether zone @i needs reclaim in a balance_pgdat() pass up to @end_zone.
+ * We put equal pressure on every zone, unless one zone has way too many
+ * pages free already. The "too many pages" is defined as the high wmark
+ * plus a "gap" where the gap is either the low watermark or 1% of the
+ * zone, whichever is smaller.
+ */
+static bool kswapd_zone_unbalanced(struct zone *zone, int i, int testorder,
+				   int end_zone)
+{
+	unsigned long balance_gap;
+
+	balance_gap = min(low_wmark_pages(zone),
+		(zone->present_pages + KSWAPD_ZONE_BALANCE_GAP_RATIO-1) /
+		KSWAPD_ZONE_BALANCE_GAP_RATIO);
+
+	return (buffer_heads_over_limit && is_highmem_idx(i)) ||
+		!zone_watermark_ok_safe(zone, testorder,
+				high_wmark_pages(zone) + balance_gap,
+				end_zone, 0);
+}
+
+/*
+ * Decide how many reclaim threads the node needs, kswapd included.  While
+ * free memory stays above the low watermark kswapd reclaims alone.  Below
+ * it, allocators are about to fall into direct reclaim, so workers are
+ * added in proportion to how far free memory has dropped towards the min
+ * watermark.  Once a zone is below min, processes are throttled on
+ * pfmemalloc_wait or kswapd itself is getting into trouble, every worker
+ * is brought in.
+ */
+static void kswapd_scale_workers(pg_data_t *pgdat, int order, int end_zone,
+				 int priority)
+{
+	int threads = ACCESS_ONCE(kswapd_threads);
+	int wanted = 1;
+	int i;
+
+	if (threads > 1 && (priority < DEF_PRIORITY - 2 ||
+			    waitqueue_active(&pgdat->pfmemalloc_wait)))
+		wanted = threads;
+
+	for (i = 0; i <= end_zone && wanted < threads; i++) {
+		struct zone *zone = pgdat->node_zones + i;
+		unsigned long free, low, min;
+
+		if (!populated_zone(zone) || zone->all_unreclaimable)
+			continue;
+
+		free = zone_page_state(zone, NR_FREE_PAGES);
+		low = low_wmark_pages(zone);
+		min = min_wmark_pages(zone);
+		if (free >= low)
+			continue;
+		if (free <= min) {
+			wanted = threads;
+			break;
+		}
+		wanted = max_t(int, wanted, 1 + DIV_ROUND_UP((threads - 1) *
+						(low - free), low - min));
+	}
+
+	/* Publish this pass; workers wait for a new one between passes */
+	pgdat->kswapd_order = order;
+	pgdat->kswapd_end_zone = end_zone;
+	pgdat->kswapd_priority = priority;
+	smp_wmb();
+	pgdat->kswapd_workers_active = wanted;
+	pgdat->kswapd_pass++;
+	if (wanted > 1)
+		wake_up_interruptible_all(&pgdat->kswapd_worker_wait);
+}
+
 /*
  * For kswapd, balance_pgdat() will work across all this node's zones until
  * they are all at high_wmark_pages(zone).
@@ -2584,7 +2693,6 @@ loop_again:
 		for (i = 0; i <= end_zone; i++) {
 			struct zone *zone = pgdat->node_zones + i;
 			int nr_slab, testorder;
-			unsigned long balance_gap;
 
 			if (!populated_zone(zone))
 				continue;
@@ -2605,35 +2713,10 @@ loop_again:
 			sc.nr_reclaimed += nr_soft_reclaimed;
 			total_scanned += nr_soft_scanned;
 
-			/*
-			 * We put equal pressure on every zone, unless
-			 * one zone has way too many pages free
-			 * already. The "too many pages" is defined
-			 * as the high wmark plus a "gap" where the
-			 * gap is either the low watermark or 1%
-			 * of the zone, whichever is smaller.
-			 */
-			balance_gap = min(low_wmark_pages(zone),
-				(zone->present_pages +
-					KSWAPD_ZONE_BALANCE_GAP_RATIO-1) /
-				KSWAPD_ZONE_BALANCE_GAP_RATIO);
-			/*
-			 * Kswapd reclaims only single pages with compaction
-			 * enabled. Trying too hard to reclaim until contiguous
-			 * free pages have become available can hurt performance
-			 * by evicting too much useful data from memory.
-			 * Do not reclaim more than needed for compaction.
-			 */
-			testorder = order;
-			if (COMPACTION_BUILD && order &&
-					compaction_suitable(zone, order) !=
-						COMPACT_SKIPPED)
-				testorder = 0;
-
-			if ((buffer_heads_over_limit && is_highmem_idx(i)) ||
-				    !zone_watermark_ok_safe(zone, testorder,
-					high_wmark_pages(zone) + balance_gap,
-					end_zone, 0)) {
+			testorder = kswapd_testorder(zone, order);
+
+			if (kswapd_zone_unbalanced(zone, i, testorder,
+						   end_zone)) {
 				shrink_zone(zone, &sc);
 
 				reclaim_state->reclaimed_slab = 0;
@@ -2697,6 +2780,8 @@ loop_again:
 
 		if (all_zones_ok || (order && pgdat_balanced(pgdat, balanced, *classzone_idx)))
 			break;		/* kswapd: all done */
+
+		kswapd_scale_workers(pgdat, order, end_zone, sc.priority);
 		/*
 		 * OK, kswapd is getting into trouble.  Take a nap, then take
 		 * another pass across the zones.
@@ -2795,6 +2880,9 @@ out:
 			compact_pgdat(pgdat, order);
 	}
 
+	/* The node is balanced, send the workers back to sleep */
+	pgdat->kswapd_workers_active = 0;
+
 	/*
 	 * Return the order we were reclaiming at so prepare_kswapd_sleep()
 	 * makes a decision on the order we were last reclaiming at. However,
@@ -2853,37 +2941,20 @@ static void kswapd_try_to_sleep(pg_data_t *pgdat, int order, int classzone_idx)
 }
 
 /*
- * The background pageout daemon, started as a kernel thread
- * from the init process.
- *
- * This basically trickles out pages so that we have _some_
- * free memory available even if there is no other activity
- * that frees anything up. This is needed for things like routing
- * etc, where we otherwise might have all activity going on in
- * asynchronous contexts that cannot page things out.
- *
- * If there are applications that are active memory-allocators
- * (most normal use), this basically shouldn't matter.
+ * Common setup for kswapd and its workers, binding them to the node's
+ * cpus and marking them as reclaimers.
  */
-static int kswapd(void *p)
+static void kswapd_init_task(pg_data_t *pgdat,
+			     struct reclaim_state *reclaim_state)
 {
-	unsigned long order, new_order;
-	unsigned balanced_order;
-	int classzone_idx, new_classzone_idx;
-	int balanced_classzone_idx;
-	pg_data_t *pgdat = (pg_data_t*)p;
 	struct task_struct *tsk = current;
-
-	struct reclaim_state reclaim_state = {
-		.reclaimed_slab = 0,
-	};
 	const struct cpumask *cpumask = cpumask_of_node(pgdat->node_id);
 
 	lockdep_set_current_reclaim_state(GFP_KERNEL);
 
 	if (!cpumask_empty(cpumask))
 		set_cpus_allowed_ptr(tsk, cpumask);
-	current->reclaim_state = &reclaim_state;
+	current->reclaim_state = reclaim_state;
 
 	/*
 	 * Tell the memory management that we're a "memory allocator",
@@ -2899,6 +2970,33 @@ static int kswapd(void *p)
 	 */
 	tsk->flags |= PF_MEMALLOC | PF_SWAPWRITE | PF_KSWAPD;
 	set_freezable();
+}
+
+/*
+ * The background pageout daemon, started as a kernel thread
+ * from the init process.
+ *
+ * This basically trickles out pages so that we have _some_
+ * free memory available even if there is no other activity
+ * that frees anything up. This is needed for things like routing
+ * etc, where we otherwise might have all activity going on in
+ * asynchronous contexts that cannot page things out.
+ *
+ * If there are applications that are active memory-allocators
+ * (most normal use), this basically shouldn't matter.
+ */
+static int kswapd(void *p)
+{
+	unsigned long order, new_order;
+	unsigned balanced_order;
+	int classzone_idx, new_classzone_idx;
+	int balanced_classzone_idx;
+	pg_data_t *pgdat = (pg_data_t*)p;
+	struct reclaim_state reclaim_state = {
+		.reclaimed_slab = 0,
+	};
+
+	kswapd_init_task(pgdat, &reclaim_state);
 
 	order = new_order = 0;
 	balanced_order = 0;
@@ -2956,6 +3054,107 @@ static int kswapd(void *p)
 	return 0;
 }
 
+static bool kswapd_worker_wanted(pg_data_t *pgdat, int worker)
+{
+	return worker < ACCESS_ONCE(pgdat->kswapd_workers_active) &&
+		!kthread_should_stop();
+}
+
+/*
+ * Reclaim alongside kswapd until the zones of kswapd's current pass meet
+ * kswapd's own balance criteria, or kswapd no longer wants this worker.
+ * Workers only shrink the LRU lists, at kswapd's current priority; since
+ * every isolation takes a different batch of pages off the lists, the
+ * threads naturally partition them.  Slab shrinking, compaction and
+ * congestion handling are left to kswapd.
+ *
+ * Returns the last kswapd pass that was served.
+ */
+static unsigned int kswapd_worker_balance(pg_data_t *pgdat, int worker)
+{
+	struct scan_control sc = {
+		.gfp_mask = GFP_KERNEL,
+		.may_writepage = !laptop_mode,
+		.may_unmap = 1,
+		.may_swap = 1,
+		.nr_to_reclaim = ULONG_MAX,
+		.target_mem_cgroup = NULL,
+		.kswapd_worker = worker,
+	};
+	unsigned int pass;
+
+	do {
+		unsigned long total_scanned = 0;
+		int end_zone, i;
+
+		pass = ACCESS_ONCE(pgdat->kswapd_pass);
+		smp_rmb();
+		sc.order = ACCESS_ONCE(pgdat->kswapd_order);
+		sc.priority = clamp(ACCESS_ONCE(pgdat->kswapd_priority),
+				    0, DEF_PRIORITY);
+		end_zone = min(ACCESS_ONCE(pgdat->kswapd_end_zone),
+			       pgdat->nr_zones - 1);
+
+		for (i = 0; i <= end_zone; i++) {
+			struct zone *zone = pgdat->node_zones + i;
+
+			if (!populated_zone(zone) || zone->all_unreclaimable)
+				continue;
+
+			if (!kswapd_zone_unbalanced(zone, i,
+					kswapd_testorder(zone, sc.order),
+					end_zone))
+				continue;
+
+			sc.nr_scanned = 0;
+			shrink_zone(zone, &sc);
+			total_scanned += sc.nr_scanned;
+		}
+
+		/* Balanced, or nothing left to scan at this priority */
+		if (!total_scanned)
+			break;
+
+		cond_resched();
+	} while (kswapd_worker_wanted(pgdat, worker));
+
+	return pass;
+}
+
+/*
+ * A kswapd worker sleeps until kswapd asks for help with a reclaim
+ * backlog it cannot handle alone, see kswapd_scale_workers().  Once it
+ * is done with a pass it waits for kswapd to start a new one.
+ */
+static int kswapd_worker(void *p)
+{
+	pg_data_t *pgdat = (pg_data_t*)p;
+	struct reclaim_state reclaim_state = {
+		.reclaimed_slab = 0,
+	};
+	unsigned int pass = ACCESS_ONCE(pgdat->kswapd_pass);
+	int worker;
+
+	for (worker = 1; worker < MAX_KSWAPD_WORKERS; worker++)
+		if (pgdat->kswapd_workers[worker] == current)
+			break;
+	BUG_ON(worker == MAX_KSWAPD_WORKERS);
+
+	kswapd_init_task(pgdat, &reclaim_state);
+
+	for ( ; ; ) {
+		wait_event_freezable(pgdat->kswapd_worker_wait,
+				     (kswapd_worker_wanted(pgdat, worker) &&
+				      ACCESS_ONCE(pgdat->kswapd_pass) != pass) ||
+				     kthread_should_stop());
+		if (kthread_should_stop())
+			break;
+
+		pass = kswapd_worker_balance(pgdat, worker);
+	}
+	return 0;
+}
+
 /*
  * A zone is low on free memory, so wake its kswapd task to service it.
  */
@@ -3077,14 +3276,52 @@ static int __devinit cpu_callback(struct notifier_block *nfb,
 
 			mask = cpumask_of_node(pgdat->node_id);
 
-			if (cpumask_any_and(cpu_online_mask, mask) < nr_cpu_ids)
+			if (cpumask_any_and(cpu_online_mask, mask) < nr_cpu_ids) {
+				int i;
+
 				/* One of our CPUs online: restore mask */
 				set_cpus_allowed_ptr(pgdat->kswapd, mask);
+				for (i = 1; i < MAX_KSWAPD_WORKERS; i++)
+					if (pgdat->kswapd_workers[i])
+						set_cpus_allowed_ptr(
+						pgdat->kswapd_workers[i], mask);
+			}
 		}
 	}
 	return NOTIFY_OK;
 }
 
+/*
+ * Start or stop workers so that a node running kswapd has kswapd_threads
+ * reclaim threads in total, and a node without kswapd has none.  Caller
+ * must hold lock_memory_hotplug().
+ */
+static void kswapd_update_workers(int nid)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+	int i;
+
+	for (i = 1; i < MAX_KSWAPD_WORKERS; i++) {
+		struct task_struct *tsk = pgdat->kswapd_workers[i];
+		bool want = pgdat->kswapd && i < kswapd_threads;
+
+		if (want && !tsk) {
+			tsk = kthread_create_on_node(kswapd_worker, pgdat, nid,
+						     "kswapd%d:%d", nid, i);
+			if (IS_ERR(tsk)) {
+				printk(KERN_WARNING "Failed to start kswapd "
+				       "worker %d on node %d\n", i, nid);
+				break;
+			}
+			pgdat->kswapd_workers[i] = tsk;
+			wake_up_process(tsk);
+		} else if (!want && tsk) {
+			kthread_stop(tsk);
+			pgdat->kswapd_workers[i] = NULL;
+		}
+	}
+}
+
 /*
  * This kswapd start function will be called by init and node-hot-add.
  * On node-hot-add, kswapd will moved to proper cpus if cpus are hot-added.
@@ -3104,7 +3341,8 @@ int kswapd_run(int nid)
 		printk("Failed to start kswapd on node %d\n",nid);
 		pgdat->kswapd = NULL;
 		ret = -1;
-	}
+	} else
+		kswapd_update_workers(nid);
 	return ret;
 }
 
@@ -3119,13 +3357,39 @@ void kswapd_stop(int nid)
 	if (kswapd) {
 		kthread_stop(kswapd);
 		NODE_DATA(nid)->kswapd = NULL;
+		NODE_DATA(nid)->kswapd_workers_active = 0;
+		kswapd_update_workers(nid);
 	}
 }
 
+/*
+ * kswapd_threads_sysctl_handler - just a wrapper around proc_dointvec_minmax()
+ * that starts or stops the kswapd workers of every node to match the new
+ * kswapd_threads value.
+ */
+int kswapd_threads_sysctl_handler(ctl_table *table, int write,
+	void __user *buffer, size_t *length, loff_t *ppos)
+{
+	int nid, ret;
+
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (ret || !write)
+		return ret;
+
+	lock_memory_hotplug();
+	for_each_node_state(nid, N_HIGH_MEMORY)
+		kswapd_update_workers(nid);
+	unlock_memory_hotplug();
+	return 0;
+}
+
 static int __init kswapd_init(void)
 {
 	int nid;
 
+	BUILD_BUG_ON(PGSCAN_KSWAPD_WORKER_7 - PGSCAN_KSWAPD_WORKER_0 + 1 !=
+		     MAX_KSWAPD_WORKERS);
+
 	swap_setup();
 	for_each_node_state(nid, N_HIGH_MEMORY)
  		kswapd_run(nid);
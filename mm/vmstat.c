@@ -684,6 +684,9 @@ static void walk_zones_in_node(struct seq_file *m, pg_data_t *pgdat,
 #define TEXTS_FOR_ZONES(xx) TEXT_FOR_DMA(xx) TEXT_FOR_DMA32(xx) xx "_normal", \
 					TEXT_FOR_HIGHMEM(xx) xx "_movable",
 
+#define TEXTS_FOR_KSWAPD_WORKERS(xx) xx "0", xx "1", xx "2", xx "3", \
+					xx "4", xx "5", xx "6", xx "7",
+
 const char * const vmstat_text[] = {
 	/* Zoned VM counters */
 	"nr_free_pages",
@@ -712,6 +715,8 @@ const char * const vmstat_text[] = {
 	"nr_shmem",
 	"nr_dirtied",
 	"nr_written",
+	"workingset_refault",
+	"workingset_activate",
 
 #ifdef CONFIG_NUMA
 	"numa_hit",
@@ -745,6 +750,8 @@ const char * const vmstat_text[] = {
 	TEXTS_FOR_ZONES("pgsteal_direct")
 	TEXTS_FOR_ZONES("pgscan_kswapd")
 	TEXTS_FOR_ZONES("pgscan_direct")
+	TEXTS_FOR_KSWAPD_WORKERS("pgsteal_kswapd_worker")
+	TEXTS_FOR_KSWAPD_WORKERS("pgscan_kswapd_worker")
 	"pgscan_direct_throttle",
 
 #ifdef CONFIG_NUMA
@@ -789,6 +796,8 @@ const char * const vmstat_text[] = {
 	"thp_collapse_alloc",
 	"thp_collapse_alloc_failed",
 	"thp_split",
+	"thp_zero_page_alloc",
+	"thp_zero_page_alloc_failed",
 #endif
 
 #endif /* CONFIG_VM_EVENTS_COUNTERS */
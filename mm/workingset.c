@@ -0,0 +1,275 @@
+/*
+ * linux/mm/workingset.c
+ *
+ * Workingset detection: telling a refault of a page that belongs to the
+ * workingset apart from a page which is only ever used once.
+ */
+
+#include <linux/memcontrol.h>
+#include <linux/writeback.h>
+#include <linux/pagemap.h>
+#include <linux/atomic.h>
+#include <linux/module.h>
+#include <linux/shrinker.h>
+#include <linux/swap.h>
+#include <linux/fs.h>
+#include <linux/mm.h>
+
+/*
+ * Double CLOCK lists
+ *
+ * Per zone, two clock lists are maintained for file pages: the inactive
+ * and the active list.  Freshly faulted pages start out at the head of
+ * the inactive list and page reclaim scans pages from the tail.  Pages
+ * that are accessed multiple times on the inactive list are promoted to
+ * the active list, to protect them from reclaim, whereas active pages
+ * are demoted to the inactive list when the active list grows too big.
+ *
+ * A workload is thrashing when its pages are frequently used but they
+ * are evicted from the inactive list every time before another access
+ * would have promoted them to the active list.  With the fixed ratios
+ * vmscan balances the lists by, a large streaming scan therefore pushes
+ * out the workingset, and it takes many refaults for it to climb back
+ * onto the active list.
+ *
+ * Approximating inactive page access frequency
+ *
+ * Let the zone's inactive age be a counter that is incremented whenever
+ * a page is evicted from the inactive list or activated from it.  Both
+ * move every page behind it one slot closer to the tail.
+ *
+ * When a file page is evicted, the current inactive age is stored as a
+ * shadow entry in the page's now empty page cache slot.  When the page
+ * faults back in, the difference between the current inactive age and
+ * the one recorded in the shadow is its refault distance: the minimum
+ * number of inactive list slots the page would have needed to still be
+ * resident at the time of the refault.
+ *
+ * Activating refaulting pages
+ *
+ * The active list only shrinks by deactivating its pages to the
+ * inactive list, so all of the active list's pages are potentially
+ * available to the inactive list.  If the refault distance is no larger
+ * than the active list, giving the inactive list that much more room
+ * would have kept the page resident: it belongs to the workingset, and
+ * it is put straight onto the active list.  Pages with a larger refault
+ * distance go to the inactive list as before, so a one-off scan can no
+ * longer displace the workingset.
+ *
+ * Shadow entries are removed when their page cache slot is reused, and
+ * by truncation and inode eviction.
+ *
+ * Shadow entries and the radix tree nodes holding them
+ *
+ * A large file that stays open is never evicted, and the shadow entries
+ * of its evicted pages would pile up without bound.  But only as many
+ * shadows as there are active file pages can still cause an activation:
+ * anything evicted earlier has a refault distance larger than the active
+ * list.  Mappings that hold shadow entries are therefore kept on a list,
+ * oldest first, and once there are more shadow entries in the system
+ * than active file pages, a shrinker clears out the shadow entries of
+ * the mappings at the head of that list, freeing their tree nodes.
+ */
+
+static LIST_HEAD(shadow_mappings);
+static DEFINE_SPINLOCK(shadow_mappings_lock);
+static atomic_long_t nr_shadows;
+
+#define EVICTION_SHIFT	(RADIX_TREE_EXCEPTIONAL_SHIFT + \
+			 ZONES_SHIFT + NODES_SHIFT)
+#define EVICTION_MASK	(~0UL >> EVICTION_SHIFT)
+
+static void *pack_shadow(unsigned long eviction, struct zone *zone)
+{
+	eviction = (eviction << NODES_SHIFT) | zone_to_nid(zone);
+	eviction = (eviction << ZONES_SHIFT) | zone_idx(zone);
+	eviction = (eviction << RADIX_TREE_EXCEPTIONAL_SHIFT);
+
+	return (void *)(eviction | RADIX_TREE_EXCEPTIONAL_ENTRY);
+}
+
+static void unpack_shadow(void *shadow, struct zone **zone,
+			  unsigned long *distance)
+{
+	unsigned long entry = (unsigned long)shadow;
+	unsigned long eviction;
+	unsigned long refault;
+	int zid, nid;
+
+	entry >>= RADIX_TREE_EXCEPTIONAL_SHIFT;
+	zid = entry & ((1UL << ZONES_SHIFT) - 1);
+	entry >>= ZONES_SHIFT;
+	nid = entry & ((1UL << NODES_SHIFT) - 1);
+	entry >>= NODES_SHIFT;
+	eviction = entry;
+
+	*zone = NODE_DATA(nid)->node_zones + zid;
+
+	refault = atomic_long_read(&(*zone)->inactive_age);
+	/*
+	 * The unsigned subtraction here gives an accurate distance
+	 * across inactive_age overflows in most cases.
+	 *
+	 * There is a special case: usually, shadow entries have a short
+	 * lifetime and are either refaulted or reclaimed along with the
+	 * inode before they get too old.  But it is not impossible for
+	 * the inactive_age to lap a shadow entry in the field, which
+	 * can then result in a false small refault distance, leading
+	 * to a false activation should this old entry actually refault
+	 * again.  However, the active list is still aged whenever it
+	 * outgrows the inactive list, so the occasional inappropriate
+	 * activation only costs a little extra active list pressure.
+	 */
+	*distance = (refault - eviction) & EVICTION_MASK;
+}
+
+/**
+ * workingset_eviction - note the eviction of a page from memory
+ * @mapping: address space the page was backing
+ * @page: the page being evicted
+ *
+ * Returns a shadow entry to be stored in @mapping->page_tree in place
+ * of the evicted @page so that a later refault can be detected.
+ */
+void *workingset_eviction(struct address_space *mapping, struct page *page)
+{
+	struct zone *zone = page_zone(page);
+	unsigned long eviction;
+
+	eviction = atomic_long_inc_return(&zone->inactive_age);
+	return pack_shadow(eviction & EVICTION_MASK, zone);
+}
+
+/**
+ * workingset_refault - evaluate the refault of a previously evicted page
+ * @shadow: shadow entry of the evicted page
+ *
+ * Calculates and evaluates the refault distance of the previously
+ * evicted page in the context of the zone it was allocated in.
+ *
+ * Returns %true if the page should be activated, %false otherwise.
+ */
+bool workingset_refault(void *shadow)
+{
+	unsigned long refault_distance;
+	struct zone *zone;
+
+	unpack_shadow(shadow, &zone, &refault_distance);
+	inc_zone_state(zone, WORKINGSET_REFAULT);
+
+	if (refault_distance <= zone_page_state(zone, NR_ACTIVE_FILE)) {
+		inc_zone_state(zone, WORKINGSET_ACTIVATE);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * workingset_activation - note a page activation
+ * @page: page that is being activated
+ */
+void workingset_activation(struct page *page)
+{
+	atomic_long_inc(&page_zone(page)->inactive_age);
+}
+
+/**
+ * workingset_shadow_added - account a shadow entry stored in a mapping
+ * @mapping: address space the shadow entry was stored in
+ *
+ * Caller must hold @mapping->tree_lock.
+ */
+void workingset_shadow_added(struct address_space *mapping)
+{
+	if (!mapping->nrshadows++) {
+		spin_lock(&shadow_mappings_lock);
+		list_add_tail(&mapping->shadow_list, &shadow_mappings);
+		spin_unlock(&shadow_mappings_lock);
+	}
+	atomic_long_inc(&nr_shadows);
+}
+
+/**
+ * workingset_shadows_removed - account shadow entries removed from a mapping
+ * @mapping: address space the shadow entries were removed from
+ * @nr: number of shadow entries removed
+ *
+ * Caller must hold @mapping->tree_lock.  A mapping without shadow
+ * entries leaves the shrinker's list, so it can be freed.
+ */
+void workingset_shadows_removed(struct address_space *mapping,
+				unsigned long nr)
+{
+	mapping->nrshadows -= nr;
+	if (!mapping->nrshadows) {
+		spin_lock(&shadow_mappings_lock);
+		list_del_init(&mapping->shadow_list);
+		spin_unlock(&shadow_mappings_lock);
+	}
+	atomic_long_sub(nr, &nr_shadows);
+}
+
+/* Shadow entries that can no longer lead to an activation */
+static long excess_shadows(void)
+{
+	return atomic_long_read(&nr_shadows) -
+		(long)global_page_state(NR_ACTIVE_FILE);
+}
+
+static int shrink_shadows(struct shrinker *shrink, struct shrink_control *sc)
+{
+	long nr_to_scan = sc->nr_to_scan;
+	long excess;
+
+	if (!nr_to_scan)
+		goto out;
+
+	/* Dropping the inode reference may have to evict it */
+	if (!(sc->gfp_mask & __GFP_FS))
+		return -1;
+
+	while (nr_to_scan > 0 && excess_shadows() > 0) {
+		struct address_space *mapping;
+		struct inode *inode;
+
+		spin_lock_irq(&shadow_mappings_lock);
+		if (list_empty(&shadow_mappings)) {
+			spin_unlock_irq(&shadow_mappings_lock);
+			break;
+		}
+		mapping = list_first_entry(&shadow_mappings,
+					   struct address_space, shadow_list);
+		list_move_tail(&mapping->shadow_list, &shadow_mappings);
+		/*
+		 * Reclaim only plants shadows in the host's own page cache,
+		 * and clear_inode() takes the mapping off this list before
+		 * the inode is freed: the host is still there.
+		 */
+		inode = igrab(mapping->host);
+		spin_unlock_irq(&shadow_mappings_lock);
+		if (!inode) {
+			/* Being evicted, which clears its shadows anyway */
+			nr_to_scan--;
+			continue;
+		}
+
+		nr_to_scan -= mapping->nrshadows;
+		clear_shadow_entries(mapping, 0, ~0UL);
+		iput(inode);
+	}
+out:
+	excess = excess_shadows();
+	return excess > 0 ? min_t(long, excess, INT_MAX) : 0;
+}
+
+static struct shrinker shadow_shrinker = {
+	.shrink = shrink_shadows,
+	.seeks = DEFAULT_SEEKS,
+};
+
+static int __init workingset_init(void)
+{
+	register_shrinker(&shadow_shrinker);
+	return 0;
+}
+module_init(workingset_init);
@@ -135,6 +135,7 @@
 #include <linux/net_tstamp.h>
 #include <linux/static_key.h>
 #include <net/flow_keys.h>
+#include <net/busy_poll.h>
 
 #include "net-sysfs.h"
 
@@ -1602,6 +1603,25 @@ static inline bool is_skb_forwardable(struct net_device *dev,
  * impact namespace isolation.
  */
 int dev_forward_skb(struct net_device *dev, struct sk_buff *skb)
+{
+	return __dev_forward_skb(dev, skb) ?: netif_rx(skb);
+}
+EXPORT_SYMBOL_GPL(dev_forward_skb);
+
+/**
+ * __dev_forward_skb - prepare an skb for loopback to another netif
+ *
+ * @dev: destination network device
+ * @skb: buffer to forward
+ *
+ * Does everything dev_forward_skb() does except handing the skb to
+ * netif_rx(), for devices that queue it for their own NAPI context.
+ *
+ * return values:
+ *	0		(skb is ready to be received on @dev)
+ *	NET_RX_DROP	(packet was dropped, but freed)
+ */
+int __dev_forward_skb(struct net_device *dev, struct sk_buff *skb)
 {
 	if (skb_shinfo(skb)->tx_flags & SKBTX_DEV_ZEROCOPY) {
 		if (skb_copy_ubufs(skb, GFP_ATOMIC)) {
@@ -1628,15 +1648,15 @@ int dev_forward_skb(struct net_device *dev, struct sk_buff *skb)
 	skb->mark = 0;
 	secpath_reset(skb);
 	nf_reset(skb);
-	return netif_rx(skb);
+	return 0;
 }
-EXPORT_SYMBOL_GPL(dev_forward_skb);
+EXPORT_SYMBOL_GPL(__dev_forward_skb);
 
 static inline int deliver_skb(struct sk_buff *skb,
 			      struct packet_type *pt_prev,
 			      struct net_device *orig_dev)
 {
-	if (unlikely(skb_orphan_frags(skb, GFP_ATOMIC)))
+	if (unlikely(skb_orphan_frags_rx(skb, GFP_ATOMIC)))
 		return -ENOMEM;
 	atomic_inc(&skb->users);
 	return pt_prev->func(skb, skb->dev, pt_prev, orig_dev);
@@ -1959,16 +1979,15 @@ out:
 EXPORT_SYMBOL(skb_checksum_help);
 
 /**
- *	skb_gso_segment - Perform segmentation on skb.
- *	@skb: buffer to segment
+ *	skb_mac_gso_segment - mac layer segmentation handler.
+ *	@skb: buffer to segment, data at the mac header
  *	@features: features for the output path (see dev->features)
  *
- *	This function segments the given skb and returns a list of segments.
- *
- *	It may return NULL if the skb requires no segmentation.  This is
- *	only possible when GSO is used for verifying header integrity.
+ *	Hands the skb to the segmentation handler of the protocol behind
+ *	skb->mac_len bytes of link layer header.  Tunnels use this to
+ *	segment their inner packet, with all outer headers as "mac" header.
  */
-struct sk_buff *skb_gso_segment(struct sk_buff *skb,
+struct sk_buff *skb_mac_gso_segment(struct sk_buff *skb,
 	netdev_features_t features)
 {
 	struct sk_buff *segs = ERR_PTR(-EPROTONOSUPPORT);
@@ -1988,18 +2007,8 @@ struct sk_buff *skb_gso_segment(struct sk_buff *skb,
 		vlan_depth += VLAN_HLEN;
 	}
 
-	skb_reset_mac_header(skb);
-	skb->mac_len = skb->network_header - skb->mac_header;
 	__skb_pull(skb, skb->mac_len);
 
-	if (unlikely(skb->ip_summed != CHECKSUM_PARTIAL)) {
-		skb_warn_bad_offload(skb);
-
-		if (skb_header_cloned(skb) &&
-		    (err = pskb_expand_head(skb, 0, 0, GFP_ATOMIC)))
-			return ERR_PTR(err);
-	}
-
 	rcu_read_lock();
 	list_for_each_entry_rcu(ptype,
 			&ptype_base[ntohs(type) & PTYPE_HASH_MASK], list) {
@@ -2022,8 +2031,104 @@ struct sk_buff *skb_gso_segment(struct sk_buff *skb,
 
 	return segs;
 }
+EXPORT_SYMBOL(skb_mac_gso_segment);
+
+/**
+ *	skb_gso_segment - Perform segmentation on skb.
+ *	@skb: buffer to segment
+ *	@features: features for the output path (see dev->features)
+ *
+ *	This function segments the given skb and returns a list of segments.
+ *
+ *	It may return NULL if the skb requires no segmentation.  This is
+ *	only possible when GSO is used for verifying header integrity.
+ */
+struct sk_buff *skb_gso_segment(struct sk_buff *skb,
+	netdev_features_t features)
+{
+	int err;
+
+	skb_reset_mac_header(skb);
+	skb->mac_len = skb->network_header - skb->mac_header;
+
+	if (unlikely(skb->ip_summed != CHECKSUM_PARTIAL)) {
+		skb_warn_bad_offload(skb);
+
+		if (skb_header_cloned(skb) &&
+		    (err = pskb_expand_head(skb, 0, 0, GFP_ATOMIC)))
+			return ERR_PTR(err);
+	}
+
+	return skb_mac_gso_segment(skb, features);
+}
 EXPORT_SYMBOL(skb_gso_segment);
 
+/**
+ *	skb_encap_gso_segment - segment the inner packet of a tunnel
+ *	@skb: buffer to segment, data at the tunnel (GRE, UDP) header
+ *	@features: features for the output path (see dev->features)
+ *	@hlen: length of the tunnel headers up to the inner network header
+ *	@type: protocol of the inner network header
+ *
+ *	Segments the inner packet and copies all outer headers in front of
+ *	each segment.  The network and transport headers of the segments
+ *	point at the outer IP and the tunnel header again, so that the
+ *	callers up the stack can fix up their lengths.  The inner checksum
+ *	is resolved in software unless the device can checksum at any
+ *	offset.
+ */
+struct sk_buff *skb_encap_gso_segment(struct sk_buff *skb,
+	netdev_features_t features, unsigned int hlen, __be16 type)
+{
+	__be16 protocol = skb->protocol;
+	u16 mac_len = skb->mac_len;
+	int nhoff = skb_network_offset(skb);
+	struct sk_buff *segs, *seg;
+	unsigned int tnl_hlen;
+
+	if (unlikely(!pskb_may_pull(skb, hlen)))
+		return ERR_PTR(-EINVAL);
+
+	__skb_pull(skb, hlen);
+	skb_reset_network_header(skb);
+	tnl_hlen = skb->data - skb_mac_header(skb);
+	skb->mac_len = tnl_hlen;
+	skb->protocol = type;
+	__skb_push(skb, tnl_hlen);
+
+	segs = skb_mac_gso_segment(skb, features | NETIF_F_HW_CSUM);
+
+	__skb_pull(skb, tnl_hlen - hlen);
+	skb_reset_transport_header(skb);
+	skb_set_network_header(skb, nhoff);
+	skb->mac_len = mac_len;
+	skb->protocol = protocol;
+
+	if (IS_ERR_OR_NULL(segs))
+		return segs;
+
+	for (seg = segs; seg; seg = seg->next) {
+		if (!(features & NETIF_F_HW_CSUM) &&
+		    seg->ip_summed == CHECKSUM_PARTIAL &&
+		    skb_checksum_help(seg))
+			goto err;
+
+		seg->protocol = protocol;
+		seg->mac_len = mac_len;
+		skb_set_network_header(seg, mac_len);
+		skb_set_transport_header(seg, tnl_hlen - hlen);
+	}
+	return segs;
+
+err:
+	while ((seg = segs)) {
+		segs = seg->next;
+		kfree_skb(seg);
+	}
+	return ERR_PTR(-ENOMEM);
+}
+EXPORT_SYMBOL_GPL(skb_encap_gso_segment);
+
 /* Take action when hardware reception checksum errors are detected. */
 #ifdef CONFIG_BUG
 void netdev_rx_csum_fault(struct net_device *dev)
@@ -3129,6 +3234,117 @@ out:
 }
 #endif
 
+/**
+ *	dev_change_rx_filter - set the receive filter of a device
+ *	@dev: Ethernet device
+ *	@fprog: classic BPF program, or NULL to detach
+ *
+ *	The filter sees every frame received on @dev, from the Ethernet
+ *	header on, before the stack does, and returns one of the RX_FILTER_*
+ *	verdicts.  Drivers that set IFF_RX_FILTER_NATIVE run it on their
+ *	receive buffer, before they build an skb; for other devices it runs
+ *	first thing in __netif_receive_skb().
+ *
+ *	The caller must hold the rtnl_mutex.
+ */
+int dev_change_rx_filter(struct net_device *dev, struct sock_fprog *fprog)
+{
+	struct sk_filter *fp = NULL, *old;
+	struct sk_filter_orig *orig = NULL, *old_orig;
+	unsigned int fsize;
+	int err;
+
+	ASSERT_RTNL();
+
+	if (fprog) {
+		if (dev->type != ARPHRD_ETHER)
+			return -EOPNOTSUPP;
+
+		/* sk_chk_filter() rewrites the copy it runs, keep the original */
+		fsize = fprog->len * sizeof(struct sock_filter);
+		orig = kmalloc(sizeof(*orig) + fsize, GFP_KERNEL);
+		if (!orig)
+			return -ENOMEM;
+		orig->len = fprog->len;
+		memcpy(orig->insns, (__force void *)fprog->filter, fsize);
+
+		err = sk_unattached_filter_create(&fp, fprog);
+		if (err) {
+			kfree(orig);
+			return err;
+		}
+	}
+
+	old = rtnl_dereference(dev->rx_filter);
+	rcu_assign_pointer(dev->rx_filter, fp);
+	if (old)
+		sk_unattached_filter_destroy(old);
+
+	old_orig = rtnl_dereference(dev->rx_filter_orig);
+	rcu_assign_pointer(dev->rx_filter_orig, orig);
+	if (old_orig)
+		kfree_rcu(old_orig, rcu);
+
+	return 0;
+}
+EXPORT_SYMBOL(dev_change_rx_filter);
+
+/**
+ *	dev_rx_filter_act - carry out a receive filter verdict
+ *	@skb: received frame, data at the Ethernet header
+ *	@verdict: what the filter returned
+ *
+ *	Returns true if the frame was dropped or sent back out of skb->dev,
+ *	false if the caller should pass it on to the stack.
+ */
+bool dev_rx_filter_act(struct sk_buff *skb, unsigned int verdict)
+{
+	unsigned char addr[ETH_ALEN];
+	struct ethhdr *eth;
+
+	switch (verdict) {
+	case RX_FILTER_DROP:
+		break;
+	case RX_FILTER_TX:
+		if (!pskb_may_pull(skb, ETH_HLEN) || skb_cow_head(skb, 0))
+			break;
+
+		eth = (struct ethhdr *)skb->data;
+		memcpy(addr, eth->h_dest, ETH_ALEN);
+		memcpy(eth->h_dest, eth->h_source, ETH_ALEN);
+		memcpy(eth->h_source, addr, ETH_ALEN);
+
+		skb_reset_mac_header(skb);
+		skb_set_network_header(skb, ETH_HLEN);
+		dev_queue_xmit(skb);
+		return true;
+	default:
+		return false;
+	}
+
+	atomic_long_inc(&skb->dev->rx_dropped);
+	kfree_skb(skb);
+	return true;
+}
+EXPORT_SYMBOL(dev_rx_filter_act);
+
+/* Receive filter of devices whose driver does not run it natively */
+static bool netif_generic_rx_filter(struct sk_buff *skb)
+{
+	struct sk_filter *fp = rcu_dereference(skb->dev->rx_filter);
+	unsigned int verdict;
+
+	if (likely(!fp) || skb->dev->priv_flags & IFF_RX_FILTER_NATIVE)
+		return false;
+
+	__skb_push(skb, skb->mac_len);
+	verdict = SK_RUN_FILTER(fp, skb);
+	if (dev_rx_filter_act(skb, verdict))
+		return true;
+	__skb_pull(skb, skb->mac_len);
+	return false;
+}
+
 /**
  *	netdev_rx_handler_register - register receive handler
  *	@dev: device to register a handler for
@@ -3234,6 +3450,9 @@ static int __netif_receive_skb(struct sk_buff *skb)
 
 	rcu_read_lock();
 
+	if (netif_generic_rx_filter(skb))
+		goto unlock;
+
 another_round:
 	skb->skb_iif = skb->dev->ifindex;
 
@@ -3322,7 +3541,7 @@ ncls:
 	}
 
 	if (pt_prev) {
-		if (unlikely(skb_orphan_frags(skb, GFP_ATOMIC)))
+		if (unlikely(skb_orphan_frags_rx(skb, GFP_ATOMIC)))
 			goto drop;
 		else
 			ret = pt_prev->func(skb, skb->dev, pt_prev, orig_dev);
@@ -3431,7 +3650,7 @@ static int napi_gro_complete(struct sk_buff *skb)
 		if (ptype->type != type || ptype->dev || !ptype->gro_complete)
 			continue;
 
-		err = ptype->gro_complete(skb);
+		err = ptype->gro_complete(skb, 0);
 		break;
 	}
 	rcu_read_unlock();
@@ -3446,21 +3665,65 @@ out:
 	return netif_receive_skb(skb);
 }
 
-inline void napi_gro_flush(struct napi_struct *napi)
+/*
+ * Complete the held packets, oldest first.  With @flush_old, stop at the
+ * packets held during the current jiffy so that they can still grow.
+ */
+void napi_gro_flush(struct napi_struct *napi, bool flush_old)
 {
-	struct sk_buff *skb, *next;
+	struct sk_buff *skb, *prev = NULL;
 
-	for (skb = napi->gro_list; skb; skb = next) {
-		next = skb->next;
+	/* gro_list is newest first: chain it up the other way */
+	for (skb = napi->gro_list; skb; skb = skb->next) {
+		skb->prev = prev;
+		prev = skb;
+	}
+
+	for (skb = prev; skb; skb = prev) {
 		skb->next = NULL;
+
+		if (flush_old && NAPI_GRO_CB(skb)->age == (u32)jiffies)
+			return;
+
+		prev = skb->prev;
 		napi_gro_complete(skb);
+		napi->gro_count--;
 	}
 
-	napi->gro_count = 0;
 	napi->gro_list = NULL;
 }
 EXPORT_SYMBOL(napi_gro_flush);
 
+/*
+ * GRO handlers of the protocol behind a tunnel header, for the tunnel's
+ * own gro_receive/gro_complete.  Caller holds rcu_read_lock().
+ */
+struct packet_type *gro_find_receive_by_type(__be16 type)
+{
+	struct list_head *head = &ptype_base[ntohs(type) & PTYPE_HASH_MASK];
+	struct packet_type *ptype;
+
+	list_for_each_entry_rcu(ptype, head, list) {
+		if (ptype->type == type && !ptype->dev && ptype->gro_receive)
+			return ptype;
+	}
+	return NULL;
+}
+EXPORT_SYMBOL(gro_find_receive_by_type);
+
+struct packet_type *gro_find_complete_by_type(__be16 type)
+{
+	struct list_head *head = &ptype_base[ntohs(type) & PTYPE_HASH_MASK];
+	struct packet_type *ptype;
+
+	list_for_each_entry_rcu(ptype, head, list) {
+		if (ptype->type == type && !ptype->dev && ptype->gro_complete)
+			return ptype;
+	}
+	return NULL;
+}
+EXPORT_SYMBOL(gro_find_complete_by_type);
+
 enum gro_result dev_gro_receive(struct napi_struct *napi, struct sk_buff *skb)
 {
 	struct sk_buff **pp = NULL;
@@ -3471,6 +3734,8 @@ enum gro_result dev_gro_receive(struct napi_struct *napi, struct sk_buff *skb)
 	int mac_len;
 	enum gro_result ret;
 
+	BUILD_BUG_ON(sizeof(struct napi_gro_cb) > sizeof(skb->cb));
+
 	if (!(skb->dev->features & NETIF_F_GRO) || netpoll_rx_on(skb))
 		goto normal;
 
@@ -3488,6 +3753,7 @@ enum gro_result dev_gro_receive(struct napi_struct *napi, struct sk_buff *skb)
 		NAPI_GRO_CB(skb)->same_flow = 0;
 		NAPI_GRO_CB(skb)->flush = 0;
 		NAPI_GRO_CB(skb)->free = 0;
+		NAPI_GRO_CB(skb)->encap_mark = 0;
 
 		pp = ptype->gro_receive(&napi->gro_list, skb);
 		break;
@@ -3517,6 +3783,7 @@ enum gro_result dev_gro_receive(struct napi_struct *napi, struct sk_buff *skb)
 
 	napi->gro_count++;
 	NAPI_GRO_CB(skb)->count = 1;
+	NAPI_GRO_CB(skb)->age = jiffies;
 	skb_shinfo(skb)->gso_size = skb_gro_len(skb);
 	skb->next = napi->gro_list;
 	napi->gro_list = skb;
@@ -3832,7 +4099,6 @@ EXPORT_SYMBOL(__napi_schedule);
 void __napi_complete(struct napi_struct *n)
 {
 	BUG_ON(!test_bit(NAPI_STATE_SCHED, &n->state));
-	BUG_ON(n->gro_list);
 
 	list_del(&n->poll_list);
 	smp_mb__before_clear_bit();
@@ -3840,7 +4106,18 @@ void __napi_complete(struct napi_struct *n)
 }
 EXPORT_SYMBOL(__napi_complete);
 
-void napi_complete(struct napi_struct *n)
+/**
+ *	napi_complete_done - NAPI processing complete
+ *	@n: napi context
+ *	@work_done: number of packets the last poll processed
+ *
+ *	Like napi_complete(), but if the device has a gro_flush_timeout and
+ *	the poll did some work, packets held by GRO are kept for up to that
+ *	long instead of being flushed.  A timer reschedules the poll to
+ *	flush them if no interrupt comes first, so that under load GRO
+ *	aggregates across interrupts.
+ */
+void napi_complete_done(struct napi_struct *n, int work_done)
 {
 	unsigned long flags;
 
@@ -3851,17 +4128,157 @@ void napi_complete(struct napi_struct *n)
 	if (unlikely(test_bit(NAPI_STATE_NPSVC, &n->state)))
 		return;
 
-	napi_gro_flush(n);
+	if (n->gro_list) {
+		unsigned long timeout = 0;
+
+		if (work_done)
+			timeout = n->dev->gro_flush_timeout;
+
+		if (timeout) {
+			napi_gro_flush(n, HZ >= 1000);
+			hrtimer_start(&n->timer, ns_to_ktime(timeout),
+				      HRTIMER_MODE_REL_PINNED);
+		} else {
+			napi_gro_flush(n, false);
+		}
+	}
 	local_irq_save(flags);
 	__napi_complete(n);
 	local_irq_restore(flags);
 }
-EXPORT_SYMBOL(napi_complete);
+EXPORT_SYMBOL(napi_complete_done);
+
+#ifdef CONFIG_NET_RX_BUSY_POLL
+#define NAPI_HASH_BITS	8
+#define NAPI_HASH_SIZE	(1 << NAPI_HASH_BITS)
+
+static struct hlist_head napi_hash[NAPI_HASH_SIZE];
+static DEFINE_SPINLOCK(napi_hash_lock);
+static unsigned int napi_gen_id;
+
+unsigned int sysctl_net_busy_read __read_mostly;
+EXPORT_SYMBOL(sysctl_net_busy_read);
+unsigned int sysctl_net_busy_poll __read_mostly;
+EXPORT_SYMBOL(sysctl_net_busy_poll);
+
+/* must be called under rcu_read_lock(), as we dont take a reference */
+struct napi_struct *napi_by_id(unsigned int napi_id)
+{
+	struct hlist_head *head = &napi_hash[napi_id & (NAPI_HASH_SIZE - 1)];
+	struct napi_struct *napi;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry_rcu(napi, pos, head, napi_hash_node)
+		if (napi->napi_id == napi_id)
+			return napi;
+	return NULL;
+}
+EXPORT_SYMBOL_GPL(napi_by_id);
+
+void napi_hash_add(struct napi_struct *napi)
+{
+	if (test_and_set_bit(NAPI_STATE_HASHED, &napi->state))
+		return;
+
+	spin_lock(&napi_hash_lock);
+	/* 0 is not a valid id, and an id still in use is skipped */
+	do {
+		if (unlikely(++napi_gen_id == 0))
+			napi_gen_id = 1;
+	} while (napi_by_id(napi_gen_id));
+	napi->napi_id = napi_gen_id;
+	hlist_add_head_rcu(&napi->napi_hash_node,
+			   &napi_hash[napi->napi_id & (NAPI_HASH_SIZE - 1)]);
+	spin_unlock(&napi_hash_lock);
+}
+EXPORT_SYMBOL_GPL(napi_hash_add);
+
+/* Returns true if @napi was hashed, so that lockless readers may see it. */
+static bool napi_hash_del(struct napi_struct *napi)
+{
+	bool hashed;
+
+	spin_lock(&napi_hash_lock);
+	hashed = test_and_clear_bit(NAPI_STATE_HASHED, &napi->state);
+	if (hashed)
+		hlist_del_rcu(&napi->napi_hash_node);
+	spin_unlock(&napi_hash_lock);
+	return hashed;
+}
+
+/**
+ *	__sk_busy_loop - poll the NIC queue a socket receives from
+ *	@sk: socket with an empty receive queue
+ *	@usecs: how long to keep polling, 0 for a single pass
+ *
+ * Call the driver's ndo_busy_poll for the napi context the socket's last
+ * packet came from until something was queued on @sk, the time is up or
+ * the task has better things to do.  Returns true if the receive queue is
+ * no longer empty.
+ */
+bool __sk_busy_loop(struct sock *sk, unsigned int usecs)
+{
+	u64 end_time = local_clock() + (u64)usecs * NSEC_PER_USEC;
+	const struct net_device_ops *ops;
+	struct napi_struct *napi;
+	bool rc = false;
+
+	rcu_read_lock();
+	napi = napi_by_id(sk->sk_napi_id);
+	if (!napi)
+		goto out;
+	ops = napi->dev->netdev_ops;
+	if (!ops->ndo_busy_poll)
+		goto out;
+
+	do {
+		void *have;
+		int cnt;
+
+		local_bh_disable();
+		have = netpoll_poll_lock(napi);
+		cnt = ops->ndo_busy_poll(napi);
+		netpoll_poll_unlock(have);
+		if (cnt > 0)
+			NET_ADD_STATS_BH(sock_net(sk),
+					 LINUX_MIB_BUSYPOLLRXPACKETS, cnt);
+		local_bh_enable();
+		if (cnt == LL_FLUSH_FAILED)
+			break;
+	} while (skb_queue_empty(&sk->sk_receive_queue) &&
+		 !need_resched() && !signal_pending(current) &&
+		 local_clock() < end_time);
+
+	rc = !skb_queue_empty(&sk->sk_receive_queue);
+out:
+	rcu_read_unlock();
+	return rc;
+}
+EXPORT_SYMBOL(__sk_busy_loop);
+#else
+static inline bool napi_hash_del(struct napi_struct *napi)
+{
+	return false;
+}
+#endif /* CONFIG_NET_RX_BUSY_POLL */
+
+static enum hrtimer_restart napi_watchdog(struct hrtimer *timer)
+{
+	struct napi_struct *napi;
+
+	napi = container_of(timer, struct napi_struct, timer);
+	if (napi->gro_list)
+		napi_schedule(napi);
+
+	return HRTIMER_NORESTART;
+}
 
 void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
 		    int (*poll)(struct napi_struct *, int), int weight)
 {
 	INIT_LIST_HEAD(&napi->poll_list);
+	hrtimer_init(&napi->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_PINNED);
+	napi->timer.function = napi_watchdog;
 	napi->gro_count = 0;
 	napi->gro_list = NULL;
 	napi->skb = NULL;
@@ -3881,8 +4298,13 @@ void netif_napi_del(struct napi_struct *napi)
 {
 	struct sk_buff *skb, *next;
 
+	/* busy pollers look napi up locklessly */
+	if (napi_hash_del(napi))
+		synchronize_net();
+
 	list_del_init(&napi->dev_list);
 	napi_free_frags(napi);
+	hrtimer_cancel(&napi->timer);
 
 	for (skb = napi->gro_list; skb; skb = next) {
 		next = skb->next;
@@ -3956,8 +4378,17 @@ static void net_rx_action(struct softirq_action *h)
 				local_irq_enable();
 				napi_complete(n);
 				local_irq_disable();
-			} else
+			} else {
+				if (n->gro_list) {
+					/* Flush what is too old to grow,
+					 * everything if a jiffy is long.
+					 */
+					local_irq_enable();
+					napi_gro_flush(n, HZ >= 1000);
+					local_irq_disable();
+				}
 				list_move_tail(&n->poll_list, &sd->poll_list);
+			}
 		}
 
 		netpoll_poll_unlock(have);
@@ -6069,6 +6500,11 @@ void free_netdev(struct net_device *dev)
 
 	kfree(rcu_dereference_protected(dev->ingress_queue, 1));
 
+	if (rcu_access_pointer(dev->rx_filter))
+		sk_unattached_filter_destroy(rcu_dereference_protected(
+						dev->rx_filter, 1));
+	kfree(rcu_dereference_protected(dev->rx_filter_orig, 1));
+
 	/* Flush device addresses */
 	dev_addr_flush(dev);
 
@@ -24,6 +24,7 @@
 #include <linux/in.h>
 #include <linux/inet.h>
 #include <linux/netdevice.h>
+#include <linux/etherdevice.h>
 #include <linux/if_packet.h>
 #include <linux/gfp.h>
 #include <net/ip.h>
@@ -39,6 +40,7 @@
 #include <linux/reciprocal_div.h>
 #include <linux/ratelimit.h>
 #include <linux/seccomp.h>
+#include <linux/bpf.h>
 
 /* No hurry in this branch
  *
@@ -381,6 +383,55 @@ load_b:
 }
 EXPORT_SYMBOL(sk_run_filter);
 
+/**
+ *	sk_run_filter_frame - run a filter on a frame that has no skb yet
+ *	@fp: filter to run
+ *	@dev: Ethernet device the frame was received on
+ *	@data: start of the frame, at the Ethernet header
+ *	@len: length of the frame, at least ETH_HLEN
+ *
+ *	For device receive filters run by the driver on its receive buffer.
+ *	The interpreter and the JIT take an skb as context, so an skb on the
+ *	stack describes the frame.  Only the fields a filter can read are set
+ *	up, the way eth_type_trans() would.
+ */
+unsigned int sk_run_filter_frame(const struct sk_filter *fp,
+				 struct net_device *dev,
+				 void *data, unsigned int len)
+{
+	const struct ethhdr *eth = data;
+	struct sk_buff skb;
+
+	skb.head = skb.data = data;
+	skb.len = len;
+	skb.data_len = 0;
+	skb_reset_tail_pointer(&skb);
+	skb.tail += len;
+	skb_reset_mac_header(&skb);
+	skb_set_network_header(&skb, ETH_HLEN);
+	skb.dev = dev;
+
+	if (ntohs(eth->h_proto) >= 1536)
+		skb.protocol = eth->h_proto;
+	else
+		skb.protocol = htons(ETH_P_802_3);
+
+	if (unlikely(is_multicast_ether_addr(eth->h_dest)))
+		skb.pkt_type = is_broadcast_ether_addr(eth->h_dest) ?
+			       PACKET_BROADCAST : PACKET_MULTICAST;
+	else if (unlikely(!ether_addr_equal(eth->h_dest, dev->dev_addr)))
+		skb.pkt_type = PACKET_OTHERHOST;
+	else
+		skb.pkt_type = PACKET_HOST;
+
+	skb.mark = 0;
+	skb.queue_mapping = 0;
+	skb.rxhash = 0;
+
+	return SK_RUN_FILTER(fp, &skb);
+}
+EXPORT_SYMBOL_GPL(sk_run_filter_frame);
+
 /*
  * Security :
  * A BPF program is able to use 16 cells of memory to store intermediate
@@ -602,7 +653,10 @@ void sk_filter_release_rcu(struct rcu_head *rcu)
 {
 	struct sk_filter *fp = container_of(rcu, struct sk_filter, rcu);
 
-	bpf_jit_free(fp);
+	if (fp->prog)
+		bpf_prog_put(fp->prog);
+	else
+		bpf_jit_free(fp);
 	kfree(fp);
 }
 EXPORT_SYMBOL(sk_filter_release_rcu);
@@ -612,6 +666,7 @@ static int __sk_prepare_filter(struct sk_filter *fp)
 	int err;
 
 	fp->bpf_func = sk_run_filter;
+	fp->prog = NULL;
 
 	err = sk_chk_filter(fp->insns, fp->len);
 	if (err)
@@ -715,6 +770,114 @@ int sk_attach_filter(struct sock_fprog *fprog, struct sock *sk)
 }
 EXPORT_SYMBOL_GPL(sk_attach_filter);
 
+#ifdef CONFIG_BPF_SYSCALL
+/*
+ * Trampoline from the sk_filter calling convention into the eBPF
+ * program.  The filter has no classic instructions, so @filter is
+ * only used to find the sk_filter it is embedded in.
+ */
+static unsigned int sk_run_bpf_filter(const struct sk_buff *skb,
+				      const struct sock_filter *filter)
+{
+	struct sk_filter *fp = container_of(filter, struct sk_filter, insns[0]);
+
+	return BPF_PROG_RUN(fp->prog, skb);
+}
+
+/**
+ *	sk_attach_bpf - attach an eBPF program as socket filter
+ *	@ufd: file descriptor returned by BPF_PROG_LOAD
+ *	@sk: the socket to use
+ *
+ * The program must be of type BPF_PROG_TYPE_SOCKET_FILTER.  It replaces
+ * any filter already attached and its return value is used exactly
+ * like the return value of a classic filter.
+ */
+int sk_attach_bpf(u32 ufd, struct sock *sk)
+{
+	struct sk_filter *fp, *old_fp;
+	struct bpf_prog *prog;
+
+	prog = bpf_prog_get(ufd);
+	if (IS_ERR(prog))
+		return PTR_ERR(prog);
+
+	if (prog->type != BPF_PROG_TYPE_SOCKET_FILTER) {
+		/* valid fd, but invalid program type */
+		bpf_prog_put(prog);
+		return -EINVAL;
+	}
+
+	fp = sock_kmalloc(sk, sizeof(*fp), GFP_KERNEL);
+	if (!fp) {
+		bpf_prog_put(prog);
+		return -ENOMEM;
+	}
+
+	atomic_set(&fp->refcnt, 1);
+	fp->len = 0;
+	fp->prog = prog;
+	fp->bpf_func = sk_run_bpf_filter;
+
+	old_fp = rcu_dereference_protected(sk->sk_filter,
+					   sock_owned_by_user(sk));
+	rcu_assign_pointer(sk->sk_filter, fp);
+
+	if (old_fp)
+		sk_filter_uncharge(sk, old_fp);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(sk_attach_bpf);
+
+static const struct bpf_func_proto *sock_filter_func_proto(enum bpf_func_id func_id)
+{
+	switch (func_id) {
+	case BPF_FUNC_map_lookup_elem:
+		return &bpf_map_lookup_elem_proto;
+	case BPF_FUNC_map_update_elem:
+		return &bpf_map_update_elem_proto;
+	case BPF_FUNC_map_delete_elem:
+		return &bpf_map_delete_elem_proto;
+	case BPF_FUNC_get_prandom_u32:
+		return &bpf_get_prandom_u32_proto;
+	case BPF_FUNC_get_smp_processor_id:
+		return &bpf_get_smp_processor_id_proto;
+	default:
+		return NULL;
+	}
+}
+
+/* packet data is read with BPF_LD_ABS/IND only, not through ctx */
+static bool sock_filter_is_valid_access(int off, int size,
+					enum bpf_access_type type)
+{
+	return false;
+}
+
+static const struct bpf_verifier_ops sock_filter_ops = {
+	.get_func_proto = sock_filter_func_proto,
+	.is_valid_access = sock_filter_is_valid_access,
+};
+
+static struct bpf_prog_type_list sock_filter_type __read_mostly = {
+	.ops = &sock_filter_ops,
+	.type = BPF_PROG_TYPE_SOCKET_FILTER,
+};
+
+static int __init register_sock_filter_ops(void)
+{
+	bpf_register_prog_type(&sock_filter_type);
+	return 0;
+}
+late_initcall(register_sock_filter_ops);
+#else
+int sk_attach_bpf(u32 ufd, struct sock *sk)
+{
+	return -EOPNOTSUPP;
+}
+EXPORT_SYMBOL_GPL(sk_attach_bpf);
+#endif
+
 int sk_detach_filter(struct sock *sk)
 {
 	int ret = -ENOENT;
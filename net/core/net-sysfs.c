@@ -255,6 +255,21 @@ static ssize_t store_tx_queue_len(struct device *dev,
 	return netdev_store(dev, attr, buf, len, change_tx_queue_len);
 }
 
+NETDEVICE_SHOW(gro_flush_timeout, fmt_ulong);
+
+static int change_gro_flush_timeout(struct net_device *net, unsigned long val)
+{
+	net->gro_flush_timeout = val;
+	return 0;
+}
+
+static ssize_t store_gro_flush_timeout(struct device *dev,
+				       struct device_attribute *attr,
+				       const char *buf, size_t len)
+{
+	return netdev_store(dev, attr, buf, len, change_gro_flush_timeout);
+}
+
 static ssize_t store_ifalias(struct device *dev, struct device_attribute *attr,
 			     const char *buf, size_t len)
 {
@@ -325,6 +340,8 @@ static struct device_attribute net_class_attributes[] = {
 	__ATTR(flags, S_IRUGO | S_IWUSR, show_flags, store_flags),
 	__ATTR(tx_queue_len, S_IRUGO | S_IWUSR, show_tx_queue_len,
 	       store_tx_queue_len),
+	__ATTR(gro_flush_timeout, S_IRUGO | S_IWUSR, show_gro_flush_timeout,
+	       store_gro_flush_timeout),
 	__ATTR(netdev_group, S_IRUGO | S_IWUSR, show_group, store_group),
 	{}
 };
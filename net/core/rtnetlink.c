@@ -763,6 +763,36 @@ static size_t rtnl_port_size(const struct net_device *dev)
 		return port_self_size;
 }
 
+static size_t rtnl_rx_filter_size(const struct net_device *dev)
+{
+	const struct sk_filter_orig *orig;
+	size_t size = 0;
+
+	rcu_read_lock();
+	orig = rcu_dereference(dev->rx_filter_orig);
+	if (orig)
+		size = nla_total_size(orig->len * sizeof(struct sock_filter));
+	rcu_read_unlock();
+
+	return size;
+}
+
+static int rtnl_rx_filter_fill(struct sk_buff *skb, struct net_device *dev)
+{
+	const struct sk_filter_orig *orig;
+	int err = 0;
+
+	rcu_read_lock();
+	orig = rcu_dereference(dev->rx_filter_orig);
+	if (orig)
+		err = nla_put(skb, IFLA_RX_FILTER,
+			      orig->len * sizeof(struct sock_filter),
+			      orig->insns);
+	rcu_read_unlock();
+
+	return err;
+}
+
 static noinline size_t if_nlmsg_size(const struct net_device *dev,
 				     u32 ext_filter_mask)
 {
@@ -790,7 +820,8 @@ static noinline size_t if_nlmsg_size(const struct net_device *dev,
 	       + rtnl_vfinfo_size(dev, ext_filter_mask) /* IFLA_VFINFO_LIST */
 	       + rtnl_port_size(dev) /* IFLA_VF_PORTS + IFLA_PORT_SELF */
 	       + rtnl_link_get_size(dev) /* IFLA_LINKINFO */
-	       + rtnl_link_get_af_size(dev); /* IFLA_AF_SPEC */
+	       + rtnl_link_get_af_size(dev) /* IFLA_AF_SPEC */
+	       + rtnl_rx_filter_size(dev); /* IFLA_RX_FILTER */
 }
 
 static int rtnl_vf_ports_fill(struct sk_buff *skb, struct net_device *dev)
@@ -912,7 +943,8 @@ static int rtnl_fill_ifinfo(struct sk_buff *skb, struct net_device *dev,
 	    (dev->qdisc &&
 	     nla_put_string(skb, IFLA_QDISC, dev->qdisc->ops->id)) ||
 	    (dev->ifalias &&
-	     nla_put_string(skb, IFLA_IFALIAS, dev->ifalias)))
+	     nla_put_string(skb, IFLA_IFALIAS, dev->ifalias)) ||
+	    rtnl_rx_filter_fill(skb, dev))
 		goto nla_put_failure;
 
 	if (1) {
@@ -1124,6 +1156,8 @@ const struct nla_policy ifla_policy[IFLA_MAX+1] = {
 	[IFLA_PROMISCUITY]	= { .type = NLA_U32 },
 	[IFLA_NUM_TX_QUEUES]	= { .type = NLA_U32 },
 	[IFLA_NUM_RX_QUEUES]	= { .type = NLA_U32 },
+	[IFLA_RX_FILTER]	= { .type = NLA_BINARY,
+				    .len = BPF_MAXINSNS * sizeof(struct sock_filter) },
 };
 EXPORT_SYMBOL(ifla_policy);
 
@@ -1396,6 +1430,22 @@ static int do_setlink(struct net_device *dev, struct ifinfomsg *ifm,
 		modified = 1;
 	}
 
+	if (tb[IFLA_RX_FILTER]) {
+		struct sock_fprog fprog;
+		int len = nla_len(tb[IFLA_RX_FILTER]);
+
+		err = -EINVAL;
+		if (len % sizeof(struct sock_filter))
+			goto errout;
+
+		fprog.len = len / sizeof(struct sock_filter);
+		fprog.filter = nla_data(tb[IFLA_RX_FILTER]);
+		err = dev_change_rx_filter(dev, fprog.len ? &fprog : NULL);
+		if (err)
+			goto errout;
+		modified = 1;
+	}
+
 	/*
 	 * Interface selected by interface index but interface
 	 * name provided implies that a name change has been
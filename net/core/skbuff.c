@@ -60,6 +60,8 @@
 #include <linux/scatterlist.h>
 #include <linux/errqueue.h>
 #include <linux/prefetch.h>
+#include <linux/capability.h>
+#include <linux/cred.h>
 
 #include <net/protocol.h>
 #include <net/dst.h>
@@ -500,13 +502,7 @@ static void skb_release_data(struct sk_buff *skb)
 		 * If skb buf is from userspace, we need to notify the caller
 		 * the lower device DMA has done;
 		 */
-		if (skb_shinfo(skb)->tx_flags & SKBTX_DEV_ZEROCOPY) {
-			struct ubuf_info *uarg;
-
-			uarg = skb_shinfo(skb)->destructor_arg;
-			if (uarg->callback)
-				uarg->callback(uarg);
-		}
+		skb_zcopy_clear(skb, true);
 
 		if (skb_has_frag_list(skb))
 			skb_drop_fraglist(skb);
@@ -700,6 +696,9 @@ static void __copy_skb_header(struct sk_buff *new, const struct sk_buff *old)
 	new->ooo_okay		= old->ooo_okay;
 	new->l4_rxhash		= old->l4_rxhash;
 	new->no_fcs		= old->no_fcs;
+#ifdef CONFIG_NET_RX_BUSY_POLL
+	new->napi_id		= old->napi_id;
+#endif
 #ifdef CONFIG_XFRM
 	new->sp			= secpath_get(old->sp);
 #endif
@@ -783,6 +782,303 @@ struct sk_buff *skb_morph(struct sk_buff *dst, struct sk_buff *src)
 }
 EXPORT_SYMBOL_GPL(skb_morph);
 
+/*
+ * MSG_ZEROCOPY: pages pinned on behalf of a sender are charged against its
+ * RLIMIT_MEMLOCK, like other long lived pins, until the notification for
+ * them has been generated.
+ */
+static int mm_account_pinned_pages(struct mmpin *mmp, size_t size)
+{
+	unsigned long max_pg, num_pg, new_pg, old_pg;
+	struct user_struct *user;
+
+	if (capable(CAP_IPC_LOCK) || !size)
+		return 0;
+
+	num_pg = (size >> PAGE_SHIFT) + 2;	/* worst case alignment */
+	max_pg = rlimit(RLIMIT_MEMLOCK) >> PAGE_SHIFT;
+	user = mmp->user ? : current_user();
+
+	do {
+		old_pg = atomic_long_read(&user->locked_vm);
+		new_pg = old_pg + num_pg;
+		if (new_pg > max_pg)
+			return -ENOBUFS;
+	} while (atomic_long_cmpxchg(&user->locked_vm, old_pg, new_pg) !=
+		 old_pg);
+
+	if (!mmp->user) {
+		mmp->user = get_uid(user);
+		mmp->num_pg = num_pg;
+	} else {
+		mmp->num_pg += num_pg;
+	}
+
+	return 0;
+}
+
+static void mm_unaccount_pinned_pages(struct mmpin *mmp)
+{
+	if (mmp->user) {
+		atomic_long_sub(mmp->num_pg, &mmp->user->locked_vm);
+		free_uid(mmp->user);
+	}
+}
+
+static inline struct sk_buff *skb_from_uarg(struct ubuf_info *uarg)
+{
+	return container_of((void *)uarg, struct sk_buff, cb);
+}
+
+/**
+ *	sock_zerocopy_alloc - start a MSG_ZEROCOPY notification
+ *	@sk: sending socket
+ *	@size: number of bytes the sendmsg call may pin
+ *
+ *	Allocates the skb that will carry the completion notification to the
+ *	socket error queue; its ubuf_info lives in the skb control block.
+ *	The returned uarg holds one reference, which the caller drops with
+ *	sock_zerocopy_put() or sock_zerocopy_put_abort().
+ */
+struct ubuf_info *sock_zerocopy_alloc(struct sock *sk, size_t size)
+{
+	struct ubuf_info *uarg;
+	struct sk_buff *skb;
+
+	if (!sock_flag(sk, SOCK_ZEROCOPY))
+		return NULL;
+
+	skb = sock_omalloc(sk, 0, GFP_KERNEL);
+	if (!skb)
+		return NULL;
+
+	BUILD_BUG_ON(sizeof(*uarg) > sizeof(skb->cb));
+	uarg = (void *)skb->cb;
+	uarg->mmp.user = NULL;
+
+	if (mm_account_pinned_pages(&uarg->mmp, size)) {
+		kfree_skb(skb);
+		return NULL;
+	}
+
+	uarg->callback = sock_zerocopy_callback;
+	uarg->id = ((u32)atomic_inc_return(&sk->sk_zckey)) - 1;
+	uarg->len = 1;
+	uarg->bytelen = size;
+	uarg->zerocopy = 1;
+	atomic_set(&uarg->refcnt, 1);
+	sock_hold(sk);
+
+	return uarg;
+}
+EXPORT_SYMBOL_GPL(sock_zerocopy_alloc);
+
+/**
+ *	sock_zerocopy_realloc - extend a MSG_ZEROCOPY notification
+ *	@sk: sending socket, locked by the caller
+ *	@size: number of bytes the sendmsg call may pin
+ *	@uarg: uarg of the skb at the tail of the write queue, or %NULL
+ *
+ *	Consecutive sendmsg calls that append to the same skb share its uarg,
+ *	so that they complete with a single notification covering the range
+ *	of their ids.  Falls back to sock_zerocopy_alloc() when @uarg cannot
+ *	be extended.
+ */
+struct ubuf_info *sock_zerocopy_realloc(struct sock *sk, size_t size,
+					struct ubuf_info *uarg)
+{
+	if (uarg) {
+		const u32 byte_limit = 1 << 19;		/* a few TSO frames */
+		u32 bytelen, next;
+
+		/* uarg->len and sk_zckey are serialized by the socket lock */
+		if (WARN_ON_ONCE(!sock_owned_by_user(sk)))
+			return NULL;
+
+		bytelen = uarg->bytelen + size;
+		if (uarg->len == USHRT_MAX - 1 || bytelen > byte_limit)
+			goto new_alloc;
+
+		next = (u32)atomic_read(&sk->sk_zckey);
+		if ((u32)(uarg->id + uarg->len) == next) {
+			if (mm_account_pinned_pages(&uarg->mmp, size))
+				return NULL;
+			uarg->len++;
+			uarg->bytelen = bytelen;
+			atomic_set(&sk->sk_zckey, ++next);
+			sock_zerocopy_get(uarg);
+			return uarg;
+		}
+	}
+
+new_alloc:
+	return sock_zerocopy_alloc(sk, size);
+}
+EXPORT_SYMBOL_GPL(sock_zerocopy_realloc);
+
+static bool skb_zerocopy_notify_extend(struct sk_buff *skb, u32 lo, u16 len)
+{
+	struct sock_exterr_skb *serr = SKB_EXT_ERR(skb);
+	u32 old_lo, old_hi;
+	u64 sum_len;
+
+	old_lo = serr->ee.ee_info;
+	old_hi = serr->ee.ee_data;
+	sum_len = old_hi - old_lo + 1ULL + len;
+
+	if (sum_len >= (1ULL << 32))
+		return false;
+
+	if (lo != old_hi + 1)
+		return false;
+
+	serr->ee.ee_data += len;
+	return true;
+}
+
+/*
+ * Called when the last skb referencing the user pages is gone: report
+ * the range of completed sendmsg ids on the socket error queue, merging
+ * it into a notification that is still queued where possible.
+ */
+void sock_zerocopy_callback(struct ubuf_info *uarg, bool success)
+{
+	struct sk_buff *tail, *skb = skb_from_uarg(uarg);
+	struct sock_exterr_skb *serr;
+	struct sock *sk = skb->sk;
+	struct sk_buff_head *q;
+	unsigned long flags;
+	u32 lo, hi;
+	u16 len;
+
+	mm_unaccount_pinned_pages(&uarg->mmp);
+
+	/* if !len, there was only one call and it was aborted,
+	 * so do not queue a completion notification
+	 */
+	if (!uarg->len || sock_flag(sk, SOCK_DEAD))
+		goto release;
+
+	len = uarg->len;
+	lo = uarg->id;
+	hi = uarg->id + len - 1;
+
+	/* the control block is reused for the error, uarg is gone now */
+	serr = SKB_EXT_ERR(skb);
+	memset(serr, 0, sizeof(*serr));
+	serr->ee.ee_errno = 0;
+	serr->ee.ee_origin = SO_EE_ORIGIN_ZEROCOPY;
+	serr->ee.ee_data = hi;
+	serr->ee.ee_info = lo;
+	if (!success)
+		serr->ee.ee_code |= SO_EE_CODE_ZEROCOPY_COPIED;
+
+	q = &sk->sk_error_queue;
+	spin_lock_irqsave(&q->lock, flags);
+	tail = skb_peek_tail(q);
+	if (!tail || SKB_EXT_ERR(tail)->ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY ||
+	    !skb_zerocopy_notify_extend(tail, lo, len)) {
+		__skb_queue_tail(q, skb);
+		skb = NULL;
+	}
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	sk->sk_error_report(sk);
+
+release:
+	consume_skb(skb);
+	sock_put(sk);
+}
+EXPORT_SYMBOL_GPL(sock_zerocopy_callback);
+
+void sock_zerocopy_put(struct ubuf_info *uarg)
+{
+	if (uarg && atomic_dec_and_test(&uarg->refcnt)) {
+		if (uarg->callback)
+			uarg->callback(uarg, uarg->zerocopy);
+		else
+			consume_skb(skb_from_uarg(uarg));
+	}
+}
+EXPORT_SYMBOL_GPL(sock_zerocopy_put);
+
+/* Undo the sendmsg call that took @uarg, which did not send any data */
+void sock_zerocopy_put_abort(struct ubuf_info *uarg)
+{
+	if (uarg) {
+		struct sock *sk = skb_from_uarg(uarg)->sk;
+
+		atomic_dec(&sk->sk_zckey);
+		uarg->len--;
+
+		sock_zerocopy_put(uarg);
+	}
+}
+EXPORT_SYMBOL_GPL(sock_zerocopy_put_abort);
+
+/**
+ *	skb_zerocopy_add_user - pin user memory into the frags of an skb
+ *	@sk: stream socket the data is charged to
+ *	@skb: skb to append to
+ *	@from: user buffer
+ *	@len: number of bytes wanted
+ *	@uarg: MSG_ZEROCOPY state of the current sendmsg call
+ *
+ *	Appends up to @len bytes at @from to @skb as references to the user
+ *	pages themselves and attaches @uarg, so that the sender is notified
+ *	once the last reference to them is gone.  Returns the number of bytes
+ *	added, -EEXIST if @skb already carries another uarg, -EMSGSIZE if it
+ *	has no free frag slot or -EFAULT.
+ */
+int skb_zerocopy_add_user(struct sock *sk, struct sk_buff *skb,
+			  const unsigned char __user *from, int len,
+			  struct ubuf_info *uarg)
+{
+	struct ubuf_info *orig_uarg = skb_zcopy(skb);
+	int copied = 0;
+
+	if (orig_uarg && orig_uarg != uarg)
+		return -EEXIST;
+
+	while (copied < len) {
+		unsigned long base = (unsigned long)from + copied;
+		int i = skb_shinfo(skb)->nr_frags;
+		int off = base & ~PAGE_MASK;
+		int size = min_t(int, len - copied, PAGE_SIZE - off);
+		struct page *page;
+
+		if (get_user_pages_fast(base, 1, 0, &page) != 1) {
+			if (!copied)
+				return -EFAULT;
+			break;
+		}
+
+		if (skb_can_coalesce(skb, i, page, off)) {
+			skb_frag_size_add(&skb_shinfo(skb)->frags[i - 1], size);
+			put_page(page);
+		} else if (i < MAX_SKB_FRAGS) {
+			skb_fill_page_desc(skb, i, page, off, size);
+		} else {
+			put_page(page);
+			break;
+		}
+		copied += size;
+	}
+
+	if (!copied)
+		return -EMSGSIZE;
+
+	skb->len += copied;
+	skb->data_len += copied;
+	skb->truesize += copied;
+	sk->sk_wmem_queued += copied;
+	sk_mem_charge(sk, copied);
+	skb_zcopy_set(skb, uarg);
+
+	return copied;
+}
+EXPORT_SYMBOL_GPL(skb_zerocopy_add_user);
+
 /**
  *	skb_copy_ubufs	-	copy userspace skb frags buffers to kernel
  *	@skb: the skb to modify
@@ -801,10 +1097,18 @@ EXPORT_SYMBOL_GPL(skb_morph);
 int skb_copy_ubufs(struct sk_buff *skb, gfp_t gfp_mask)
 {
 	int i;
-	int num_frags = skb_shinfo(skb)->nr_frags;
+	int num_frags;
 	struct page *page, *head = NULL;
-	struct ubuf_info *uarg = skb_shinfo(skb)->destructor_arg;
 
+	/* MSG_ZEROCOPY frags may be shared with clones still on the
+	 * retransmit queue: give this skb its own shinfo first.
+	 */
+	if (skb_shared(skb))
+		return -EINVAL;
+	if (skb_cloned(skb) && pskb_expand_head(skb, 0, 0, gfp_mask))
+		return -ENOMEM;
+
+	num_frags = skb_shinfo(skb)->nr_frags;
 	for (i = 0; i < num_frags; i++) {
 		u8 *vaddr;
 		skb_frag_t *f = &skb_shinfo(skb)->frags[i];
@@ -830,8 +1134,6 @@ int skb_copy_ubufs(struct sk_buff *skb, gfp_t gfp_mask)
 	for (i = 0; i < num_frags; i++)
 		skb_frag_unref(skb, i);
 
-	uarg->callback(uarg);
-
 	/* skb frags point to kernel buffers */
 	for (i = num_frags - 1; i >= 0; i--) {
 		__skb_fill_page_desc(skb, i, head, 0,
@@ -839,7 +1141,7 @@ int skb_copy_ubufs(struct sk_buff *skb, gfp_t gfp_mask)
 		head = (struct page *)head->private;
 	}
 
-	skb_shinfo(skb)->tx_flags &= ~SKBTX_DEV_ZEROCOPY;
+	skb_zcopy_clear(skb, false);
 	return 0;
 }
 EXPORT_SYMBOL_GPL(skb_copy_ubufs);
@@ -1000,6 +1302,7 @@ struct sk_buff *__pskb_copy(struct sk_buff *skb, int headroom, gfp_t gfp_mask)
 			n = NULL;
 			goto out;
 		}
+		skb_zcopy_set(n, skb_zcopy(skb));
 		for (i = 0; i < skb_shinfo(skb)->nr_frags; i++) {
 			skb_shinfo(n)->frags[i] = skb_shinfo(skb)->frags[i];
 			skb_frag_ref(skb, i);
@@ -1075,6 +1378,9 @@ int pskb_expand_head(struct sk_buff *skb, int nhead, int ntail,
 		/* copy this zero copy skb frags */
 		if (skb_orphan_frags(skb, gfp_mask))
 			goto nofrags;
+		/* the new shinfo holds its own reference on a MSG_ZEROCOPY uarg */
+		if (skb_zcopy(skb))
+			sock_zerocopy_get(skb_uarg(skb));
 		for (i = 0; i < skb_shinfo(skb)->nr_frags; i++)
 			skb_frag_ref(skb, i);
 
@@ -2378,6 +2684,7 @@ void skb_split(struct sk_buff *skb, struct sk_buff *skb1, const u32 len)
 {
 	int pos = skb_headlen(skb);
 
+	skb_zcopy_set(skb1, skb_zcopy(skb));
 	if (len < pos)	/* Split line is inside header. */
 		skb_split_inside_header(skb, skb1, len, pos);
 	else		/* Second chunk has no header, nothing to copy. */
@@ -2420,6 +2727,10 @@ int skb_shift(struct sk_buff *tgt, struct sk_buff *skb, int shiftlen)
 	BUG_ON(shiftlen > skb->len);
 	BUG_ON(skb_headlen(skb));	/* Would corrupt stream */
 
+	/* Frags may only move between skbs that pin the same user pages */
+	if (skb_zcopy(tgt) != skb_zcopy(skb))
+		return 0;
+
 	todo = shiftlen;
 	from = 0;
 	to = skb_shinfo(tgt)->nr_frags;
@@ -2890,6 +3201,7 @@ struct sk_buff *skb_segment(struct sk_buff *skb, netdev_features_t features)
 		}
 
 		frag = skb_shinfo(nskb)->frags;
+		skb_zcopy_set(nskb, skb_zcopy(skb));
 
 		skb_copy_from_linear_data_offset(skb, offset,
 						 skb_put(nskb, hsize), hsize);
@@ -3056,7 +3368,7 @@ int skb_gro_receive(struct sk_buff **head, struct sk_buff *skb)
 	skb_shinfo(nskb)->gso_size = pinfo->gso_size;
 	pinfo->gso_size = 0;
 	skb_header_release(p);
-	nskb->prev = p;
+	NAPI_GRO_CB(nskb)->last = p;
 
 	nskb->data_len += p->len;
 	nskb->truesize += p->truesize;
@@ -3082,8 +3394,8 @@ merge:
 
 	__skb_pull(skb, offset);
 
-	p->prev->next = skb;
-	p->prev = skb;
+	NAPI_GRO_CB(p)->last->next = skb;
+	NAPI_GRO_CB(p)->last = skb;
 	skb_header_release(skb);
 
 done:
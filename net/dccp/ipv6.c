@@ -158,12 +158,9 @@ static void dccp_v6_err(struct sk_buff *skb, struct inet6_skb_parm *opt,
 
 	/* Might be for an request_sock */
 	switch (sk->sk_state) {
-		struct request_sock *req, **prev;
+		struct request_sock *req;
 	case DCCP_LISTEN:
-		if (sock_owned_by_user(sk))
-			goto out;
-
-		req = inet6_csk_search_req(sk, &prev, dh->dccph_dport,
+		req = inet6_csk_search_req(sk, dh->dccph_dport,
 					   &hdr->daddr, &hdr->saddr,
 					   inet6_iif(skb));
 		if (req == NULL)
@@ -178,10 +175,11 @@ static void dccp_v6_err(struct sk_buff *skb, struct inet6_skb_parm *opt,
 		if (!between48(seq, dccp_rsk(req)->dreq_iss,
 				    dccp_rsk(req)->dreq_gss)) {
 			NET_INC_STATS_BH(net, LINUX_MIB_OUTOFWINDOWICMPS);
+			reqsk_put(req);
 			goto out;
 		}
 
-		inet_csk_reqsk_queue_drop(sk, req, prev);
+		inet_csk_reqsk_queue_drop_and_put(sk, req);
 		goto out;
 
 	case DCCP_REQUESTING:
@@ -322,22 +320,25 @@ static struct request_sock_ops dccp6_request_sock_ops = {
 	.destructor	= dccp_v6_reqsk_destructor,
 	.send_reset	= dccp_v6_ctl_send_reset,
 	.syn_ack_timeout = dccp_syn_ack_timeout,
+	.timeout_init	= DCCP_TIMEOUT_INIT,
+	.rto_max	= DCCP_RTO_MAX,
 };
 
 static struct sock *dccp_v6_hnd_req(struct sock *sk,struct sk_buff *skb)
 {
 	const struct dccp_hdr *dh = dccp_hdr(skb);
 	const struct ipv6hdr *iph = ipv6_hdr(skb);
+	struct request_sock *req;
 	struct sock *nsk;
-	struct request_sock **prev;
+
 	/* Find possible connection requests. */
-	struct request_sock *req = inet6_csk_search_req(sk, &prev,
-							dh->dccph_sport,
-							&iph->saddr,
-							&iph->daddr,
-							inet6_iif(skb));
-	if (req != NULL)
-		return dccp_check_req(sk, skb, req, prev);
+	req = inet6_csk_search_req(sk, dh->dccph_sport, &iph->saddr,
+				   &iph->daddr, inet6_iif(skb));
+	if (req != NULL) {
+		nsk = dccp_check_req(sk, skb, req);
+		reqsk_put(req);
+		return nsk;
+	}
 
 	nsk = __inet6_lookup_established(sock_net(sk), &dccp_hashinfo,
 					 &iph->saddr, dh->dccph_sport,
@@ -381,7 +382,7 @@ static int dccp_v6_conn_request(struct sock *sk, struct sk_buff *skb)
 	if (inet_csk_reqsk_queue_is_full(sk))
 		goto drop;
 
-	if (sk_acceptq_is_full(sk) && inet_csk_reqsk_queue_young(sk) > 1)
+	if (inet_csk_acceptq_is_full(sk) && inet_csk_reqsk_queue_young(sk) > 1)
 		goto drop;
 
 	req = inet6_reqsk_alloc(&dccp6_request_sock_ops);
@@ -428,10 +429,12 @@ static int dccp_v6_conn_request(struct sock *sk, struct sk_buff *skb)
 	dreq->dreq_gss     = dreq->dreq_iss;
 	dreq->dreq_service = service;
 
-	if (dccp_v6_send_response(sk, req, NULL))
-		goto drop_and_free;
-
 	inet6_csk_reqsk_queue_hash_add(sk, req, DCCP_TIMEOUT_INIT);
+	if (dccp_v6_send_response(sk, req, NULL)) {
+		inet_csk_reqsk_queue_drop_and_put(sk, req);
+		goto drop;
+	}
+	reqsk_put(req);
 	return 0;
 
 drop_and_free:
@@ -496,7 +499,7 @@ static struct sock *dccp_v6_request_recv_sock(struct sock *sk,
 	}
 
 
-	if (sk_acceptq_is_full(sk))
+	if (inet_csk_acceptq_is_full(sk))
 		goto out_overflow;
 
 	if (dst == NULL) {
@@ -588,7 +591,12 @@ static struct sock *dccp_v6_request_recv_sock(struct sock *sk,
 		sock_put(newsk);
 		goto out;
 	}
-	__inet6_hash(newsk, NULL);
+	if (!inet6_ehash_nolisten(newsk, req)) {
+		/* Another CPU completed or dropped the request first */
+		bh_unlock_sock(newsk);
+		sock_put(newsk);
+		return NULL;
+	}
 
 	return newsk;
 
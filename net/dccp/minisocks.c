@@ -157,8 +157,7 @@ EXPORT_SYMBOL_GPL(dccp_create_openreq_child);
  * as an request_sock.
  */
 struct sock *dccp_check_req(struct sock *sk, struct sk_buff *skb,
-			    struct request_sock *req,
-			    struct request_sock **prev)
+			    struct request_sock *req)
 {
 	struct sock *child = NULL;
 	struct dccp_request_sock *dreq = dccp_rsk(req);
@@ -172,7 +171,7 @@ struct sock *dccp_check_req(struct sock *sk, struct sk_buff *skb,
 			/*
 			 * Send another RESPONSE packet
 			 * To protect against Request floods, increment retrans
-			 * counter (backoff, monitored by dccp_response_timer).
+			 * counter (backoff, monitored by the request timer).
 			 */
 			req->retrans++;
 			req->rsk_ops->rtx_syn_ack(sk, req, NULL);
@@ -203,12 +202,14 @@ struct sock *dccp_check_req(struct sock *sk, struct sk_buff *skb,
 		 goto drop;
 
 	child = inet_csk(sk)->icsk_af_ops->syn_recv_sock(sk, skb, req, NULL);
-	if (child == NULL)
+	if (child == NULL) {
+		/* Lost the race against another CPU for this request */
+		if (reqsk_unhashed(req))
+			goto out;
 		goto listen_overflow;
+	}
 
-	inet_csk_reqsk_queue_unlink(sk, req, prev);
-	inet_csk_reqsk_queue_removed(sk, req);
-	inet_csk_reqsk_queue_add(sk, req, child);
+	child = inet_csk_complete_hashdance(sk, child, req);
 out:
 	return child;
 listen_overflow:
@@ -218,7 +219,7 @@ drop:
 	if (dccp_hdr(skb)->dccph_type != DCCP_PKT_RESET)
 		req->rsk_ops->send_reset(sk, skb);
 
-	inet_csk_reqsk_queue_drop(sk, req, prev);
+	inet_csk_reqsk_queue_drop(sk, req);
 	goto out;
 }
 
@@ -19,6 +19,7 @@
 #include <linux/in.h>
 #include <linux/ip.h>
 #include <linux/netdevice.h>
+#include <linux/if_tunnel.h>
 #include <linux/spinlock.h>
 #include <net/protocol.h>
 #include <net/gre.h>
@@ -112,9 +113,145 @@ static void gre_err(struct sk_buff *skb, u32 info)
 	rcu_read_unlock();
 }
 
+/*
+ * GRO and GSO handle version 0 GRE with at most a key: a checksum or a
+ * sequence number differs per packet and cannot be rebuilt per segment.
+ */
+static unsigned int gre_offload_hlen(__be16 flags)
+{
+	if (flags & ~GRE_KEY)
+		return 0;
+	return sizeof(struct gre_base_hdr) + (flags & GRE_KEY ? 4 : 0);
+}
+
+static struct sk_buff *gre_gso_segment(struct sk_buff *skb,
+				       netdev_features_t features)
+{
+	const struct gre_base_hdr *greh;
+	unsigned int ghl;
+
+	if (unlikely(skb_shinfo(skb)->gso_type &
+		     ~(SKB_GSO_TCPV4 |
+		       SKB_GSO_TCPV6 |
+		       SKB_GSO_DODGY |
+		       SKB_GSO_TCP_ECN |
+		       SKB_GSO_GRE |
+		       0) ||
+		     !(skb_shinfo(skb)->gso_type & SKB_GSO_GRE)))
+		return ERR_PTR(-EINVAL);
+
+	if (unlikely(!pskb_may_pull(skb, sizeof(*greh))))
+		return ERR_PTR(-EINVAL);
+
+	greh = (const struct gre_base_hdr *)skb_transport_header(skb);
+	ghl = gre_offload_hlen(greh->flags);
+	if (unlikely(!ghl))
+		return ERR_PTR(-EINVAL);
+
+	return skb_encap_gso_segment(skb, features, ghl, greh->protocol);
+}
+
+static struct sk_buff **gre_gro_receive(struct sk_buff **head,
+					struct sk_buff *skb)
+{
+	struct sk_buff **pp = NULL;
+	const struct gre_base_hdr *greh;
+	struct packet_type *ptype;
+	struct sk_buff *p;
+	unsigned int hlen, ghl, off;
+	int ip_summed;
+	__wsum csum;
+	int flush = 1;
+
+	/* Tunnels are not aggregated inside other tunnels */
+	if (NAPI_GRO_CB(skb)->encap_mark)
+		goto out;
+	NAPI_GRO_CB(skb)->encap_mark = 1;
+
+	off = skb_gro_offset(skb);
+	hlen = off + sizeof(*greh);
+	greh = skb_gro_header_fast(skb, off);
+	if (skb_gro_header_hard(skb, hlen)) {
+		greh = skb_gro_header_slow(skb, hlen, off);
+		if (unlikely(!greh))
+			goto out;
+	}
+
+	ghl = gre_offload_hlen(greh->flags);
+	if (!ghl)
+		goto out;
+
+	hlen = off + ghl;
+	if (skb_gro_header_hard(skb, hlen)) {
+		greh = skb_gro_header_slow(skb, hlen, off);
+		if (unlikely(!greh))
+			goto out;
+	}
+
+	rcu_read_lock();
+	ptype = gro_find_receive_by_type(greh->protocol);
+	if (!ptype)
+		goto out_unlock;
+
+	flush = 0;
+
+	for (p = *head; p; p = p->next) {
+		if (!NAPI_GRO_CB(p)->same_flow)
+			continue;
+
+		/* Same flags, protocol and key */
+		if (memcmp(greh, p->data + off, ghl)) {
+			NAPI_GRO_CB(p)->same_flow = 0;
+			continue;
+		}
+	}
+
+	skb_gro_pull(skb, ghl);
+
+	/* The inner layers validate against a checksum of the inner packet */
+	ip_summed = skb->ip_summed;
+	csum = skb->csum;
+	skb_gro_encap_rcsum(skb, greh, ghl);
+
+	pp = ptype->gro_receive(head, skb);
+
+	if (skb->ip_summed == CHECKSUM_COMPLETE)
+		skb->ip_summed = ip_summed;
+	skb->csum = csum;
+
+out_unlock:
+	rcu_read_unlock();
+out:
+	NAPI_GRO_CB(skb)->flush |= flush;
+	return pp;
+}
+
+static int gre_gro_complete(struct sk_buff *skb, int nhoff)
+{
+	const struct gre_base_hdr *greh;
+	struct packet_type *ptype;
+	int err = -ENOENT;
+
+	greh = (const struct gre_base_hdr *)(skb->data + nhoff);
+
+	rcu_read_lock();
+	ptype = gro_find_complete_by_type(greh->protocol);
+	if (ptype)
+		err = ptype->gro_complete(skb, nhoff +
+					  gre_offload_hlen(greh->flags));
+	rcu_read_unlock();
+
+	if (!err)
+		skb_shinfo(skb)->gso_type |= SKB_GSO_GRE;
+	return err;
+}
+
 static const struct net_protocol net_gre_protocol = {
 	.handler     = gre_rcv,
 	.err_handler = gre_err,
+	.gso_segment = gre_gso_segment,
+	.gro_receive = gre_gro_receive,
+	.gro_complete = gre_gro_complete,
 	.netns_ok    = 1,
 };
 
@@ -39,6 +39,7 @@ struct inet_bind_bucket *inet_bind_bucket_create(struct kmem_cache *cachep,
 		write_pnet(&tb->ib_net, hold_net(net));
 		tb->port      = snum;
 		tb->fastreuse = 0;
+		tb->fastreuseport = 0;
 		tb->num_owners = 0;
 		INIT_HLIST_HEAD(&tb->owners);
 		hlist_add_head(&tb->node, &head->chain);
@@ -171,11 +172,15 @@ static inline int compute_score(struct sock *sk, struct net *net,
  * BSD API does not allow a listening sock to specify the remote port nor the
  * remote address for the connection. So always assume those are both
  * wildcarded during the search since they can never be otherwise.
+ *
+ * When several best-scoring listeners have SO_REUSEPORT set, one of them is
+ * chosen by the hash of the connection's 4-tuple, so that the connections
+ * are spread evenly over the group while every segment of a given flow
+ * keeps landing on the same socket.
  */
-
-
 struct sock *__inet_lookup_listener(struct net *net,
 				    struct inet_hashinfo *hashinfo,
+				    const __be32 saddr, const __be16 sport,
 				    const __be32 daddr, const unsigned short hnum,
 				    const int dif)
 {
@@ -183,7 +188,8 @@ struct sock *__inet_lookup_listener(struct net *net,
 	struct hlist_nulls_node *node;
 	unsigned int hash = inet_lhashfn(net, hnum);
 	struct inet_listen_hashbucket *ilb = &hashinfo->listening_hash[hash];
-	int score, hiscore;
+	int score, hiscore, matches = 0, reuseport = 0;
+	u32 phash = 0;
 
 	rcu_read_lock();
 begin:
@@ -194,6 +200,23 @@ begin:
 		if (score > hiscore) {
 			result = sk;
 			hiscore = score;
+			reuseport = sk->sk_reuseport;
+			if (reuseport) {
+				phash = inet_ehashfn(net, daddr, hnum,
+						     saddr, sport);
+				matches = 1;
+			}
+		} else if (score == hiscore && reuseport) {
+			/*
+			 * Reservoir sampling driven by the flow hash: the
+			 * n-th equal candidate replaces the result with
+			 * probability 1/n, which leaves each of them equally
+			 * likely in the end.
+			 */
+			matches++;
+			if (((u64)phash * matches) >> 32 == 0)
+				result = sk;
+			phash = next_pseudo_random32(phash);
 		}
 	}
 	/*
@@ -288,6 +311,63 @@ out:
 }
 EXPORT_SYMBOL_GPL(__inet_lookup_established);
 
+static inline bool inet_reqsk_match(const struct request_sock *req,
+				    unsigned int hash,
+				    const __be32 saddr, const __be16 sport,
+				    const __be32 daddr, const u16 hnum)
+{
+	const struct inet_request_sock *ireq = inet_rsk(req);
+
+	return req->rsk_hash == hash &&
+	       req->rsk_ops->family == AF_INET &&
+	       ireq->rmt_addr == saddr && ireq->rmt_port == sport &&
+	       ireq->loc_addr == daddr && ntohs(ireq->loc_port) == hnum;
+}
+
+/* Find the connection request a segment belongs to.  Requests live in
+ * their own chain of the established hash and are looked up under RCU
+ * only; the request is returned with a reference held.
+ */
+struct request_sock *__inet_lookup_reqsk(struct net *net,
+					 struct inet_hashinfo *hashinfo,
+					 const __be32 saddr, const __be16 sport,
+					 const __be32 daddr, const u16 hnum)
+{
+	unsigned int hash = inet_ehashfn(net, daddr, hnum, saddr, sport);
+	unsigned int slot = hash & hashinfo->ehash_mask;
+	struct inet_ehash_bucket *head = &hashinfo->ehash[slot];
+	const struct hlist_nulls_node *node;
+	struct request_sock *req;
+
+	rcu_read_lock();
+begin:
+	hlist_nulls_for_each_entry_rcu(req, node, &head->reqchain, rsk_node) {
+		if (inet_reqsk_match(req, hash, saddr, sport, daddr, hnum)) {
+			if (unlikely(!atomic_inc_not_zero(&req->rsk_refcnt)))
+				goto begin;
+			if (unlikely(!inet_reqsk_match(req, hash, saddr, sport,
+						       daddr, hnum) ||
+				     !net_eq(sock_net(req->rsk_listener), net))) {
+				reqsk_put(req);
+				goto begin;
+			}
+			goto out;
+		}
+	}
+	/*
+	 * if the nulls value we got at the end of this lookup is
+	 * not the expected one, we must restart lookup.
+	 * We probably met an item that was moved to another chain.
+	 */
+	if (get_nulls_value(node) != slot)
+		goto begin;
+	req = NULL;
+out:
+	rcu_read_unlock();
+	return req;
+}
+EXPORT_SYMBOL_GPL(__inet_lookup_reqsk);
+
 /* called with local bh disabled */
 static int __inet_check_established(struct inet_timewait_death_row *death_row,
 				    struct sock *sk, __u16 lport,
@@ -400,6 +480,53 @@ int __inet_hash_nolisten(struct sock *sk, struct inet_timewait_sock *tw)
 }
 EXPORT_SYMBOL_GPL(__inet_hash_nolisten);
 
+/* Insert a child created from @req (NULL for syncookies), in place of
+ * @req.  If another CPU already completed or dropped @req, the child is
+ * destroyed and false is returned; the caller must still unlock and
+ * release it.  sk->sk_hash must be set.
+ */
+bool __inet_ehash_nolisten(struct sock *sk, struct request_sock *req)
+{
+	struct inet_hashinfo *hashinfo = sk->sk_prot->h.hashinfo;
+	struct inet_ehash_bucket *head;
+	spinlock_t *lock;
+	bool ok = true;
+
+	WARN_ON(!sk_unhashed(sk));
+
+	head = inet_ehash_bucket(hashinfo, sk->sk_hash);
+	lock = inet_ehash_lockp(hashinfo, sk->sk_hash);
+
+	spin_lock(lock);
+	if (req && atomic_read(&req->rsk_refcnt)) {
+		WARN_ON(req->rsk_hash != sk->sk_hash);
+		ok = !reqsk_unhashed(req);
+		if (ok)
+			hlist_nulls_del_init_rcu(&req->rsk_node);
+	}
+	if (ok)
+		__sk_nulls_add_node_rcu(sk, &head->chain);
+	spin_unlock(lock);
+
+	if (ok) {
+		sock_prot_inuse_add(sock_net(sk), sk->sk_prot, 1);
+	} else {
+		percpu_counter_inc(sk->sk_prot->orphan_count);
+		sk->sk_state = TCP_CLOSE;
+		sock_set_flag(sk, SOCK_DEAD);
+		inet_csk_destroy_sock(sk);
+	}
+	return ok;
+}
+EXPORT_SYMBOL_GPL(__inet_ehash_nolisten);
+
+bool inet_ehash_nolisten(struct sock *sk, struct request_sock *req)
+{
+	sk->sk_hash = inet_sk_ehashfn(sk);
+	return __inet_ehash_nolisten(sk, req);
+}
+EXPORT_SYMBOL_GPL(inet_ehash_nolisten);
+
 static void __inet_hash(struct sock *sk)
 {
 	struct inet_hashinfo *hashinfo = sk->sk_prot->h.hashinfo;
@@ -508,6 +635,7 @@ int __inet_hash_connect(struct inet_timewait_death_row *death_row,
 				break;
 			}
 			tb->fastreuse = -1;
+			tb->fastreuseport = -1;
 			goto ok;
 
 		next_port:
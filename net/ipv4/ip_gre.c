@@ -663,6 +663,8 @@ static int ipgre_rcv(struct sk_buff *skb)
 		skb->mac_header = skb->network_header;
 		__pskb_pull(skb, offset);
 		skb_postpull_rcsum(skb, skb_transport_header(skb), offset);
+		/* what GRO merged behind this header is plain TCP now */
+		skb_shinfo(skb)->gso_type &= ~SKB_GSO_GRE;
 		skb->pkt_type = PACKET_HOST;
 #ifdef CONFIG_NET_IPGRE_BROADCAST
 		if (ipv4_is_multicast(iph->daddr)) {
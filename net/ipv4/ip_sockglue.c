@@ -398,8 +398,9 @@ int ip_recv_error(struct sock *sk, struct msghdr *msg, int len)
 
 	serr = SKB_EXT_ERR(skb);
 
+	/* MSG_ZEROCOPY notifications carry no packet headers */
 	sin = (struct sockaddr_in *)msg->msg_name;
-	if (sin) {
+	if (sin && serr->ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
 		sin->sin_family = AF_INET;
 		sin->sin_addr.s_addr = *(__be32 *)(skb_network_header(skb) +
 						   serr->addr_offset);
@@ -428,12 +429,16 @@ int ip_recv_error(struct sock *sk, struct msghdr *msg, int len)
 	msg->msg_flags |= MSG_ERRQUEUE;
 	err = copied;
 
-	/* Reset and regenerate socket error */
+	/* Reset and regenerate socket error.  MSG_ZEROCOPY notifications
+	 * are not errors and must not clobber a pending one.
+	 */
 	spin_lock_bh(&sk->sk_error_queue.lock);
-	sk->sk_err = 0;
+	if (serr->ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+		sk->sk_err = 0;
 	skb2 = skb_peek(&sk->sk_error_queue);
 	if (skb2 != NULL) {
-		sk->sk_err = SKB_EXT_ERR(skb2)->ee.ee_errno;
+		if (SKB_EXT_ERR(skb2)->ee.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+			sk->sk_err = SKB_EXT_ERR(skb2)->ee.ee_errno;
 		spin_unlock_bh(&sk->sk_error_queue.lock);
 		sk->sk_error_report(sk);
 	} else
@@ -24,7 +24,7 @@ static void tcp_diag_get_info(struct sock *sk, struct inet_diag_msg *r,
 	struct tcp_info *info = _info;
 
 	if (sk->sk_state == TCP_LISTEN) {
-		r->idiag_rqueue = sk->sk_ack_backlog;
+		r->idiag_rqueue = inet_csk_acceptq_len(sk);
 		r->idiag_wqueue = sk->sk_max_ack_backlog;
 	} else {
 		r->idiag_rqueue = max_t(int, tp->rcv_nxt - tp->copied_seq, 0);
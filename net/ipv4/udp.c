@@ -106,8 +106,10 @@
 #include <net/route.h>
 #include <net/checksum.h>
 #include <net/xfrm.h>
+#include <net/busy_poll.h>
 #include <trace/events/udp.h>
 #include <linux/static_key.h>
+#include <linux/if_ether.h>
 #include <trace/events/skb.h>
 #include "udp_impl.h"
 
@@ -139,12 +141,15 @@ static int udp_lib_lport_inuse(struct net *net, __u16 num,
 {
 	struct sock *sk2;
 	struct hlist_nulls_node *node;
+	int uid = sock_i_uid(sk);
 
 	sk_nulls_for_each(sk2, node, &hslot->head)
 		if (net_eq(sock_net(sk2), net) &&
 		    sk2 != sk &&
 		    (bitmap || udp_sk(sk2)->udp_port_hash == num) &&
 		    (!sk2->sk_reuse || !sk->sk_reuse) &&
+		    (!sk2->sk_reuseport || !sk->sk_reuseport ||
+		     uid != sock_i_uid(sk2)) &&
 		    (!sk2->sk_bound_dev_if || !sk->sk_bound_dev_if ||
 		     sk2->sk_bound_dev_if == sk->sk_bound_dev_if) &&
 		    (*saddr_comp)(sk, sk2)) {
@@ -169,6 +174,7 @@ static int udp_lib_lport_inuse2(struct net *net, __u16 num,
 {
 	struct sock *sk2;
 	struct hlist_nulls_node *node;
+	int uid = sock_i_uid(sk);
 	int res = 0;
 
 	spin_lock(&hslot2->lock);
@@ -177,6 +183,8 @@ static int udp_lib_lport_inuse2(struct net *net, __u16 num,
 		    sk2 != sk &&
 		    (udp_sk(sk2)->udp_port_hash == num) &&
 		    (!sk2->sk_reuse || !sk->sk_reuse) &&
+		    (!sk2->sk_reuseport || !sk->sk_reuseport ||
+		     uid != sock_i_uid(sk2)) &&
 		    (!sk2->sk_bound_dev_if || !sk->sk_bound_dev_if ||
 		     sk2->sk_bound_dev_if == sk->sk_bound_dev_if) &&
 		    (*saddr_comp)(sk, sk2)) {
@@ -409,7 +417,8 @@ static struct sock *udp4_lib_lookup2(struct net *net,
 {
 	struct sock *sk, *result;
 	struct hlist_nulls_node *node;
-	int score, badness;
+	int score, badness, matches = 0, reuseport = 0;
+	u32 hash = 0;
 
 begin:
 	result = NULL;
@@ -420,8 +429,18 @@ begin:
 		if (score > badness) {
 			result = sk;
 			badness = score;
-			if (score == SCORE2_MAX)
+			reuseport = sk->sk_reuseport;
+			if (reuseport) {
+				hash = inet_ehashfn(net, daddr, hnum,
+						    saddr, sport);
+				matches = 1;
+			} else if (score == SCORE2_MAX)
 				goto exact_match;
+		} else if (score == badness && reuseport) {
+			matches++;
+			if (((u64)hash * matches) >> 32 == 0)
+				result = sk;
+			hash = next_pseudo_random32(hash);
 		}
 	}
 	/*
@@ -457,7 +476,8 @@ struct sock *__udp4_lib_lookup(struct net *net, __be32 saddr,
 	unsigned short hnum = ntohs(dport);
 	unsigned int hash2, slot2, slot = udp_hashfn(net, hnum, udptable->mask);
 	struct udp_hslot *hslot2, *hslot = &udptable->hash[slot];
-	int score, badness;
+	int score, badness, matches = 0, reuseport = 0;
+	u32 hash = 0;
 
 	rcu_read_lock();
 	if (hslot->count > 10) {
@@ -493,6 +513,22 @@ begin:
 		if (score > badness) {
 			result = sk;
 			badness = score;
+			reuseport = sk->sk_reuseport;
+			if (reuseport) {
+				hash = inet_ehashfn(net, daddr, hnum,
+						    saddr, sport);
+				matches = 1;
+			}
+		} else if (score == badness && reuseport) {
+			/*
+			 * Pick among the equally good SO_REUSEPORT sockets
+			 * by flow hash, each with the same probability, as
+			 * __inet_lookup_listener() does for TCP.
+			 */
+			matches++;
+			if (((u64)hash * matches) >> 32 == 0)
+				result = sk;
+			hash = next_pseudo_random32(hash);
 		}
 	}
 	/*
@@ -1373,6 +1409,7 @@ static int __udp_queue_rcv_skb(struct sock *sk, struct sk_buff *skb)
 
 	if (inet_sk(sk)->inet_daddr)
 		sock_rps_save_rxhash(sk, skb);
+	sk_mark_napi_id(sk, skb);
 
 	rc = sock_queue_rcv_skb(sk, skb);
 	if (rc < 0) {
@@ -2261,6 +2298,215 @@ int udp4_ufo_send_check(struct sk_buff *skb)
 	return 0;
 }
 
+static DEFINE_SPINLOCK(udp_offload_lock);
+static LIST_HEAD(udp_offload_base);
+
+/* Caller holds rcu_read_lock() or udp_offload_lock */
+static struct udp_offload *udp_offload_lookup(__be16 port)
+{
+	struct udp_offload *uo;
+
+	list_for_each_entry_rcu(uo, &udp_offload_base, list)
+		if (uo->port == port)
+			return uo;
+	return NULL;
+}
+
+int udp_add_offload(struct udp_offload *uo)
+{
+	int err = 0;
+
+	spin_lock(&udp_offload_lock);
+	if (udp_offload_lookup(uo->port))
+		err = -EEXIST;
+	else
+		list_add_rcu(&uo->list, &udp_offload_base);
+	spin_unlock(&udp_offload_lock);
+	return err;
+}
+EXPORT_SYMBOL_GPL(udp_add_offload);
+
+void udp_del_offload(struct udp_offload *uo)
+{
+	spin_lock(&udp_offload_lock);
+	list_del_rcu(&uo->list);
+	spin_unlock(&udp_offload_lock);
+	synchronize_net();
+}
+EXPORT_SYMBOL_GPL(udp_del_offload);
+
+static unsigned int udp_tunnel_max_hlen(const struct udp_offload *uo)
+{
+	unsigned int hlen = sizeof(struct udphdr) + uo->hlen;
+
+	if (uo->inner_proto == htons(ETH_P_TEB))
+		hlen += ETH_HLEN;
+	return hlen;
+}
+
+/*
+ * Length of the UDP, tunnel and inner Ethernet headers at @uh, and the
+ * protocol of the inner network header.  All of them must be in the
+ * linear area.
+ */
+static unsigned int udp_tunnel_hlen(const struct udp_offload *uo,
+				    const struct udphdr *uh, __be16 *type)
+{
+	unsigned int hlen = sizeof(*uh) + uo->hlen;
+
+	*type = uo->inner_proto;
+	if (*type == htons(ETH_P_TEB)) {
+		*type = ((const struct ethhdr *)((const u8 *)uh + hlen))->h_proto;
+		hlen += ETH_HLEN;
+	}
+	return hlen;
+}
+
+struct sk_buff **udp4_gro_receive(struct sk_buff **head, struct sk_buff *skb)
+{
+	struct sk_buff **pp = NULL;
+	struct packet_type *ptype;
+	struct udp_offload *uo;
+	struct udphdr *uh;
+	struct sk_buff *p;
+	unsigned int off, hlen;
+	int ip_summed;
+	__wsum csum;
+	__be16 type;
+	int flush = 1;
+
+	/* Tunnels are not aggregated inside other tunnels */
+	if (NAPI_GRO_CB(skb)->encap_mark)
+		goto out;
+	NAPI_GRO_CB(skb)->encap_mark = 1;
+
+	off = skb_gro_offset(skb);
+	hlen = off + sizeof(*uh);
+	uh = skb_gro_header_fast(skb, off);
+	if (skb_gro_header_hard(skb, hlen)) {
+		uh = skb_gro_header_slow(skb, hlen, off);
+		if (unlikely(!uh))
+			goto out;
+	}
+
+	/* A merged datagram would need a new checksum, and padding
+	 * would end up in the middle of it.
+	 */
+	if (uh->check || ntohs(uh->len) != skb_gro_len(skb))
+		goto out;
+
+	rcu_read_lock();
+	uo = udp_offload_lookup(uh->dest);
+	if (!uo)
+		goto out_unlock;
+
+	hlen = off + udp_tunnel_max_hlen(uo);
+	if (skb_gro_header_hard(skb, hlen)) {
+		uh = skb_gro_header_slow(skb, hlen, off);
+		if (unlikely(!uh))
+			goto out_unlock;
+	}
+	hlen = udp_tunnel_hlen(uo, uh, &type);
+
+	ptype = gro_find_receive_by_type(type);
+	if (!ptype)
+		goto out_unlock;
+
+	flush = 0;
+
+	for (p = *head; p; p = p->next) {
+		const struct udphdr *uh2;
+
+		if (!NAPI_GRO_CB(p)->same_flow)
+			continue;
+
+		/* Same ports and the same tunnel and inner MAC headers */
+		uh2 = (struct udphdr *)(p->data + off);
+		if (*(u32 *)&uh->source != *(u32 *)&uh2->source ||
+		    memcmp(uh + 1, uh2 + 1, hlen - sizeof(*uh))) {
+			NAPI_GRO_CB(p)->same_flow = 0;
+			continue;
+		}
+	}
+
+	skb_gro_pull(skb, hlen);
+
+	/* The inner layers validate against a checksum of the inner packet */
+	ip_summed = skb->ip_summed;
+	csum = skb->csum;
+	skb_gro_encap_rcsum(skb, uh, hlen);
+
+	pp = ptype->gro_receive(head, skb);
+
+	if (skb->ip_summed == CHECKSUM_COMPLETE)
+		skb->ip_summed = ip_summed;
+	skb->csum = csum;
+
+out_unlock:
+	rcu_read_unlock();
+out:
+	NAPI_GRO_CB(skb)->flush |= flush;
+	return pp;
+}
+
+int udp4_gro_complete(struct sk_buff *skb, int nhoff)
+{
+	struct udphdr *uh = (struct udphdr *)(skb->data + nhoff);
+	struct packet_type *ptype;
+	struct udp_offload *uo;
+	unsigned int hlen;
+	__be16 type;
+	int err = -ENOENT;
+
+	uh->len = htons(skb->len - nhoff);
+
+	rcu_read_lock();
+	uo = udp_offload_lookup(uh->dest);
+	if (uo) {
+		hlen = udp_tunnel_hlen(uo, uh, &type);
+		ptype = gro_find_complete_by_type(type);
+		if (ptype)
+			err = ptype->gro_complete(skb, nhoff + hlen);
+	}
+	rcu_read_unlock();
+
+	if (!err)
+		skb_shinfo(skb)->gso_type |= SKB_GSO_UDP_TUNNEL;
+	return err;
+}
+
+/*
+ * Segment the inner packet of a datagram built by udp4_gro_receive(),
+ * with data at the UDP header.  Each segment keeps a zero UDP checksum.
+ */
+static struct sk_buff *udp4_tunnel_segment(struct sk_buff *skb,
+					   netdev_features_t features)
+{
+	struct sk_buff *segs = ERR_PTR(-EINVAL);
+	struct udp_offload *uo;
+	unsigned int hlen;
+	__be16 type;
+
+	if (!pskb_may_pull(skb, sizeof(struct udphdr)))
+		goto out;
+
+	rcu_read_lock();
+	uo = udp_offload_lookup(udp_hdr(skb)->dest);
+	if (uo && pskb_may_pull(skb, udp_tunnel_max_hlen(uo))) {
+		hlen = udp_tunnel_hlen(uo, udp_hdr(skb), &type);
+		segs = skb_encap_gso_segment(skb, features, hlen, type);
+	}
+	rcu_read_unlock();
+
+	if (IS_ERR_OR_NULL(segs))
+		goto out;
+
+	for (skb = segs; skb; skb = skb->next)
+		udp_hdr(skb)->len = htons(skb->len - skb_transport_offset(skb));
+out:
+	return segs;
+}
+
 struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb,
 	netdev_features_t features)
 {
@@ -2269,6 +2515,9 @@ struct sk_buff *udp4_ufo_fragment(struct sk_buff *skb,
 	int offset;
 	__wsum csum;
 
+	if (skb_shinfo(skb)->gso_type & SKB_GSO_UDP_TUNNEL)
+		return udp4_tunnel_segment(skb, features);
+
 	mss = skb_shinfo(skb)->gso_size;
 	if (unlikely(skb->len <= mss))
 		goto out;
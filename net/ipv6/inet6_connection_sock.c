@@ -16,13 +16,13 @@
 #include <linux/module.h>
 #include <linux/in6.h>
 #include <linux/ipv6.h>
-#include <linux/jhash.h>
 #include <linux/slab.h>
 
 #include <net/addrconf.h>
 #include <net/inet_connection_sock.h>
 #include <net/inet_ecn.h>
 #include <net/inet_hashtables.h>
+#include <net/inet6_hashtables.h>
 #include <net/ip6_route.h>
 #include <net/sock.h>
 #include <net/inet6_connection_sock.h>
@@ -32,6 +32,9 @@ int inet6_csk_bind_conflict(const struct sock *sk,
 {
 	const struct sock *sk2;
 	const struct hlist_node *node;
+	int reuse = sk->sk_reuse;
+	int reuseport = sk->sk_reuseport;
+	int uid = sock_i_uid((struct sock *)sk);
 
 	/* We must walk the whole port owner list in this case. -DaveM */
 	/*
@@ -43,8 +46,11 @@ int inet6_csk_bind_conflict(const struct sock *sk,
 		    (!sk->sk_bound_dev_if ||
 		     !sk2->sk_bound_dev_if ||
 		     sk->sk_bound_dev_if == sk2->sk_bound_dev_if) &&
-		    (!sk->sk_reuse || !sk2->sk_reuse ||
+		    (!reuse || !sk2->sk_reuse ||
 		     sk2->sk_state == TCP_LISTEN) &&
+		    (!reuseport || !sk2->sk_reuseport ||
+		     (sk2->sk_state != TCP_TIME_WAIT &&
+		      uid != sock_i_uid((struct sock *)sk2))) &&
 		     ipv6_rcv_saddr_equal(sk, sk2))
 			break;
 	}
@@ -84,53 +90,27 @@ struct dst_entry *inet6_csk_route_req(struct sock *sk,
 /*
  * request_sock (formerly open request) hash tables.
  */
-static u32 inet6_synq_hash(const struct in6_addr *raddr, const __be16 rport,
-			   const u32 rnd, const u32 synq_hsize)
-{
-	u32 c;
-
-	c = jhash_3words((__force u32)raddr->s6_addr32[0],
-			 (__force u32)raddr->s6_addr32[1],
-			 (__force u32)raddr->s6_addr32[2],
-			 rnd);
-
-	c = jhash_2words((__force u32)raddr->s6_addr32[3],
-			 (__force u32)rport,
-			 c);
-
-	return c & (synq_hsize - 1);
-}
-
-struct request_sock *inet6_csk_search_req(const struct sock *sk,
-					  struct request_sock ***prevp,
+/* Returns the request with a reference held, see inet_csk_search_req() */
+struct request_sock *inet6_csk_search_req(struct sock *sk,
 					  const __be16 rport,
 					  const struct in6_addr *raddr,
 					  const struct in6_addr *laddr,
 					  const int iif)
 {
-	const struct inet_connection_sock *icsk = inet_csk(sk);
-	struct listen_sock *lopt = icsk->icsk_accept_queue.listen_opt;
-	struct request_sock *req, **prev;
-
-	for (prev = &lopt->syn_table[inet6_synq_hash(raddr, rport,
-						     lopt->hash_rnd,
-						     lopt->nr_table_entries)];
-	     (req = *prev) != NULL;
-	     prev = &req->dl_next) {
-		const struct inet6_request_sock *treq = inet6_rsk(req);
-
-		if (inet_rsk(req)->rmt_port == rport &&
-		    req->rsk_ops->family == AF_INET6 &&
-		    ipv6_addr_equal(&treq->rmt_addr, raddr) &&
-		    ipv6_addr_equal(&treq->loc_addr, laddr) &&
-		    (!treq->iif || treq->iif == iif)) {
-			WARN_ON(req->sk != NULL);
-			*prevp = prev;
-			return req;
-		}
+	struct request_sock *req;
+
+	req = __inet6_lookup_reqsk(sock_net(sk), sk->sk_prot->h.hashinfo,
+				   raddr, rport, laddr, inet_sk(sk)->inet_num,
+				   iif);
+	if (req && req->rsk_listener != sk) {
+		if (req->rsk_listener->sk_state != TCP_LISTEN)
+			inet_csk_reqsk_queue_drop_and_put(req->rsk_listener,
+							  req);
+		else
+			reqsk_put(req);
+		req = NULL;
 	}
-
-	return NULL;
+	return req;
 }
 
 EXPORT_SYMBOL_GPL(inet6_csk_search_req);
@@ -139,14 +119,12 @@ void inet6_csk_reqsk_queue_hash_add(struct sock *sk,
 				    struct request_sock *req,
 				    const unsigned long timeout)
 {
-	struct inet_connection_sock *icsk = inet_csk(sk);
-	struct listen_sock *lopt = icsk->icsk_accept_queue.listen_opt;
-	const u32 h = inet6_synq_hash(&inet6_rsk(req)->rmt_addr,
-				      inet_rsk(req)->rmt_port,
-				      lopt->hash_rnd, lopt->nr_table_entries);
-
-	reqsk_queue_hash_req(&icsk->icsk_accept_queue, h, req, timeout);
-	inet_csk_reqsk_queue_added(sk, timeout);
+	const struct inet6_request_sock *treq = inet6_rsk(req);
+
+	req->rsk_hash = inet6_ehashfn(sock_net(sk), &treq->loc_addr,
+				      ntohs(inet_rsk(req)->loc_port),
+				      &treq->rmt_addr, inet_rsk(req)->rmt_port);
+	__inet_csk_reqsk_queue_hash_add(sk, req, timeout);
 }
 
 EXPORT_SYMBOL_GPL(inet6_csk_reqsk_queue_hash_add);
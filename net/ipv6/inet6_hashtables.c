@@ -59,6 +59,13 @@ int __inet6_hash(struct sock *sk, struct inet_timewait_sock *tw)
 }
 EXPORT_SYMBOL(__inet6_hash);
 
+bool inet6_ehash_nolisten(struct sock *sk, struct request_sock *req)
+{
+	sk->sk_hash = inet6_sk_ehashfn(sk);
+	return __inet_ehash_nolisten(sk, req);
+}
+EXPORT_SYMBOL_GPL(inet6_ehash_nolisten);
+
 /*
  * Sockets in TCP_CLOSE state are _always_ taken out of the hash, so
  * we need not check it for TCP lookups anymore, thanks Alexey. -DaveM
@@ -125,6 +132,64 @@ out:
 }
 EXPORT_SYMBOL(__inet6_lookup_established);
 
+static inline bool inet6_reqsk_match(const struct request_sock *req,
+				     unsigned int hash,
+				     const struct in6_addr *saddr,
+				     const __be16 sport,
+				     const struct in6_addr *daddr,
+				     const u16 hnum, const int dif)
+{
+	const struct inet6_request_sock *treq = inet6_rsk(req);
+	const struct inet_request_sock *ireq = inet_rsk(req);
+
+	return req->rsk_hash == hash &&
+	       req->rsk_ops->family == AF_INET6 &&
+	       ireq->rmt_port == sport && ntohs(ireq->loc_port) == hnum &&
+	       ipv6_addr_equal(&treq->rmt_addr, saddr) &&
+	       ipv6_addr_equal(&treq->loc_addr, daddr) &&
+	       (!treq->iif || treq->iif == dif);
+}
+
+/* IPv6 counterpart of __inet_lookup_reqsk() */
+struct request_sock *__inet6_lookup_reqsk(struct net *net,
+					  struct inet_hashinfo *hashinfo,
+					  const struct in6_addr *saddr,
+					  const __be16 sport,
+					  const struct in6_addr *daddr,
+					  const u16 hnum,
+					  const int dif)
+{
+	unsigned int hash = inet6_ehashfn(net, daddr, hnum, saddr, sport);
+	unsigned int slot = hash & hashinfo->ehash_mask;
+	struct inet_ehash_bucket *head = &hashinfo->ehash[slot];
+	const struct hlist_nulls_node *node;
+	struct request_sock *req;
+
+	rcu_read_lock();
+begin:
+	hlist_nulls_for_each_entry_rcu(req, node, &head->reqchain, rsk_node) {
+		if (inet6_reqsk_match(req, hash, saddr, sport,
+				      daddr, hnum, dif)) {
+			if (unlikely(!atomic_inc_not_zero(&req->rsk_refcnt)))
+				goto begin;
+			if (unlikely(!inet6_reqsk_match(req, hash, saddr, sport,
+							daddr, hnum, dif) ||
+				     !net_eq(sock_net(req->rsk_listener), net))) {
+				reqsk_put(req);
+				goto begin;
+			}
+			goto out;
+		}
+	}
+	if (get_nulls_value(node) != slot)
+		goto begin;
+	req = NULL;
+out:
+	rcu_read_unlock();
+	return req;
+}
+EXPORT_SYMBOL_GPL(__inet6_lookup_reqsk);
+
 static inline int compute_score(struct sock *sk, struct net *net,
 				const unsigned short hnum,
 				const struct in6_addr *daddr,
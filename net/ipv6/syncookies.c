@@ -52,11 +52,16 @@ static inline struct sock *get_cookie_sock(struct sock *sk, struct sk_buff *skb,
 	struct sock *child;
 
 	child = icsk->icsk_af_ops->syn_recv_sock(sk, skb, req, dst);
-	if (child)
-		inet_csk_reqsk_queue_add(sk, req, child);
-	else
+	if (!child) {
 		reqsk_free(req);
-
+		return NULL;
+	}
+	if (!inet_csk_reqsk_queue_add(sk, req, child)) {
+		/* The listener was closed meanwhile */
+		bh_unlock_sock(child);
+		sock_put(child);
+		return NULL;
+	}
 	return child;
 }
 
@@ -223,6 +228,7 @@ struct sock *cookie_v6_check(struct sock *sk, struct sk_buff *skb)
 	treq->snt_synack	= tcp_opt.saw_tstamp ? tcp_opt.rcv_tsecr : 0;
 	treq->rcv_isn = ntohl(th->seq) - 1;
 	treq->snt_isn = cookie;
+	treq->listener = NULL;
 
 	/*
 	 * We need to lookup the dst_entry to get the correct window size.
@@ -72,6 +72,7 @@
 #include <net/route.h>
 #include <net/pkt_cls.h>
 #include <net/sock.h>
+#include <net/inet_connection_sock.h>
 
 struct meta_obj {
 	unsigned long		value;
@@ -422,10 +423,24 @@ META_COLLECTOR(int_sk_err_qlen)
 	dst->value = skb->sk->sk_error_queue.qlen;
 }
 
+/* TCP and DCCP listeners count their backlog in the accept queue */
+static inline bool meta_inet_csk_listener(const struct sock *sk)
+{
+	if (sk->sk_family != AF_INET && sk->sk_family != AF_INET6)
+		return false;
+	if (sk->sk_state != TCP_LISTEN)
+		return false;
+	return (sk->sk_type == SOCK_STREAM && sk->sk_protocol == IPPROTO_TCP) ||
+	       (sk->sk_type == SOCK_DCCP && sk->sk_protocol == IPPROTO_DCCP);
+}
+
 META_COLLECTOR(int_sk_ack_bl)
 {
 	SKIP_NONLOCAL(skb);
-	dst->value = skb->sk->sk_ack_backlog;
+	if (meta_inet_csk_listener(skb->sk))
+		dst->value = inet_csk_acceptq_len(skb->sk);
+	else
+		dst->value = skb->sk->sk_ack_backlog;
 }
 
 META_COLLECTOR(int_sk_max_ack_bl)
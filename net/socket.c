@@ -97,6 +97,7 @@
 #include <net/cls_cgroup.h>
 
 #include <net/sock.h>
+#include <net/busy_poll.h>
 #include <linux/netfilter.h>
 
 #include <linux/if_tun.h>
@@ -1097,12 +1098,23 @@ EXPORT_SYMBOL(sock_create_lite);
 static unsigned int sock_poll(struct file *file, poll_table *wait)
 {
 	struct socket *sock;
+	unsigned int mask;
 
 	/*
 	 *      We can't return errors to poll, so it's either yes or no.
 	 */
 	sock = file->private_data;
-	return sock->ops->poll(file, sock, wait);
+	mask = sock->ops->poll(file, sock, wait);
+
+	/*
+	 * Nothing to read yet and the caller is about to sleep: busy poll
+	 * sockets get to spin on their device queue first.  The second
+	 * ->poll() only reports, the wait queue is already registered.
+	 */
+	if (!(mask & POLLIN) && !poll_does_not_wait(wait) && sock->sk &&
+	    sk_can_busy_loop(sock->sk) && sk_poll_busy_loop(sock->sk))
+		mask = sock->ops->poll(file, sock, NULL);
+	return mask;
 }
 
 static int sock_mmap(struct file *file, struct vm_area_struct *vma)
@@ -3,6 +3,10 @@
 
 extern int bench_sched_messaging(int argc, const char **argv, const char *prefix);
 extern int bench_sched_pipe(int argc, const char **argv, const char *prefix);
+extern int bench_sched_latency(int argc, const char **argv, const char *prefix);
+extern int bench_sched_pingpong(int argc, const char **argv, const char *prefix);
+extern int bench_sched_fork(int argc, const char **argv, const char *prefix);
+extern int bench_sched_fairness(int argc, const char **argv, const char *prefix);
 extern int bench_mem_memcpy(int argc, const char **argv, const char *prefix __used);
 extern int bench_mem_memset(int argc, const char **argv, const char *prefix);
 
@@ -0,0 +1,339 @@
+/*
+ *
+ * sched-fairness.c
+ *
+ * fairness: Benchmark for weighted CPU fairness
+ *
+ * Groups of CPU-bound and IO-bound processes with different weights
+ * compete for one CPU.  The weights are applied as cpu.shares of one
+ * cgroup per group when a cpu controller mount is given, and as nice
+ * levels otherwise.  The CPU time each group received is compared with
+ * its weighted share, and the IO-bound processes report how late they
+ * woke up.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define MAX_GROUPS 32
+
+static const char *weight_list = "1024,512";
+static const char *cgroup_root;
+static unsigned int nr_hogs = 2;
+static unsigned int nr_io;
+static unsigned int runtime = 5;
+static unsigned int io_usecs = 1000;
+static bool all_cpus;
+
+static const struct option options[] = {
+	OPT_STRING('w', "weights", &weight_list, "w,w,...",
+		   "Specify one weight per group (default: 1024,512)"),
+	OPT_STRING('G', "cgroup", &cgroup_root, "path",
+		   "Use cgroups under this cpu controller mount"),
+	OPT_UINTEGER('n', "hogs", &nr_hogs,
+		     "Specify number of CPU-bound processes per group"),
+	OPT_UINTEGER('i', "io", &nr_io,
+		     "Specify number of IO-bound processes per group"),
+	OPT_UINTEGER('u', "io-usecs", &io_usecs,
+		     "Specify usecs IO-bound processes run and sleep per cycle"),
+	OPT_UINTEGER('r', "runtime", &runtime,
+		     "Specify runtime in seconds"),
+	OPT_BOOLEAN('a', "all-cpus", &all_cpus,
+		    "Do not bind everything to a single CPU"),
+	OPT_END()
+};
+
+static const char * const bench_sched_fairness_usage[] = {
+	"perf bench sched fairness <options>",
+	NULL
+};
+
+struct fair_task {
+	unsigned int		group;
+	bool			io;
+	pid_t			pid;
+	unsigned long long	cpu_ns;
+	unsigned long		io_cycles;
+	unsigned long long	io_late_ns;
+	unsigned long long	io_late_max_ns;
+};
+
+struct fair_shared {
+	volatile int		start;
+	volatile int		stop;
+	struct fair_task	tasks[];
+};
+
+static unsigned long weights[MAX_GROUPS];
+static unsigned int nr_groups;
+static int bind_cpu = -1;
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+static unsigned long long clock_ns(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void parse_weights(void)
+{
+	const char *p = weight_list;
+	char *end;
+
+	while (*p) {
+		unsigned long w = strtoul(p, &end, 0);
+
+		if (end == p || !w || nr_groups == MAX_GROUPS)
+			usage_with_options(bench_sched_fairness_usage, options);
+		weights[nr_groups++] = w;
+		p = end;
+		if (*p == ',')
+			p++;
+		else if (*p)
+			usage_with_options(bench_sched_fairness_usage, options);
+	}
+	if (nr_groups < 2)
+		usage_with_options(bench_sched_fairness_usage, options);
+}
+
+static void cgroup_path(char *buf, size_t size, unsigned int group,
+			const char *file)
+{
+	snprintf(buf, size, "%s/perf-bench-%d-%u%s%s", cgroup_root,
+		 (int)getpid(), group, file ? "/" : "", file ? file : "");
+}
+
+static void write_file(const char *path, unsigned long val)
+{
+	FILE *fp = fopen(path, "w");
+
+	if (!fp || fprintf(fp, "%lu\n", val) < 0 || fclose(fp))
+		barf(path);
+}
+
+/* Nice level whose load weight is closest to @w relative to the max */
+static int weight_to_nice(unsigned long w, unsigned long max)
+{
+	double nice = floor(log((double)max / w) / log(1.25) + 0.5);
+
+	return nice > 19 ? 19 : (int)nice;
+}
+
+static void run_task(struct fair_shared *shm, struct fair_task *t,
+		     pid_t parent, unsigned long max_weight)
+{
+	unsigned long long start;
+
+	if (cgroup_root) {
+		char path[PATH_MAX];
+
+		snprintf(path, sizeof(path), "%s/perf-bench-%d-%u/tasks",
+			 cgroup_root, (int)parent, t->group);
+		write_file(path, getpid());
+	} else if (setpriority(PRIO_PROCESS, 0,
+			       weight_to_nice(weights[t->group], max_weight))) {
+		barf("setpriority");
+	}
+
+	if (bind_cpu >= 0) {
+		cpu_set_t mask;
+
+		CPU_ZERO(&mask);
+		CPU_SET(bind_cpu, &mask);
+		if (sched_setaffinity(0, sizeof(mask), &mask))
+			barf("sched_setaffinity");
+	}
+
+	while (!shm->start)
+		usleep(1000);
+
+	start = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+	while (!shm->stop) {
+		unsigned long long end, late;
+
+		if (!t->io)
+			continue;
+
+		end = clock_ns(CLOCK_MONOTONIC) + io_usecs * 1000ULL;
+		while (clock_ns(CLOCK_MONOTONIC) < end)
+			;
+		usleep(io_usecs);
+		late = clock_ns(CLOCK_MONOTONIC) - end - io_usecs * 1000ULL;
+		t->io_cycles++;
+		t->io_late_ns += late;
+		if (late > t->io_late_max_ns)
+			t->io_late_max_ns = late;
+	}
+	t->cpu_ns = clock_ns(CLOCK_PROCESS_CPUTIME_ID) - start;
+	_exit(0);
+}
+
+int bench_sched_fairness(int argc, const char **argv,
+			 const char *prefix __used)
+{
+	unsigned long long group_ns[MAX_GROUPS], total_ns = 0;
+	unsigned long long late_ns[MAX_GROUPS], late_max[MAX_GROUPS];
+	unsigned long cycles[MAX_GROUPS];
+	unsigned long max_weight = 0, weight_sum = 0;
+	unsigned int per_group, nr_tasks, g, i;
+	double sum = 0, sum_sq = 0, jain;
+	struct fair_shared *shm;
+	char path[PATH_MAX];
+	size_t size;
+
+	argc = parse_options(argc, argv, options,
+			     bench_sched_fairness_usage, 0);
+	parse_weights();
+	per_group = nr_hogs + nr_io;
+	if (!per_group || !runtime || !io_usecs)
+		usage_with_options(bench_sched_fairness_usage, options);
+
+	for (g = 0; g < nr_groups; g++) {
+		weight_sum += weights[g];
+		if (weights[g] > max_weight)
+			max_weight = weights[g];
+	}
+
+	if (!all_cpus) {
+		cpu_set_t mask;
+
+		if (sched_getaffinity(0, sizeof(mask), &mask))
+			barf("sched_getaffinity");
+		for (bind_cpu = 0; !CPU_ISSET(bind_cpu, &mask); bind_cpu++)
+			;
+	}
+
+	if (cgroup_root) {
+		for (g = 0; g < nr_groups; g++) {
+			cgroup_path(path, sizeof(path), g, NULL);
+			if (mkdir(path, 0755))
+				barf(path);
+			cgroup_path(path, sizeof(path), g, "cpu.shares");
+			write_file(path, weights[g]);
+		}
+	}
+
+	nr_tasks = nr_groups * per_group;
+	size = sizeof(*shm) + nr_tasks * sizeof(shm->tasks[0]);
+	shm = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (shm == MAP_FAILED)
+		barf("mmap");
+	memset(shm, 0, size);
+
+	for (i = 0; i < nr_tasks; i++) {
+		struct fair_task *t = &shm->tasks[i];
+		pid_t parent = getpid(), pid;
+
+		t->group = i / per_group;
+		t->io = i % per_group >= nr_hogs;
+		pid = fork();
+		if (pid < 0)
+			barf("fork");
+		if (!pid)
+			run_task(shm, t, parent, max_weight);
+		t->pid = pid;
+	}
+
+	shm->start = 1;
+	sleep(runtime);
+	shm->stop = 1;
+
+	memset(group_ns, 0, sizeof(group_ns));
+	memset(late_ns, 0, sizeof(late_ns));
+	memset(late_max, 0, sizeof(late_max));
+	memset(cycles, 0, sizeof(cycles));
+	for (i = 0; i < nr_tasks; i++) {
+		struct fair_task *t = &shm->tasks[i];
+		int wait_stat;
+
+		if (waitpid(t->pid, &wait_stat, 0) != t->pid ||
+		    !WIFEXITED(wait_stat) || WEXITSTATUS(wait_stat))
+			barf("child failed");
+
+		group_ns[t->group] += t->cpu_ns;
+		total_ns += t->cpu_ns;
+		cycles[t->group] += t->io_cycles;
+		late_ns[t->group] += t->io_late_ns;
+		if (t->io_late_max_ns > late_max[t->group])
+			late_max[t->group] = t->io_late_max_ns;
+	}
+	munmap(shm, size);
+
+	if (cgroup_root) {
+		for (g = 0; g < nr_groups; g++) {
+			cgroup_path(path, sizeof(path), g, NULL);
+			rmdir(path);
+		}
+	}
+
+	/* Jain's index over received/expected share: 1.0 is perfect */
+	for (g = 0; g < nr_groups; g++) {
+		double x = total_ns ? ((double)group_ns[g] / total_ns) /
+				      ((double)weights[g] / weight_sum) : 0;
+
+		sum += x;
+		sum_sq += x * x;
+	}
+	jain = sum_sq ? sum * sum / (nr_groups * sum_sq) : 0;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %u groups of %u CPU-bound and %u IO-bound processes,"
+		       " %s, %s, %u sec\n\n", nr_groups, nr_hogs, nr_io,
+		       cgroup_root ? "cpu.shares" : "nice levels",
+		       bind_cpu >= 0 ? "one CPU" : "all CPUs", runtime);
+		printf(" %5s %8s %10s %10s %14s %14s\n", "group", "weight",
+		       "expected", "received", "io late avg", "io late max");
+		for (g = 0; g < nr_groups; g++) {
+			printf(" %5u %8lu %9.2f%% %9.2f%%", g, weights[g],
+			       100.0 * weights[g] / weight_sum,
+			       total_ns ? 100.0 * group_ns[g] / total_ns : 0);
+			if (cycles[g])
+				printf(" %9.1f usec %9.1f usec\n",
+				       late_ns[g] / 1000.0 / cycles[g],
+				       late_max[g] / 1000.0);
+			else
+				printf(" %14s %14s\n", "-", "-");
+		}
+		printf("\n %14.4f fairness index\n", jain);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%.4f\n", jain);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
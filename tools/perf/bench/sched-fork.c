@@ -0,0 +1,149 @@
+/*
+ *
+ * sched-fork.c
+ *
+ * fork: Benchmark for task creation and exit
+ *
+ * A number of threads concurrently create and reap short lived
+ * children, either processes (fork/exit/wait) or threads
+ * (pthread_create/exit/join).
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+static unsigned int nr_threads;
+static unsigned int loops = 1000;
+static bool thread_mode;
+
+static const struct option options[] = {
+	OPT_UINTEGER('t', "threads", &nr_threads,
+		     "Specify number of forking threads (default: nr CPUs)"),
+	OPT_UINTEGER('l', "loop", &loops,
+		     "Specify number of children created by each thread"),
+	OPT_BOOLEAN('T', "thread-mode", &thread_mode,
+		    "Create threads instead of processes"),
+	OPT_END()
+};
+
+static const char * const bench_sched_fork_usage[] = {
+	"perf bench sched fork <options>",
+	NULL
+};
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+static void *child_thread(void *arg __used)
+{
+	return NULL;
+}
+
+static void *forker_thread(void *arg __used)
+{
+	unsigned int i;
+
+	for (i = 0; i < loops; i++) {
+		if (thread_mode) {
+			pthread_t child;
+
+			if (pthread_create(&child, NULL, child_thread, NULL))
+				barf("pthread_create");
+			pthread_join(child, NULL);
+		} else {
+			int wait_stat;
+			pid_t pid = fork();
+
+			if (pid < 0)
+				barf("fork");
+			if (!pid)
+				_exit(0);
+			if (waitpid(pid, &wait_stat, 0) != pid)
+				barf("waitpid");
+		}
+	}
+	return NULL;
+}
+
+int bench_sched_fork(int argc, const char **argv,
+		     const char *prefix __used)
+{
+	struct timeval start, stop, diff;
+	unsigned long long result_usec, total;
+	pthread_t *threads;
+	unsigned int i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_sched_fork_usage, 0);
+	if (!nr_threads)
+		nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (!loops)
+		usage_with_options(bench_sched_fork_usage, options);
+
+	threads = calloc(nr_threads, sizeof(*threads));
+	if (!threads)
+		barf("calloc");
+
+	gettimeofday(&start, NULL);
+
+	for (i = 0; i < nr_threads; i++)
+		if (pthread_create(&threads[i], NULL, forker_thread, NULL))
+			barf("pthread_create");
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+	free(threads);
+
+	total = (unsigned long long)nr_threads * loops;
+	result_usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %u threads each created %u %s\n\n",
+		       nr_threads, loops, thread_mode ? "threads" : "processes");
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec/1000));
+
+		printf(" %14lf usecs/op\n",
+		       (double)result_usec / (double)total);
+		printf(" %14d ops/sec\n",
+		       (int)((double)total /
+			     ((double)result_usec / (double)1000000)));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lu.%03lu\n",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec / 1000));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
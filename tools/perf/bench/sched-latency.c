@@ -0,0 +1,295 @@
+/*
+ *
+ * sched-latency.c
+ *
+ * latency: Benchmark for wakeup latency
+ *
+ * Modelled after schbench: message threads repeatedly wake groups of
+ * worker threads, and every worker records how long it took from the
+ * wakeup until it actually ran, in a latency histogram.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+
+static unsigned int nr_message_threads = 2;
+static unsigned int nr_workers = 16;
+static unsigned int runtime = 5;
+static unsigned int think_usecs = 30;
+static unsigned int sleep_usecs;
+
+static const struct option options[] = {
+	OPT_UINTEGER('m', "message-threads", &nr_message_threads,
+		     "Specify number of message threads"),
+	OPT_UINTEGER('t', "threads", &nr_workers,
+		     "Specify number of worker threads per message thread"),
+	OPT_UINTEGER('r', "runtime", &runtime,
+		     "Specify runtime in seconds"),
+	OPT_UINTEGER('c', "cputime", &think_usecs,
+		     "Specify usecs each worker spins after a wakeup"),
+	OPT_UINTEGER('s', "sleeptime", &sleep_usecs,
+		     "Specify usecs a message thread sleeps between rounds"),
+	OPT_END()
+};
+
+static const char * const bench_sched_latency_usage[] = {
+	"perf bench sched latency <options>",
+	NULL
+};
+
+/*
+ * Latencies below LAT_LINEAR usecs are counted exactly, larger ones in
+ * power-of-two buckets.
+ */
+#define LAT_LINEAR_BITS	10
+#define LAT_LINEAR	(1U << LAT_LINEAR_BITS)
+#define LAT_BUCKETS	(LAT_LINEAR + 64 - LAT_LINEAR_BITS)
+
+struct worker {
+	sem_t			sem;
+	unsigned long long	wake_ns;
+	struct message_thread	*msg;
+	pthread_t		thread;
+	int			last_cpu;
+	unsigned long		nr_wakeups;
+	unsigned long		nr_migrations;
+	unsigned long long	max_usecs;
+	unsigned long		hist[LAT_BUCKETS];
+};
+
+struct message_thread {
+	sem_t			sem;
+	volatile int		pending;
+	pthread_t		thread;
+	struct worker		*workers;
+};
+
+static volatile int done;
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned int lat_bucket(unsigned long long usecs)
+{
+	unsigned int bit;
+
+	if (usecs < LAT_LINEAR)
+		return usecs;
+	bit = 63 - __builtin_clzll(usecs);
+	return LAT_LINEAR + bit - LAT_LINEAR_BITS;
+}
+
+/* Smallest latency that lands in @bucket */
+static unsigned long long lat_bucket_usecs(unsigned int bucket)
+{
+	if (bucket < LAT_LINEAR)
+		return bucket;
+	return 1ULL << (bucket - LAT_LINEAR + LAT_LINEAR_BITS);
+}
+
+static void spin_usecs(unsigned int usecs)
+{
+	unsigned long long end = now_ns() + usecs * 1000ULL;
+
+	while (now_ns() < end)
+		;
+}
+
+static void *worker_thread(void *arg)
+{
+	struct worker *w = arg;
+	struct message_thread *msg = w->msg;
+
+	while (!done) {
+		unsigned long long usecs;
+		int cpu;
+
+		while (sem_wait(&w->sem) && errno == EINTR)
+			;
+		if (done)
+			break;
+
+		usecs = (now_ns() - w->wake_ns) / 1000;
+
+		w->nr_wakeups++;
+		w->hist[lat_bucket(usecs)]++;
+		if (usecs > w->max_usecs)
+			w->max_usecs = usecs;
+		cpu = sched_getcpu();
+		if (w->last_cpu >= 0 && cpu != w->last_cpu)
+			w->nr_migrations++;
+		w->last_cpu = cpu;
+
+		spin_usecs(think_usecs);
+
+		if (!__sync_sub_and_fetch(&msg->pending, 1))
+			sem_post(&msg->sem);
+	}
+	return NULL;
+}
+
+static void *message_thread(void *arg)
+{
+	struct message_thread *msg = arg;
+	unsigned int i;
+
+	while (!done) {
+		msg->pending = nr_workers;
+
+		for (i = 0; i < nr_workers; i++) {
+			struct worker *w = &msg->workers[i];
+
+			w->wake_ns = now_ns();
+			sem_post(&w->sem);
+		}
+
+		while (sem_wait(&msg->sem) && errno == EINTR)
+			;
+		if (sleep_usecs)
+			usleep(sleep_usecs);
+	}
+	return NULL;
+}
+
+static unsigned long long percentile(unsigned long *hist, unsigned long total,
+				     double pct)
+{
+	unsigned long want = (unsigned long)(total * pct / 100.0);
+	unsigned long seen = 0;
+	unsigned int i;
+
+	for (i = 0; i < LAT_BUCKETS; i++) {
+		seen += hist[i];
+		if (seen > want)
+			return lat_bucket_usecs(i);
+	}
+	return lat_bucket_usecs(LAT_BUCKETS - 1);
+}
+
+int bench_sched_latency(int argc, const char **argv,
+			const char *prefix __used)
+{
+	static const double pcts[] = { 50, 75, 90, 95, 99, 99.5, 99.9 };
+	struct message_thread *msgs;
+	unsigned long hist[LAT_BUCKETS];
+	unsigned long wakeups = 0, migrations = 0;
+	unsigned long long max_usecs = 0;
+	unsigned int i, j, b;
+
+	argc = parse_options(argc, argv, options,
+			     bench_sched_latency_usage, 0);
+	if (!nr_message_threads || !nr_workers || !runtime)
+		usage_with_options(bench_sched_latency_usage, options);
+
+	msgs = calloc(nr_message_threads, sizeof(*msgs));
+	if (!msgs)
+		barf("calloc");
+
+	for (i = 0; i < nr_message_threads; i++) {
+		struct message_thread *msg = &msgs[i];
+
+		msg->workers = calloc(nr_workers, sizeof(*msg->workers));
+		if (!msg->workers)
+			barf("calloc");
+		if (sem_init(&msg->sem, 0, 0))
+			barf("sem_init");
+		for (j = 0; j < nr_workers; j++) {
+			struct worker *w = &msg->workers[j];
+
+			if (sem_init(&w->sem, 0, 0))
+				barf("sem_init");
+			w->msg = msg;
+			w->last_cpu = -1;
+			if (pthread_create(&w->thread, NULL, worker_thread, w))
+				barf("pthread_create");
+		}
+	}
+	for (i = 0; i < nr_message_threads; i++)
+		if (pthread_create(&msgs[i].thread, NULL, message_thread,
+				   &msgs[i]))
+			barf("pthread_create");
+
+	sleep(runtime);
+	done = 1;
+
+	/* Unblock everyone: the extra posts are harmless once done is set */
+	for (i = 0; i < nr_message_threads; i++) {
+		struct message_thread *msg = &msgs[i];
+
+		sem_post(&msg->sem);
+		for (j = 0; j < nr_workers; j++)
+			sem_post(&msg->workers[j].sem);
+	}
+
+	memset(hist, 0, sizeof(hist));
+	for (i = 0; i < nr_message_threads; i++) {
+		struct message_thread *msg = &msgs[i];
+
+		pthread_join(msg->thread, NULL);
+		for (j = 0; j < nr_workers; j++) {
+			struct worker *w = &msg->workers[j];
+
+			pthread_join(w->thread, NULL);
+			for (b = 0; b < LAT_BUCKETS; b++)
+				hist[b] += w->hist[b];
+			wakeups += w->nr_wakeups;
+			migrations += w->nr_migrations;
+			if (w->max_usecs > max_usecs)
+				max_usecs = w->max_usecs;
+		}
+		free(msg->workers);
+	}
+	free(msgs);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %u message threads, %u workers each, %u sec\n\n",
+		       nr_message_threads, nr_workers, runtime);
+		printf(" Wakeup latency percentiles (usec):\n");
+		for (i = 0; i < ARRAY_SIZE(pcts); i++)
+			printf(" %13.1fth: %llu\n", pcts[i],
+			       percentile(hist, wakeups, pcts[i]));
+		printf(" %14s: %llu\n\n", "max", max_usecs);
+		printf(" %14lu wakeups/sec\n", wakeups / runtime);
+		printf(" %14.2f %% of wakeups migrated\n",
+		       wakeups ? 100.0 * migrations / wakeups : 0.0);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%llu\n", percentile(hist, wakeups, 99));
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
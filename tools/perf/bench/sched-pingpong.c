@@ -0,0 +1,275 @@
+/*
+ *
+ * sched-pingpong.c
+ *
+ * pingpong: Benchmark for cross-CPU wakeups
+ *
+ * Two threads, bound to two CPUs that by default do not share a last
+ * level cache, hand a token back and forth, either sleeping on a
+ * semaphore in between or busy waiting for it.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../util/cpumap.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#define LOOPS_DEFAULT 100000
+static int loops = LOOPS_DEFAULT;
+static const char *cpu_list;
+static bool spin;
+
+static const struct option options[] = {
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of round trips"),
+	OPT_STRING('C', "cpus", &cpu_list, "cpu,cpu",
+		   "Specify the two CPUs to run on (default: across LLCs)"),
+	OPT_BOOLEAN('s', "spin", &spin,
+		    "Busy wait for the token instead of sleeping"),
+	OPT_END()
+};
+
+static const char * const bench_sched_pingpong_usage[] = {
+	"perf bench sched pingpong <options>",
+	NULL
+};
+
+/* Spinning: even values are ping's turn, odd values pong's turn */
+static volatile int token;
+
+struct player {
+	int		cpu;
+	int		parity;
+	sem_t		sem;
+	struct player	*peer;
+	pthread_t	thread;
+};
+
+static void barf(const char *msg)
+{
+	fprintf(stderr, "%s (error: %s)\n", msg, strerror(errno));
+	exit(1);
+}
+
+static void *player_thread(void *arg)
+{
+	struct player *p = arg;
+	cpu_set_t mask;
+	int i, t;
+
+	CPU_ZERO(&mask);
+	CPU_SET(p->cpu, &mask);
+	if (sched_setaffinity(0, sizeof(mask), &mask))
+		barf("sched_setaffinity");
+
+	for (i = 0; i < loops; i++) {
+		if (spin) {
+			while (((t = token) & 1) != p->parity)
+				;
+			token = t + 1;
+		} else {
+			while (sem_wait(&p->sem) && errno == EINTR)
+				;
+			sem_post(&p->peer->sem);
+		}
+	}
+	return NULL;
+}
+
+/* CPUs sharing the highest level cache of @cpu, as listed in sysfs */
+static struct cpu_map *llc_siblings(int cpu)
+{
+	char path[PATH_MAX], buf[BUFSIZ];
+	int idx, level, best = -1;
+	struct cpu_map *map = NULL;
+	FILE *fp;
+
+	for (idx = 0; ; idx++) {
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/cpu/cpu%d/cache/index%d/level",
+			 cpu, idx);
+		fp = fopen(path, "r");
+		if (!fp)
+			break;
+		if (fscanf(fp, "%d", &level) != 1)
+			level = -1;
+		fclose(fp);
+		if (level <= best)
+			continue;
+
+		snprintf(path, sizeof(path),
+		 "/sys/devices/system/cpu/cpu%d/cache/index%d/shared_cpu_list",
+			 cpu, idx);
+		fp = fopen(path, "r");
+		if (!fp)
+			continue;
+		if (fgets(buf, sizeof(buf), fp)) {
+			if (map)
+				cpu_map__delete(map);
+			map = cpu_map__new(buf);
+			best = level;
+		}
+		fclose(fp);
+	}
+	return map;
+}
+
+static bool cpu_in_map(struct cpu_map *map, int cpu)
+{
+	int i;
+
+	for (i = 0; i < map->nr; i++)
+		if (map->map[i] == cpu)
+			return true;
+	return false;
+}
+
+/*
+ * Pick the first allowed CPU and the first allowed CPU outside of its
+ * LLC, falling back to the last allowed CPU if they all share it.
+ */
+static bool pick_cpus(int *cpu0, int *cpu1)
+{
+	struct cpu_map *llc;
+	cpu_set_t mask;
+	int cpu, last = -1;
+
+	if (sched_getaffinity(0, sizeof(mask), &mask))
+		barf("sched_getaffinity");
+
+	*cpu0 = -1;
+	*cpu1 = -1;
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (!CPU_ISSET(cpu, &mask))
+			continue;
+		if (*cpu0 < 0)
+			*cpu0 = cpu;
+		last = cpu;
+	}
+	if (*cpu0 < 0 || last == *cpu0)
+		return false;
+
+	llc = llc_siblings(*cpu0);
+	for (cpu = *cpu0 + 1; llc && cpu <= last; cpu++) {
+		if (CPU_ISSET(cpu, &mask) && !cpu_in_map(llc, cpu)) {
+			*cpu1 = cpu;
+			break;
+		}
+	}
+	if (llc)
+		cpu_map__delete(llc);
+
+	if (*cpu1 >= 0)
+		return true;
+	*cpu1 = last;
+	return false;
+}
+
+int bench_sched_pingpong(int argc, const char **argv,
+			 const char *prefix __used)
+{
+	struct player players[2];
+	struct timeval start, stop, diff;
+	unsigned long long result_usec;
+	bool cross_llc;
+	int i;
+
+	argc = parse_options(argc, argv, options,
+			     bench_sched_pingpong_usage, 0);
+	if (loops <= 0)
+		usage_with_options(bench_sched_pingpong_usage, options);
+
+	if (cpu_list) {
+		struct cpu_map *map = cpu_map__new(cpu_list);
+		struct cpu_map *llc;
+
+		if (!map || map->nr != 2) {
+			fprintf(stderr, "Need exactly two CPUs: %s\n",
+				cpu_list);
+			exit(1);
+		}
+		players[0].cpu = map->map[0];
+		players[1].cpu = map->map[1];
+		cpu_map__delete(map);
+
+		llc = llc_siblings(players[0].cpu);
+		cross_llc = llc && !cpu_in_map(llc, players[1].cpu);
+		if (llc)
+			cpu_map__delete(llc);
+	} else {
+		cross_llc = pick_cpus(&players[0].cpu, &players[1].cpu);
+		if (players[1].cpu < 0) {
+			fprintf(stderr, "Need at least two CPUs\n");
+			exit(1);
+		}
+	}
+
+	token = 0;
+	for (i = 0; i < 2; i++) {
+		players[i].parity = i;
+		players[i].peer = &players[!i];
+		/* ping starts out holding the token */
+		if (sem_init(&players[i].sem, 0, !i))
+			barf("sem_init");
+	}
+
+	gettimeofday(&start, NULL);
+
+	for (i = 0; i < 2; i++) {
+		if (pthread_create(&players[i].thread, NULL, player_thread,
+				   &players[i]))
+			barf("pthread_create");
+	}
+	for (i = 0; i < 2; i++)
+		pthread_join(players[i].thread, NULL);
+
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	result_usec = diff.tv_sec * 1000000ULL + diff.tv_usec;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# Executed %d round trips between CPU %d and CPU %d"
+		       " (%s LLC, %s)\n\n", loops,
+		       players[0].cpu, players[1].cpu,
+		       cross_llc ? "different" : "same",
+		       spin ? "spinning" : "sleeping");
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec/1000));
+
+		printf(" %14lf usecs/round trip\n",
+		       (double)result_usec / (double)loops);
+		printf(" %14d round trips/sec\n",
+		       (int)((double)loops /
+			     ((double)result_usec / (double)1000000)));
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%lf\n", (double)result_usec / (double)loops);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
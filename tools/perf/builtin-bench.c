@@ -42,6 +42,18 @@ static struct bench_suite sched_suites[] = {
 	{ "pipe",
 	  "Flood of communication over pipe() between two processes",
 	  bench_sched_pipe      },
+	{ "latency",
+	  "Wakeup latency histogram of message and worker threads",
+	  bench_sched_latency   },
+	{ "pingpong",
+	  "Token passing between two CPUs in different LLCs",
+	  bench_sched_pingpong  },
+	{ "fork",
+	  "Concurrent creation and exit of processes or threads",
+	  bench_sched_fork      },
+	{ "fairness",
+	  "CPU share of weighted groups of CPU and IO bound tasks",
+	  bench_sched_fairness  },
 	suite_all,
 	{ NULL,
 	  NULL,